@@ -5,7 +5,7 @@
  *
  *  PathWorkStealingQueue
  *
- *  - helper class for work stealing queue for ws_stat
+ *  - helper class for work stealing queue for the Executor
  *    (qwen3.5:122b)
  *
  *  c++ version of workspace utility
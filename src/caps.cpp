@@ -146,6 +146,13 @@ void Cap::drop_caps(std::vector<cap_value_t> cap_arg, int uid, utils::SrcPos src
         }
 
         cap_free(caps);
+
+        // thread has new capabilities, read them again on next change
+        auto& thread = scopes();
+        if (thread.state != nullptr) {
+            cap_free(thread.state);
+            thread.state = nullptr;
+        }
     }
 #endif
 
@@ -157,88 +164,110 @@ void Cap::drop_caps(std::vector<cap_value_t> cap_arg, int uid, utils::SrcPos src
     }
 }
 
-// remove a capability from the effective set
-void Cap::lower_cap(std::vector<cap_value_t> cap_arg, int uid, utils::SrcPos srcpos) {
-    if (traceflag) {
-        spdlog::trace("Cap::lower_cap( {}, {})", uid, srcpos.getSrcPos());
-        dump();
-    }
+Cap::~Cap() {}
+
+Cap::ThreadScopes::~ThreadScopes() {
 #ifdef WS_CAPA
-    if (hascaps) {
-        cap_t caps;
-        std::vector<cap_value_t> cap_list(cap_arg.size());
+    if (state != nullptr)
+        cap_free(state);
+#endif
+}
 
-        int cnt = 0;
-        for (const auto& ca : cap_arg) {
-            cap_list[cnt++] = ca;
-        }
+Cap::ThreadScopes& Cap::scopes() {
+    static thread_local ThreadScopes thread;
+    return thread;
+}
 
-        caps = cap_get_proc();
+// set or clear capabilities in effective set of calling thread, based on its cached state
+void Cap::setEffective(const std::vector<cap_value_t>& cap_arg, const bool raise, utils::SrcPos& srcpos) {
+#ifdef WS_CAPA
+    if (hascaps && !cap_arg.empty()) {
+        cap_t& state = scopes().state;
+        if (state == nullptr)
+            state = cap_get_proc();
 
-        if (cap_set_flag(caps, CAP_EFFECTIVE, cnt, cap_list.data(), CAP_CLEAR) == -1) {
+        if (state == nullptr ||
+            cap_set_flag(state, CAP_EFFECTIVE, cap_arg.size(), cap_arg.data(), raise ? CAP_SET : CAP_CLEAR) == -1) {
             spdlog::error("problem with effective capabilities {}.", srcpos.getSrcPos());
             exit(1);
         }
 
-        if (cap_set_proc(caps) == -1) {
-            spdlog::error("problem lowering effective capabilities {}.", srcpos.getSrcPos());
+        if (cap_set_proc(state) == -1) {
+            spdlog::error("problem {} effective capabilities {}.", raise ? "raising" : "lowering", srcpos.getSrcPos());
             cap_t cap = cap_get_proc();
             spdlog::info("running with capabilities: {}", cap_to_text(cap, NULL));
             cap_free(cap);
             exit(1);
         }
-
-        cap_free(caps);
     }
+#else
+    (void)cap_arg;
+    (void)raise;
+    (void)srcpos;
 #endif
+}
 
-    if (issetuid) {
-        if (seteuid(uid)) {
-            spdlog::error("can not change uid {}.", srcpos.getSrcPos());
-            exit(1);
-        }
+void Cap::setEuid(const uid_t uid, utils::SrcPos& srcpos) {
+    if (seteuid(uid)) {
+        spdlog::error("can not change uid {}.", srcpos.getSrcPos());
+        exit(1);
     }
 }
 
-// add a capability to the effective set
-void Cap::raise_cap(std::vector<cap_value_t> cap_arg, utils::SrcPos srcpos) {
+CapScope::CapScope(Cap& cap_, std::vector<cap_value_t> caplist_, const uid_t uid_, utils::SrcPos srcpos_)
+    : cap(cap_), caplist(std::move(caplist_)), uid(uid_), srcpos(std::move(srcpos_)) {
     if (traceflag) {
-        spdlog::trace("Cap::raise_cap( {}, {})", cap_arg, srcpos.getSrcPos());
-        dump();
+        spdlog::trace("CapScope( {}, {})", caplist, srcpos.getSrcPos());
+        cap.dump();
     }
-#ifdef WS_CAPA
-    if (hascaps) {
-        cap_t caps;
-        std::vector<cap_value_t> cap_list(cap_arg.size());
 
-        int cnt = 0;
-        for (const auto& ca : cap_arg) {
-            cap_list[cnt++] = ca;
-        }
+    auto& thread = Cap::scopes();
+    for (auto c : caplist) {
+        if (c >= 0 && c < 64 && thread.raised[c]++ == 0)
+            newcaps.push_back(c);
+    }
+    thread.depth++;
 
-        caps = cap_get_proc();
+    if (!newcaps.empty()) {
+        cap.setEffective(newcaps, true, srcpos);
+        cap.transitions++;
+    }
 
-        if (cap_set_flag(caps, CAP_EFFECTIVE, cnt, cap_list.data(), CAP_SET) == -1) {
-            spdlog::error("problem with effective capabilities {}.", srcpos.getSrcPos());
-            exit(1);
+    if (cap.issetuid) {
+        savedeuid = geteuid();
+        if (savedeuid != 0) {
+            cap.setEuid(0, srcpos);
+            switched = true;
+            cap.transitions++;
         }
+    }
+}
 
-        if (cap_set_proc(caps) == -1) {
-            spdlog::error("problem raising effective capabilities. {}", srcpos.getSrcPos());
-            cap_t cap = cap_get_proc();
-            spdlog::debug("Running with capabilities: {}", cap_to_text(cap, NULL));
-            cap_free(cap);
-            exit(1);
-        }
+CapScope::~CapScope() {
+    if (traceflag)
+        spdlog::trace("~CapScope( {}, {})", caplist, srcpos.getSrcPos());
 
-        cap_free(caps);
+    auto& thread = Cap::scopes();
+    std::vector<cap_value_t> lastcaps;
+    for (auto c : caplist) {
+        if (c >= 0 && c < 64 && --thread.raised[c] == 0)
+            lastcaps.push_back(c);
     }
-#endif
+    thread.depth--;
 
-    if (issetuid) {
-        if (seteuid(0)) {
-            spdlog::error("can not change uid {}.", srcpos.getSrcPos());
-            exit(1);
+    if (!lastcaps.empty()) {
+        cap.setEffective(lastcaps, false, srcpos);
+        cap.transitions++;
+    }
+
+    if (cap.issetuid) {
+        uid_t target = thread.depth == 0 ? uid : savedeuid;
+        if ((thread.depth == 0 || switched) && geteuid() != target) {
+            // code inside may have switched to an unprivileged user, only root can change to any uid
+            if (geteuid() != 0 && target != 0)
+                cap.setEuid(0, srcpos);
+            cap.setEuid(target, srcpos);
+            cap.transitions++;
         }
     }
 }
@@ -11,7 +11,7 @@
  *  c++ version of workspace utility
  *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
  *
- *  (c) Holger Berger 2021,2023,2024,2025
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
  *
  *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
  *
@@ -30,6 +30,10 @@
  *
  */
 
+#include <array>
+#include <atomic>
+#include <vector>
+
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -46,25 +50,81 @@ const int CAP_FOWNER = 3;
 const int CAP_SYS_ADMIN = 4;
 #endif
 
+class CapScope;
+
+// privilege handling of the process. capabilities are per thread in linux, so are scopes,
+// threads can raise and lower their capabilities independently. setuid mode changes the euid
+// of the whole process and is not thread safe.
 class Cap {
   private:
     bool hascaps;
     bool issetuid;
     bool isusermode;
 
+    // open scopes of a thread per capability, only first raise and last lower change the thread
+    struct ThreadScopes {
+        std::array<int, 64> raised{};
+        int depth = 0; // number of open scopes
+#ifdef WS_CAPA
+        cap_t state = nullptr; // cached capabilities of thread, saves cap_get_proc for every change
+#endif
+        ~ThreadScopes();
+    };
+    static ThreadScopes& scopes();
+
+    std::atomic<long> transitions{0}; // changes of effective set or euid done by scopes
+
+    // set or clear capabilities in effective set
+    void setEffective(const std::vector<cap_value_t>& cap_arg, const bool raise, utils::SrcPos& srcpos);
+    void setEuid(const uid_t uid, utils::SrcPos& srcpos);
+
+    friend class CapScope;
+
   public:
     Cap();
+    ~Cap();
 
-    // functions that can be called to raise and lower caps
+    Cap(const Cap&) = delete;
+    Cap& operator=(const Cap&) = delete;
+
+    // drop root/effective capabilities and verify permitted set, call once at startup
     void drop_caps(std::vector<cap_value_t> cap_arg, int uid, utils::SrcPos srcpos);
-    void lower_cap(std::vector<cap_value_t> cap_arg, int dbuid, utils::SrcPos);
-    void raise_cap(std::vector<cap_value_t> cap_arg, utils::SrcPos);
 
     bool isSetuid() { return issetuid; };
     bool hasCaps() { return hascaps; };
     bool isUserMode() { return isusermode; };
 
+    // number of open CapScopes of calling thread, and if a capability is raised by one of them
+    int scopeDepth() const { return scopes().depth; }
+    bool isRaised(const cap_value_t cap) const { return cap >= 0 && cap < 64 && scopes().raised[cap] > 0; }
+    // number of privilege changes done by scopes, for tests
+    long getTransitions() const { return transitions; }
+
     void dump() const;
 };
 
+// elevated section, raises capabilities (or euid 0 in setuid mode) for its lifetime and lowers
+// them again on every exit path, including exceptions.
+// nested scopes only raise capabilities not raised yet, so a batch can hold one outer scope and
+// the per entry scopes inside cost no syscalls. when the last scope ends, euid is set to uid.
+// code inside a scope may change euid (e.g. to DB user for root_squash), a nested scope switches
+// to root and restores that euid when it ends.
+class CapScope {
+  private:
+    Cap& cap;
+    std::vector<cap_value_t> newcaps; // caps raised by this scope
+    std::vector<cap_value_t> caplist;
+    uid_t uid;
+    uid_t savedeuid = 0; // euid before this scope switched to root
+    bool switched = false;
+    utils::SrcPos srcpos;
+
+  public:
+    CapScope(Cap& cap_, std::vector<cap_value_t> caplist_, const uid_t uid_, utils::SrcPos srcpos_);
+    ~CapScope();
+
+    CapScope(const CapScope&) = delete;
+    CapScope& operator=(const CapScope&) = delete;
+};
+
 #endif
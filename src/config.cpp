@@ -47,6 +47,7 @@
 
 #include "config.h"
 #include "db.h"
+#include "dbinmemory.h"
 #include "dbv1.h"
 #include "utils.h"
 
@@ -55,6 +56,8 @@
 #include <filesystem>
 namespace cppfs = std::filesystem;
 
+#include <unistd.h>
+
 extern bool debugflag;
 extern bool traceflag;
 extern int debuglevel;
@@ -62,7 +65,20 @@ extern int debuglevel;
 // tries to read a list of config files, in given order, can be used to check for /etc/ws.d first and /etc/ws.conf
 // second stops when file can be read, but reads all files in case of directory given
 //  unittest: yes
-Config::Config(const std::vector<cppfs::path> configpathes) {
+Config::Config(const std::vector<cppfs::path>& configpathes) : Config(configpathes, cppfs::path()) {}
+
+// same as above, but uses compiled config from cachefile if it matches the config files
+// cache is only written by real root (uid and euid 0), so setuid tools and users never write it
+//  unittest: yes
+Config::Config(const std::vector<cppfs::path>& configpathes, const cppfs::path& cachefile) {
+    std::string cachekey;
+    if (!cachefile.empty()) {
+        cachekey = cacheKey(configpathes);
+        if (loadCache(cachefile, cachekey)) {
+            return;
+        }
+    }
+
     // some defaults
     global.dbuid = 0;
     global.dbgid = 0;
@@ -116,10 +132,17 @@ Config::Config(const std::vector<cppfs::path> configpathes) {
     } else {
         validate();
     }
+
+    if (!cachefile.empty() && isvalid && getuid() == geteuid()) {
+        writeCache(cachefile, cachekey);
+    }
 }
 
 // read config from YAML node (no validation)
-Config::Config(const std::string configstring) { readYAML(configstring); }
+Config::Config(const std::string& configstring) {
+    readYAML(configstring);
+    validate();
+}
 
 // validate config, return false if invalid
 //  unitest: indirect
@@ -141,6 +164,17 @@ bool Config::validate() {
         valid = true;
         spdlog::warn("No adminmail in config!");
     }
+    if (global.mailrate < 0) {
+        valid = false;
+        spdlog::error("Negative mailrate in config!");
+    }
+    for (auto days : global.reminderschedule) {
+        if (days <= 0) {
+            valid = false;
+            spdlog::error("Invalid reminderschedule in config, days have to be positive!");
+            break;
+        }
+    }
     if (global.maxuserworkspaces == 0) {
         if (debugflag)
             spdlog::debug("maxuserworkspaces not set, using 0 (no limit)");
@@ -168,14 +202,44 @@ bool Config::validate() {
             valid = false;
             spdlog::error("No deleted name in filesystem <> in config!", fsname);
         }
+        if (fsdata.metadatarate < 0 || fsdata.metadataconcurrency < 0) {
+            valid = false;
+            spdlog::error("Negative metadatarate or metadataconcurrency in filesystem {} in config!", fsname);
+        }
+        if (fsdata.deleteorder != "directory" && fsdata.deleteorder != "inode") {
+            valid = false;
+            spdlog::error("Invalid deleteorder {} in filesystem {} in config!", fsdata.deleteorder, fsname);
+        }
+        if (fsdata.expirertimelimit < 0) {
+            valid = false;
+            spdlog::error("Negative expirertimelimit in filesystem {} in config!", fsname);
+        }
     }
     isvalid = valid;
     return valid;
 }
 
+// compile ACL list into hash table with intent bitmask, done once at load time,
+// so hasAccess does not parse ACLs
+static ACL_table compileACL(const std::vector<std::string>& acl) {
+    ACL_table table;
+    for (const auto& [id, perm] : utils::parseACL(acl)) {
+        unsigned intents = 0;
+        for (const auto& i : perm.second) {
+            intents |= 1u << i;
+        }
+        // empty permission list means all permissions
+        if (intents == 0) {
+            intents = ~0u;
+        }
+        table[id] = ACL_entry{perm.first == "+", intents};
+    }
+    return table;
+}
+
 #ifdef RYAML
 // helper to read a sequence of strings from a yaml node
-static void readRyamlSequence(const ryml::NodeRef parent, const std::string key, std::vector<std::string>& target) {
+static void readRyamlSequence(const ryml::NodeRef parent, const std::string& key, std::vector<std::string>& target) {
     if (parent.has_child(key.c_str())) {
         auto node = parent[key.c_str()];
         for (auto n : node.children()) {
@@ -206,6 +270,9 @@ void Config::readYAML(string yamlstr) {
 
     readRyamlScalar(config, "clustername", global.clustername);
     readRyamlScalar(config, "smtphost", global.smtphost);
+    readRyamlScalar(config, "mailspool", global.mailspool);
+    readRyamlScalar(config, "mailrate", global.mailrate);
+    readRyamlScalar(config, "reminderdigest", global.reminderdigest);
     readRyamlScalar(config, "mail_from", global.mail_from);
     readRyamlScalar(config, "default_workspace", global.defaultWorkspace); // SPEC:CHANGE: accept alias
     readRyamlScalar(config, "default", global.defaultWorkspace);
@@ -220,10 +287,25 @@ void Config::readYAML(string yamlstr) {
     readRyamlSequence(config, "deldirtimeout", global.deldirtimeout);
     readRyamlSequence(config, "expirerlogpath", global.expirerlogpath);
     readRyamlSequence(config, "maxuserworkspaces", global.maxuserworkspaces);
+    readRyamlSequence(config, "nsscachettl", global.nsscachettl);
+    readRyamlSequence(config, "nssenumeratethreshold", global.nssenumeratethreshold);
+    readRyamlSequence(config, "threads", global.threads);
 
     readRyamlSequence(config, "admins", global.admins);
     readRyamlSequence(config, "debugusers", global.debugusers);
     readRyamlSequence(config, "adminmail", global.adminmail);
+    if (root.has_child("reminderschedule")) {
+        // non-numeric days are kept as 0, so validate() rejects the config
+        for (auto n : config["reminderschedule"].children()) {
+            int days = 0;
+            if (!n.has_val() || !c4::atoi(n.val(), &days)) {
+                spdlog::error("Invalid reminderschedule in config, {} is not a number!",
+                              n.has_val() ? std::string(n.val().str, n.val().len) : std::string());
+                days = 0;
+            }
+            global.reminderschedule.push_back(days);
+        }
+    }
 
     // SPEC:CHANGE accept filesystem as alias for workspaces to better match the -F option of the tools
 
@@ -273,6 +355,14 @@ void Config::readYAML(string yamlstr) {
                         node >> fs.extendable;
                     if (node = ws["restorable"]; node.has_val())
                         node >> fs.restorable;
+                    if (node = ws["metadatarate"]; node.has_val())
+                        node >> fs.metadatarate;
+                    if (node = ws["metadataconcurrency"]; node.has_val())
+                        node >> fs.metadataconcurrency;
+                    if (node = ws["deleteorder"]; node.has_val())
+                        node >> fs.deleteorder;
+                    if (node = ws["expirertimelimit"]; node.has_val())
+                        node >> fs.expirertimelimit;
                     if (node = ws["comment"]; node.has_val())
                         node >> fs.comment;
 
@@ -286,6 +376,9 @@ void Config::readYAML(string yamlstr) {
                     readRyamlSequence(ws, "user_acl", fs.user_acl);
                     readRyamlSequence(ws, "group_acl", fs.group_acl);
 
+                    fs.user_acl_table = compileACL(fs.user_acl);
+                    fs.group_acl_table = compileACL(fs.group_acl);
+
                     filesystems[fs.name] = fs;
                 }
             }
@@ -297,7 +390,7 @@ void Config::readYAML(string yamlstr) {
 
 // parse YAML from a string (using yaml-cpp)
 //  unittest: indirect
-void Config::readYAML(const string yaml) {
+void Config::readYAML(const string& yaml) {
     auto config = YAML::Load(yaml);
     // global flags
     if (config["clustername"])
@@ -306,6 +399,14 @@ void Config::readYAML(const string yaml) {
         global.smtphost = config["smtphost"].as<string>();
     if (config["mail_from"])
         global.mail_from = config["mail_from"].as<string>();
+    if (config["mailspool"])
+        global.mailspool = config["mailspool"].as<string>();
+    if (config["mailrate"])
+        global.mailrate = config["mailrate"].as<int>();
+    if (config["reminderschedule"])
+        global.reminderschedule = config["reminderschedule"].as<vector<int>>();
+    if (config["reminderdigest"])
+        global.reminderdigest = config["reminderdigest"].as<bool>();
     if (config["default_workspace"])
         global.defaultWorkspace =
             config["default_workspace"].as<string>(); // SPEC:CHANGE accept alias default_workspace
@@ -339,6 +440,12 @@ void Config::readYAML(const string yaml) {
         global.expirerlogpath = config["expirerlogpath"].as<string>();
     if (config["maxuserworkspaces"])
         global.maxuserworkspaces = config["maxuserworkspaces"].as<int>();
+    if (config["nsscachettl"])
+        global.nsscachettl = config["nsscachettl"].as<int>();
+    if (config["nssenumeratethreshold"])
+        global.nssenumeratethreshold = config["nssenumeratethreshold"].as<int>();
+    if (config["threads"])
+        global.threads = config["threads"].as<int>();
 
     // SPEC:CHANGE accept filesystem as alias for workspaces to better match the -F option of the tools
     if (config["workspaces"] || config["filesystems"]) {
@@ -409,8 +516,20 @@ void Config::readYAML(const string yaml) {
                         fs.restorable = ws["restorable"].as<bool>();
                     else
                         fs.restorable = true;
+                    if (ws["metadatarate"])
+                        fs.metadatarate = ws["metadatarate"].as<int>();
+                    if (ws["metadataconcurrency"])
+                        fs.metadataconcurrency = ws["metadataconcurrency"].as<int>();
+                    if (ws["deleteorder"])
+                        fs.deleteorder = ws["deleteorder"].as<string>();
+                    if (ws["expirertimelimit"])
+                        fs.expirertimelimit = ws["expirertimelimit"].as<int>();
                     if (ws["comment"])
                         fs.comment = ws["comment"].as<string>();
+
+                    fs.user_acl_table = compileACL(fs.user_acl);
+                    fs.group_acl_table = compileACL(fs.group_acl);
+
                     filesystems[fs.name] = fs;
                 }
             }
@@ -421,12 +540,12 @@ void Config::readYAML(const string yaml) {
 
 // is user admin?
 // unittest: yes
-bool Config::isAdmin(const string user) const {
+bool Config::isAdmin(const string& user) const {
     return std::find(global.admins.begin(), global.admins.end(), user) != global.admins.end();
 }
 
 // is user in debugusers list?
-bool Config::isDebugUser(const string user) const {
+bool Config::isDebugUser(const string& user) const {
     if (user == "root")
         return true;
     return std::find(global.debugusers.begin(), global.debugusers.end(), user) != global.debugusers.end();
@@ -435,7 +554,7 @@ bool Config::isDebugUser(const string user) const {
 // check if given user can assess given filesystem with current config
 //  see validFilesystems for specification of ACLs
 // unittest: yes
-bool Config::hasAccess(const string user, const vector<string> groups, const string filesystem,
+bool Config::hasAccess(const string& user, const vector<string>& groups, const string& filesystem,
                        const ws::intent intent) const {
     if (traceflag)
         spdlog::trace("hasAccess(user={},groups={},filesystem={})", user, groups, filesystem);
@@ -443,73 +562,45 @@ bool Config::hasAccess(const string user, const vector<string> groups, const str
     bool ok = true;
 
     // see if FS is valid
-    if (filesystems.count(filesystem) < 1) {
+    auto fsit = filesystems.find(filesystem);
+    if (fsit == filesystems.end()) {
         spdlog::error("invalid filesystem queried for access: {}", filesystem);
         return false;
     }
+    const auto& fsconfig = fsit->second;
+    const unsigned intentbit = 1u << intent;
 
     // check ACLs, group first, user second to allow -user to override group grant
-    if (filesystems.at(filesystem).user_acl.size() > 0 || filesystems.at(filesystem).group_acl.size() > 0) {
+    if (fsconfig.user_acl.size() > 0 || fsconfig.group_acl.size() > 0) {
         // as soon as any ACL is present access is denied and has to be granted
         ok = false;
         if (debugflag && debuglevel > 0)
             spdlog::debug("ACLs present");
 
-        if (filesystems.at(filesystem).group_acl.size() > 0) {
+        if (fsconfig.group_acl.size() > 0) {
             if (debugflag && debuglevel > 0)
                 spdlog::debug("   group ACL present,");
-            auto aclmap = utils::parseACL(filesystems.at(filesystem).group_acl);
             for (const auto& group : groups) {
-                if (aclmap.count(group) > 0) {
-                    auto perm = aclmap[group];
-                    if (perm.second.size() == 0) {
-                        ok = (perm.first == "+");
-                    } else {
-                        if (perm.first == "+") {
-                            ok = canFind(perm.second, intent);
-                        } else {
-                            ok = !canFind(perm.second, intent);
-                        }
-                    }
+                auto it = fsconfig.group_acl_table.find(group);
+                if (it != fsconfig.group_acl_table.end()) {
+                    // + grants the listed intents, - denies them
+                    ok = it->second.grant == ((it->second.intents & intentbit) != 0);
                     if (debugflag && debuglevel > 0)
                         spdlog::debug("   access for {} {}", group, ok ? "granted" : "denied");
                 }
             }
-            /*  old cold old ACL syntax
-            for(const auto & group : groups) {
-                if (canFind(filesystems.at(filesystem).group_acl, group)) ok = true;
-                if (canFind(filesystems.at(filesystem).group_acl, string("+")+group)) ok = true;
-                if (canFind(filesystems.at(filesystem).group_acl, string("-")+group)) ok = false;
-                if (debugflag) spdlog::debug("   access for {} {}", group, ok?"granted":"denied");
-            }
-            */
         }
 
-        if (filesystems.at(filesystem).user_acl.size() > 0) {
+        if (fsconfig.user_acl.size() > 0) {
             if (debugflag && debuglevel > 0)
                 spdlog::debug("   user ACL present,");
-            auto aclmap = utils::parseACL(filesystems.at(filesystem).user_acl);
-            if (aclmap.count(user) > 0) {
-                auto perm = aclmap[user];
-                if (perm.second.size() == 0) {
-                    ok = (perm.first == "+");
-                } else {
-                    if (perm.first == "+") {
-                        ok = canFind(perm.second, intent);
-                    } else {
-                        ok = !canFind(perm.second, intent);
-                    }
-                }
+            auto it = fsconfig.user_acl_table.find(user);
+            if (it != fsconfig.user_acl_table.end()) {
+                // + grants the listed intents, - denies them
+                ok = it->second.grant == ((it->second.intents & intentbit) != 0);
                 if (debugflag && debuglevel > 0)
                     spdlog::debug("   access for {} {}", user, ok ? "granted" : "denied");
             }
-
-            /* old code for old ACL syntax
-            if (canFind(filesystems.at(filesystem).user_acl, user)) ok = true;
-            if (canFind(filesystems.at(filesystem).user_acl, string("+")+user)) ok = true;
-            if (canFind(filesystems.at(filesystem).user_acl, string("-")+user)) ok = false;
-            if (debugflag) spdlog::debug("   access for {} {}", user, ok?"granted":"denied");
-            */
         }
     }
 
@@ -550,7 +641,8 @@ vector<string> Config::Filesystems() const {
 //  [+|-]id[:[permission{,permission}]] SPEC: permission is one of  list,use,create,extend,release,restore SPEC: if no
 //  permisson is given, all permission are granted or denied
 // unittest: yes
-vector<string> Config::validFilesystems(const string user, const vector<string> groups, const ws::intent intent) const {
+vector<string> Config::validFilesystems(const string& user, const vector<string>& groups,
+                                        const ws::intent intent) const {
     if (traceflag)
         spdlog::trace("validFilesystems(user={},groups={})", user, groups);
     vector<string> validfs;
@@ -581,7 +673,7 @@ vector<string> Config::validFilesystems(const string user, const vector<string>
 
     // now groups
     for (auto const& [fs, val] : filesystems) {
-        for (string group : groups) {
+        for (const string& group : groups) {
             if (debugflag && debuglevel > 0)
                 spdlog::debug("checking if group <{}> in groupdefault[{}]={}", group, fs,
                               filesystems.at(fs).groupdefault);
@@ -628,11 +720,16 @@ groupend:
 }
 
 // get DB type for the fs
-Database* Config::openDB(const string fs) const {
+Database* Config::openDB(const string& fs) const {
     if (traceflag)
         spdlog::trace("opendb {}", fs);
     // TODO: version check here to determine which DB to open
 
+    // in-memory DB for tests and benchmarks, starts empty, no magic to check
+    if (getFsConfig(fs).database == ":memory:") {
+        return new InMemoryDatabase(this, fs);
+    }
+
     // check for magic in DB entry, to avoid that DB is not existing and all workspaces
     // get wiped by accident, e.g. due to mouting problems if DB is not in same FS as workspaces
     if (cppfs::exists(cppfs::path(getFsConfig(fs).database) / ".ws_db_magic")) {
@@ -650,26 +747,29 @@ Database* Config::openDB(const string fs) const {
     return new FilesystemDBV1(this, fs);
 }
 
+// returned by reference for unknown filesystems
+static const string emptystring;
+
 // return path to database for given filesystem, or empy string
-string Config::database(const string filesystem) const {
+const string& Config::database(const string& filesystem) const {
     auto it = filesystems.find(filesystem);
     if (it == filesystems.end())
-        return string("");
+        return emptystring;
     else
         return it->second.database;
 }
 
 // return path to deletedpath for given filesystem, or empty string
-string Config::deletedPath(const string filesystem) const {
+const string& Config::deletedPath(const string& filesystem) const {
     auto it = filesystems.find(filesystem);
     if (it == filesystems.end())
-        return string("");
+        return emptystring;
     else
         return it->second.deletedPath;
 }
 
 // return config of filesystem throw if invalid
-Filesystem_config Config::getFsConfig(const std::string filesystem) const {
+const Filesystem_config& Config::getFsConfig(const std::string& filesystem) const {
     if (traceflag)
         spdlog::trace("getFsConfig({})", filesystem);
     try {
@@ -34,6 +34,7 @@
 #include <filesystem>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "db.h"
@@ -46,6 +47,7 @@ namespace cppfs = std::filesystem;
 using strings = std::vector<string>;
 
 // global part of config
+// NOTE: fields are serialized in configcache.cpp, bump configcache version when changing them
 struct Global_config {
     string clustername;      // name of cluster for mails
     string smtphost;         // smtp host for sending mails
@@ -63,9 +65,25 @@ struct Global_config {
     int dbgid;               // gid of DB user
     int deldirtimeout;       // timeout for directory deletion in seconds
     string expirerlogpath;   // path where ws_expirer should place logfiles
+    int nsscachettl = 600;   // seconds to keep cached user and group data
+    int nssenumeratethreshold = 200; // single user lookups before all users and groups are read at once
+    int threads = 0;         // threads for parallel work, 0 for number of cores
+    string mailspool;        // spool directory for mails of ws_expirer, empty sends directly
+    int mailrate = 0;        // mails per minute sent from the spool, 0 unlimited
+    vector<int> reminderschedule; // days before expiration for further reminders after the first one
+    bool reminderdigest = false;  // one reminder mail per mail address for all its workspaces
 };
 
+// precompiled ACL entry
+struct ACL_entry {
+    bool grant;       // + or - modifier
+    unsigned intents; // bitmask of ws::intent, all bits set if no permission given
+};
+// ACL compiled at config load, id -> entry
+using ACL_table = std::unordered_map<string, ACL_entry>;
+
 // config of filesystem
+// NOTE: fields are serialized in configcache.cpp, bump configcache version when changing them
 struct Filesystem_config {
     string name;           // name of filesystem
     string comment;        // some notice for the user about this filesystem
@@ -77,10 +95,16 @@ struct Filesystem_config {
     strings userdefault;   // users having this filesytem as default
     strings user_acl;      // if present, users have to match ACL, user or +user grant access, -user denies
     strings group_acl;     // if present, users have to match ACL
+    ACL_table user_acl_table;  // compiled user_acl
+    ACL_table group_acl_table; // compiled group_acl
     int keeptime;          // max time in days to keep deleted workspace after expiration
     int releasekeeptime;   // max time in days to keep deleted workspace after release
     int maxduration;       // max duration a user can choose for this filesystem
     int maxextensions;     // max extensiones a user can do for this filesystem
+    int metadatarate = 0;        // max metadata operations per second of deletion and traversal, 0 unlimited
+    int metadataconcurrency = 0; // max threads doing metadata operations at the same time, 0 unlimited
+    string deleteorder = "directory"; // order of unlinking in a directory: directory (readdir order) or inode
+    int expirertimelimit = 0;         // seconds ws_expirer may spend on this filesystem per run, 0 unlimited
     // migration helpers
     bool allocatable; // is this filesystem allocatable? (or read only?)
     bool extendable;  // is this filesystem extendable? (or read only?)
@@ -99,14 +123,19 @@ class Config {
     std::map<string, Filesystem_config> filesystems; // list of workspace filesystems
 
     // validation helpers
-    bool isvalid;
+    bool isvalid = false;
+
+    // config was loaded from compiled cache
+    bool fromcache = false;
 
   public:
     // read config from list of files or directories, in given order, stops after first existing file
     // (even if invalid!) but reads all fiels if a directory is given.
-    Config(const std::vector<cppfs::path> filenames);
+    Config(const std::vector<cppfs::path>& filenames);
+    // same, but use compiled config in cachefile if it is up to date with the files, and update it if not
+    Config(const std::vector<cppfs::path>& filenames, const cppfs::path& cachefile);
     // read config from string
-    Config(const string configstring);
+    Config(const string& configstring);
 
     // validate, public for tests, to be called after string constructor
     bool validate();
@@ -114,51 +143,72 @@ class Config {
     // check if config is valid
     bool isValid() { return isvalid; };
 
+    // check if config was loaded from compiled cache
+    bool isFromCache() const { return fromcache; };
+
     // check if user is an admin
-    bool isAdmin(const string user) const;
+    bool isAdmin(const string& user) const;
     // check if user is in debugusers list
-    bool isDebugUser(const string user) const;
+    bool isDebugUser(const string& user) const;
     // get list of valid filesystems for user
-    vector<string> validFilesystems(const string user, const vector<string> groups, const ws::intent intent) const;
+    vector<string> validFilesystems(const string& user, const vector<string>& groups, const ws::intent intent) const;
     // check if given user can assess given filesystem with current config
-    bool hasAccess(const string user, const std::vector<string> groups, const string filesystemm,
+    bool hasAccess(const string& user, const std::vector<string>& groups, const string& filesystemm,
                    const ws::intent intent) const;
     // get list of all filesystems
     vector<string> Filesystems() const;
 
     // return DB handle of right version
-    Database* openDB(const string fs) const;
+    Database* openDB(const string& fs) const;
 
     // get config of a filesystem
-    Filesystem_config getFsConfig(const std::string filesystem) const;
+    const Filesystem_config& getFsConfig(const std::string& filesystem) const;
 
     // return path to database for given filesystem
-    string database(const string filesystem) const;
+    const string& database(const string& filesystem) const;
     // return path to deletedpath for given filesystem
-    string deletedPath(const string filesystem) const;
+    const string& deletedPath(const string& filesystem) const;
     int reminderdefault() const { return global.reminderdefault; };
     int durationdefault() const { return global.durationdefault; };
     long dbuid() const { return global.dbuid; };
     long dbgid() const { return global.dbgid; };
-    string clustername() const { return global.clustername; };
+    const string& clustername() const { return global.clustername; };
     int maxextensions() const { return global.maxextensions; };
     int maxduration() const { return global.maxduration; };
-    string defaultworkspace() const { return global.defaultWorkspace; };
+    const string& defaultworkspace() const { return global.defaultWorkspace; };
     int deldirtimeout() const { return global.deldirtimeout; };
-    string mailfrom() const { return global.mail_from; };
-    string smtphost() const { return global.smtphost; };
-    vector<string> admins() const { return global.admins; };
-    vector<string> adminmail() const { return global.adminmail; };
-    string expirerlogpath() const { return global.expirerlogpath; };
+    const string& mailfrom() const { return global.mail_from; };
+    const string& smtphost() const { return global.smtphost; };
+    const vector<string>& admins() const { return global.admins; };
+    const vector<string>& adminmail() const { return global.adminmail; };
+    const string& expirerlogpath() const { return global.expirerlogpath; };
     int maxuserworkspaces() const { return global.maxuserworkspaces; };
+    int nsscachettl() const { return global.nsscachettl; };
+    int nssenumeratethreshold() const { return global.nssenumeratethreshold; };
+    int threads() const { return global.threads; };
+    const string& mailspool() const { return global.mailspool; };
+    int mailrate() const { return global.mailrate; };
+    const vector<int>& reminderschedule() const { return global.reminderschedule; };
+    bool reminderdigest() const { return global.reminderdigest; };
 
   private:
     // read config from YAML string
-    void readYAML(string YAML);
+    void readYAML(const string& YAML);
+
+    // compiled config cache, see configcache.cpp
+    // key identifying the config files that would be read (path, inode, mtime, size)
+    static std::string cacheKey(const std::vector<cppfs::path>& configpathes);
+    // load config from cache if key matches, returns false if cache is missing, stale or untrusted,
+    // trusted are caches owned by root, in a directory owned by root, both not writable by group or others
+    bool loadCache(const cppfs::path& cachefile, const std::string& key);
+    // write config to cache if running as root, errors are ignored
+    void writeCache(const cppfs::path& cachefile, const std::string& key) const;
 };
 
 // helper for std::find
 // #define canFind(x, y) (std::find(x.begin(), x.end(), y) != x.end())
-template <typename T1, typename T2> bool canFind(T1 x, T2 y) { return (std::find(x.begin(), x.end(), y) != x.end()); }
+template <typename T1, typename T2> bool canFind(const T1& x, const T2& y) {
+    return (std::find(x.begin(), x.end(), y) != x.end());
+}
 
 #endif
@@ -0,0 +1,398 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  configcache.cpp
+ *
+ *  - compiled config cache, a binary snapshot of the parsed and validated config,
+ *    so tools do not have to read and parse all YAML files on every start
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fmt/base.h"
+
+#include "spdlog/spdlog.h"
+
+#include "config.h"
+#include "utils.h"
+
+namespace cppfs = std::filesystem;
+
+extern bool debugflag;
+extern bool traceflag;
+
+// file layout: magic, version, key, global config, filesystems
+// all integers in host byte order, cache is local to a node
+static const char cachemagic[8] = {'W', 'S', 'C', 'O', 'N', 'F', 'C', '\n'};
+static const uint32_t cacheversion = 9;
+
+namespace {
+
+// append binary data to a string
+class CacheWriter {
+    std::string buf;
+
+  public:
+    template <typename T> void put(const T value) { buf.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+    void put(const std::string& value) {
+        put<uint32_t>(value.size());
+        buf.append(value);
+    }
+    void put(const std::vector<std::string>& value) {
+        put<uint32_t>(value.size());
+        for (const auto& v : value)
+            put(v);
+    }
+    void put(const std::vector<int>& value) {
+        put<uint32_t>(value.size());
+        for (auto v : value)
+            put<int32_t>(v);
+    }
+    void put(const ACL_table& value) {
+        put<uint32_t>(value.size());
+        for (const auto& [id, entry] : value) {
+            put(id);
+            put<uint8_t>(entry.grant);
+            put<uint32_t>(entry.intents);
+        }
+    }
+    void putRaw(const char* data, size_t len) { buf.append(data, len); }
+    const std::string& data() const { return buf; }
+};
+
+// read binary data from mapped memory, throws on truncated data
+class CacheReader {
+    const char* pos;
+    const char* end;
+
+    void need(size_t len) {
+        if (static_cast<size_t>(end - pos) < len)
+            throw std::runtime_error("truncated config cache");
+    }
+
+  public:
+    CacheReader(const char* data, size_t len) : pos(data), end(data + len) {}
+
+    template <typename T> T get() {
+        T value;
+        need(sizeof(T));
+        memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+    void get(std::string& value) {
+        auto len = get<uint32_t>();
+        need(len);
+        value.assign(pos, len);
+        pos += len;
+    }
+    void get(std::vector<std::string>& value) {
+        auto count = get<uint32_t>();
+        value.resize(count);
+        for (auto& v : value)
+            get(v);
+    }
+    void get(std::vector<int>& value) {
+        auto count = get<uint32_t>();
+        value.resize(count);
+        for (auto& v : value)
+            v = get<int32_t>();
+    }
+    void get(ACL_table& value) {
+        auto count = get<uint32_t>();
+        value.clear();
+        value.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            std::string id;
+            get(id);
+            bool grant = get<uint8_t>() != 0;
+            value[id] = ACL_entry{grant, get<uint32_t>()};
+        }
+    }
+    bool getRaw(const char* expected, size_t len) {
+        need(len);
+        bool same = memcmp(pos, expected, len) == 0;
+        pos += len;
+        return same;
+    }
+    bool atEnd() const { return pos == end; }
+};
+
+// only root can have written or replaced the file: owned by root and not writable by others
+bool rootOnly(const struct stat& st) { return st.st_uid == 0 && !(st.st_mode & (S_IWGRP | S_IWOTH)); }
+
+// identity of one file, changes if file is replaced or modified
+void appendFileKey(std::string& key, const std::string& path, const struct stat& st) {
+    key += fmt::format("{}\n{}:{}:{}.{}:{}\n", path, st.st_dev, st.st_ino, st.st_mtim.tv_sec, st.st_mtim.tv_nsec,
+                       st.st_size);
+}
+
+} // namespace
+
+// key identifying the config files that would be read, same selection logic as in constructor
+// a directory contributes its own mtime as well, to notice added and removed files
+std::string Config::cacheKey(const std::vector<cppfs::path>& configpathes) {
+    std::string key;
+    struct stat st;
+    for (const auto& configpath : configpathes) {
+        if (stat(configpath.c_str(), &st) != 0)
+            continue;
+        appendFileKey(key, configpath.string(), st);
+        if (S_ISDIR(st.st_mode)) {
+            std::vector<std::string> pathesToSort;
+            std::error_code ec;
+            for (const auto& entry : cppfs::directory_iterator(configpath, ec)) {
+                pathesToSort.push_back(entry.path().string());
+            }
+            std::sort(pathesToSort.begin(), pathesToSort.end());
+            for (const auto& cfile : pathesToSort) {
+                if (stat(cfile.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+                    appendFileKey(key, cfile, st);
+            }
+        }
+        break; // stop after first file
+    }
+    return key;
+}
+
+// load config from cache with a single mmap, if it is trusted and matches key
+bool Config::loadCache(const cppfs::path& cachefile, const std::string& key) {
+    if (traceflag)
+        spdlog::trace("loadCache({})", cachefile.string());
+
+    if (key.empty())
+        return false;
+
+    // only trust caches written by root into a directory only root can change, the cache feeds ACLs and
+    // paths into tools running with privileges
+    auto dirname = cachefile.parent_path().empty() ? cppfs::path(".") : cachefile.parent_path();
+    int dirfd = open(dirname.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+        return false;
+    struct stat st;
+    int fd = -1;
+    if (fstat(dirfd, &st) == 0 && rootOnly(st))
+        fd = openat(dirfd, cachefile.filename().c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    close(dirfd);
+    if (fd < 0) {
+        if (debugflag && errno != ENOENT)
+            spdlog::debug("ignoring untrusted config cache {}", cachefile.string());
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || !rootOnly(st) || st.st_size == 0) {
+        close(fd);
+        if (debugflag)
+            spdlog::debug("ignoring untrusted config cache {}", cachefile.string());
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    bool ok = false;
+    try {
+        CacheReader in(static_cast<const char*>(map), st.st_size);
+        std::string cachedkey;
+        bool current = in.getRaw(cachemagic, sizeof(cachemagic)) && in.get<uint32_t>() == cacheversion;
+        if (current) {
+            in.get(cachedkey);
+            current = (cachedkey == key);
+        }
+        if (current) {
+            Global_config g;
+            in.get(g.clustername);
+            in.get(g.smtphost);
+            in.get(g.mail_from);
+            in.get(g.defaultWorkspace);
+            in.get(g.admins);
+            in.get(g.debugusers);
+            in.get(g.adminmail);
+            g.maxduration = in.get<int32_t>();
+            g.durationdefault = in.get<int32_t>();
+            g.reminderdefault = in.get<int32_t>();
+            g.maxextensions = in.get<int32_t>();
+            g.maxuserworkspaces = in.get<int32_t>();
+            g.dbuid = in.get<int32_t>();
+            g.dbgid = in.get<int32_t>();
+            g.deldirtimeout = in.get<int32_t>();
+            in.get(g.expirerlogpath);
+            g.nsscachettl = in.get<int32_t>();
+            g.nssenumeratethreshold = in.get<int32_t>();
+            g.threads = in.get<int32_t>();
+            in.get(g.mailspool);
+            g.mailrate = in.get<int32_t>();
+            in.get(g.reminderschedule);
+            g.reminderdigest = in.get<uint8_t>() != 0;
+
+            std::map<string, Filesystem_config> fss;
+            auto count = in.get<uint32_t>();
+            for (uint32_t i = 0; i < count; i++) {
+                Filesystem_config fs;
+                in.get(fs.name);
+                in.get(fs.comment);
+                in.get(fs.spaces);
+                in.get(fs.spaceselection);
+                in.get(fs.deletedPath);
+                in.get(fs.database);
+                in.get(fs.groupdefault);
+                in.get(fs.userdefault);
+                in.get(fs.user_acl);
+                in.get(fs.group_acl);
+                in.get(fs.user_acl_table);
+                in.get(fs.group_acl_table);
+                fs.keeptime = in.get<int32_t>();
+                fs.releasekeeptime = in.get<int32_t>();
+                fs.maxduration = in.get<int32_t>();
+                fs.maxextensions = in.get<int32_t>();
+                fs.allocatable = in.get<uint8_t>() != 0;
+                fs.extendable = in.get<uint8_t>() != 0;
+                fs.restorable = in.get<uint8_t>() != 0;
+                fs.metadatarate = in.get<int32_t>();
+                fs.metadataconcurrency = in.get<int32_t>();
+                in.get(fs.deleteorder);
+                fs.expirertimelimit = in.get<int32_t>();
+                fss[fs.name] = std::move(fs);
+            }
+
+            if (in.atEnd()) {
+                global = std::move(g);
+                filesystems = std::move(fss);
+                isvalid = true;
+                fromcache = true;
+                ok = true;
+            }
+        }
+    } catch (const std::exception& e) {
+        if (debugflag)
+            spdlog::debug("bad config cache {}: {}", cachefile.string(), e.what());
+    }
+
+    munmap(map, st.st_size);
+
+    if (debugflag)
+        spdlog::debug("config cache {} {}", cachefile.string(), ok ? "used" : "stale");
+    return ok;
+}
+
+// write cache to temp file and rename it in place, so readers never see partial files
+void Config::writeCache(const cppfs::path& cachefile, const std::string& key) const {
+    if (traceflag)
+        spdlog::trace("writeCache({})", cachefile.string());
+
+    // readers only trust caches of root
+    if (key.empty() || geteuid() != 0)
+        return;
+
+    CacheWriter out;
+    out.putRaw(cachemagic, sizeof(cachemagic));
+    out.put<uint32_t>(cacheversion);
+    out.put(key);
+
+    out.put(global.clustername);
+    out.put(global.smtphost);
+    out.put(global.mail_from);
+    out.put(global.defaultWorkspace);
+    out.put(global.admins);
+    out.put(global.debugusers);
+    out.put(global.adminmail);
+    out.put<int32_t>(global.maxduration);
+    out.put<int32_t>(global.durationdefault);
+    out.put<int32_t>(global.reminderdefault);
+    out.put<int32_t>(global.maxextensions);
+    out.put<int32_t>(global.maxuserworkspaces);
+    out.put<int32_t>(global.dbuid);
+    out.put<int32_t>(global.dbgid);
+    out.put<int32_t>(global.deldirtimeout);
+    out.put(global.expirerlogpath);
+    out.put<int32_t>(global.nsscachettl);
+    out.put<int32_t>(global.nssenumeratethreshold);
+    out.put<int32_t>(global.threads);
+    out.put(global.mailspool);
+    out.put<int32_t>(global.mailrate);
+    out.put(global.reminderschedule);
+    out.put<uint8_t>(global.reminderdigest);
+
+    out.put<uint32_t>(filesystems.size());
+    for (const auto& [name, fs] : filesystems) {
+        out.put(fs.name);
+        out.put(fs.comment);
+        out.put(fs.spaces);
+        out.put(fs.spaceselection);
+        out.put(fs.deletedPath);
+        out.put(fs.database);
+        out.put(fs.groupdefault);
+        out.put(fs.userdefault);
+        out.put(fs.user_acl);
+        out.put(fs.group_acl);
+        out.put(fs.user_acl_table);
+        out.put(fs.group_acl_table);
+        out.put<int32_t>(fs.keeptime);
+        out.put<int32_t>(fs.releasekeeptime);
+        out.put<int32_t>(fs.maxduration);
+        out.put<int32_t>(fs.maxextensions);
+        out.put<uint8_t>(fs.allocatable);
+        out.put<uint8_t>(fs.extendable);
+        out.put<uint8_t>(fs.restorable);
+        out.put<int32_t>(fs.metadatarate);
+        out.put<int32_t>(fs.metadataconcurrency);
+        out.put(fs.deleteorder);
+        out.put<int32_t>(fs.expirertimelimit);
+    }
+
+    std::error_code ec;
+    cppfs::create_directories(cachefile.parent_path(), ec);
+
+    std::string tmpname = cachefile.string() + ".XXXXXX";
+    int fd = mkostemp(tmpname.data(), O_CLOEXEC);
+    if (fd < 0) {
+        if (debugflag)
+            spdlog::debug("can not write config cache {}: {}", cachefile.string(), strerror(errno));
+        return;
+    }
+    bool ok = fchmod(fd, 0644) == 0 && utils::writeAll(fd, out.data());
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tmpname.c_str(), cachefile.c_str()) != 0) {
+        unlink(tmpname.c_str());
+        if (debugflag)
+            spdlog::debug("can not write config cache {}", cachefile.string());
+        return;
+    }
+    if (debugflag)
+        spdlog::debug("wrote config cache {}", cachefile.string());
+}
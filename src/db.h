@@ -52,7 +52,7 @@ class Config;
 class DBEntry {
   public:
     // read from DB file // FIXME: this implies a file
-    virtual void readFromFile(const WsID id, const string filesystem, const string filename) = 0;
+    virtual void readFromFile(const WsID& id, const string& filesystem, const string& filename) = 0;
 
     // write entry to DB after update (read with readEntry)
     virtual void writeEntry() = 0;
@@ -64,28 +64,33 @@ class DBEntry {
     virtual void setExpiration(const time_t timestamp) = 0;
     // change expired time
     virtual void setExpired(const time_t timestamp) = 0;
+    // change time of last reminder mail
+    virtual void setReminderSent(const time_t timestamp) = 0;
     // change release date (mark as released and not expired) and write updated entry and move entry
+    // timestamp is incremented in case of name collision in deleted DB
     virtual void release(time_t& timestamp) = 0;
-    // set expired (not released) can be called by root only
-    virtual void expire(const std::string timestamp) = 0;
+    // set expired (not released) can be called by root only, write updated entry and move entry
+    // timestamp is incremented in case of name collision in deleted DB
+    virtual void expire(time_t& timestamp) = 0;
 
     // consume an extension (writes entry back)
-    virtual void useExtension(const long expiration, const string mail, const int reminder, const string comment) = 0;
+    virtual void useExtension(const long expiration, const string& mail, const int reminder, const string& comment) = 0;
 
     // getters
     virtual long getRemaining() const = 0;
-    virtual string getId() const = 0;
+    virtual const string& getId() const = 0;
     virtual int getExtension() const = 0;
     virtual long getCreation() const = 0;
-    virtual string getWSPath() const = 0;
-    virtual string getMailaddress() const = 0;
-    virtual string getComment() const = 0;
+    virtual const string& getWSPath() const = 0;
+    virtual const string& getMailaddress() const = 0;
+    virtual const string& getComment() const = 0;
     virtual long getExpiration() const = 0;
     virtual long getExpired() const = 0;
     virtual long getReleaseTime() const = 0;
-    virtual string getFilesystem() const = 0;
+    virtual const string& getFilesystem() const = 0;
     virtual long getReminder() const = 0;
-    virtual string getGroup() const = 0;
+    virtual long getReminderSent() const = 0;
+    virtual const string& getGroup() const = 0;
 
     // get config of parent DB
     virtual const Config* getConfig() const = 0;
@@ -102,24 +107,24 @@ class DBEntry {
 class Database {
   public:
     // new DB entry
-    virtual void createEntry(const string id, const string workspace, const long creation, const long expiration,
-                             const long reminder, const int extensions, const bool groupflag, const string group,
-                             const string mailaddress, const string comment) = 0;
+    virtual void createEntry(const string& id, const string& workspace, const long creation, const long expiration,
+                             const long reminder, const int extensions, const bool groupflag, const string& group,
+                             const string& mailaddress, const string& comment) = 0;
 
     // read specific entry
-    virtual std::unique_ptr<DBEntry> readEntry(const WsID id, const bool deleted) = 0;
+    virtual std::unique_ptr<DBEntry> readEntry(const WsID& id, const bool deleted) = 0;
 
     // delete entry, can be a deleted one, wsID has to contain timestamp in that case
-    virtual void deleteEntry(const WsID, const bool deleted) = 0;
+    virtual void deleteEntry(const WsID&, const bool deleted) = 0;
 
     // return a list of entries
-    virtual std::vector<WsID> matchPattern(const string pattern, const string user, const vector<string> groups,
+    virtual std::vector<WsID> matchPattern(const string& pattern, const string& user, const vector<string>& groups,
                                            const bool deleted, const bool groupworkspaces) = 0;
 
     // create workspace directory according to the rules of this Db and return the name
     // has to fix all permissions
-    virtual std::string createWorkspace(const string name, const string user_option, const bool groupflag,
-                                        const bool groupwritable, const string groupname) = 0;
+    virtual std::string createWorkspace(const string& name, const string& user_option, const bool groupflag,
+                                        const bool groupwritable, const string& groupname) = 0;
 
     virtual ~Database() = default; // address-sanitizer needs this
 };
@@ -132,7 +137,7 @@ class DatabaseException : public exception {
   public:
     DatabaseException(const char* msg) : message(msg) {}
 
-    DatabaseException(const std::string msg) : message(msg) {}
+    DatabaseException(const std::string& msg) : message(msg) {}
 
     const char* what() const throw() { return message.c_str(); }
 };
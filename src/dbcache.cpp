@@ -0,0 +1,159 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  dbcache.cpp
+ *
+ *  - read-through cache for any database, keeps listings and parsed entries
+ *    until they are changed through the cache
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#include "dbcache.h"
+#include "fmt/base.h"
+#include "fmt/ranges.h" // IWYU pragma: keep
+
+#include "spdlog/spdlog.h"
+
+using namespace std;
+
+// globals
+extern bool traceflag;
+
+void CachingDatabase::createEntry(const string& id, const string& workspace, const long creation,
+                                  const long expiration, const long reminder, const int extensions,
+                                  const bool groupflag, const string& group, const string& mailaddress,
+                                  const string& comment) {
+    invalidate(id, false, true);
+    backend->createEntry(id, workspace, creation, expiration, reminder, extensions, groupflag, group, mailaddress,
+                         comment);
+}
+
+// read entry from cache, or from backend and keep it
+std::unique_ptr<DBEntry> CachingDatabase::readEntry(const WsID& id, const bool deleted) {
+    if (traceflag)
+        spdlog::trace("CachingDatabase::readEntry({},{})", id, deleted);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find({deleted, id});
+        if (it != entries.end()) {
+            hits++;
+            return std::unique_ptr<DBEntry>(new CachedDBEntry(this, it->second, id, deleted));
+        }
+        misses++;
+    }
+
+    // read outside of lock, this is the expensive part, throws for bad entries
+    std::shared_ptr<DBEntry> entry(backend->readEntry(id, deleted));
+    if (!entry)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.emplace(std::make_pair(deleted, id), entry);
+    return std::unique_ptr<DBEntry>(new CachedDBEntry(this, entry, id, deleted));
+}
+
+void CachingDatabase::deleteEntry(const WsID& id, const bool deleted) {
+    invalidate(id, deleted, true);
+    backend->deleteEntry(id, deleted);
+}
+
+// list from cache, or from backend and keep it
+std::vector<WsID> CachingDatabase::matchPattern(const string& pattern, const string& user, const vector<string>& groups,
+                                                const bool deleted, const bool groupworkspaces) {
+    auto key = fmt::format("{}\n{}\n{}\n{}\n{}", pattern, user, groups, deleted, groupworkspaces);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = listings.find(key);
+        if (it != listings.end())
+            return it->second;
+    }
+
+    auto list = backend->matchPattern(pattern, user, groups, deleted, groupworkspaces);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    listings[key] = list;
+    return list;
+}
+
+std::string CachingDatabase::createWorkspace(const string& name, const string& user_option, const bool groupflag,
+                                             const bool groupwritable, const string& groupname) {
+    return backend->createWorkspace(name, user_option, groupflag, groupwritable, groupname);
+}
+
+// drop cached entry, and listings if membership of DB changed
+void CachingDatabase::invalidate(const WsID& id, const bool deleted, const bool dropListings) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase({deleted, id});
+    if (dropListings)
+        listings.clear();
+}
+
+// modifying calls drop entry from cache before they change the shared object
+
+void CachedDBEntry::readFromFile(const WsID& id, const string& filesystem, const string& filename) {
+    parent_db->invalidate(this->id, deleted, false);
+    entry->readFromFile(id, filesystem, filename);
+}
+
+void CachedDBEntry::writeEntry() {
+    parent_db->invalidate(id, deleted, false);
+    entry->writeEntry();
+}
+
+void CachedDBEntry::remove() {
+    parent_db->invalidate(id, deleted, true);
+    entry->remove();
+}
+
+void CachedDBEntry::setExpiration(const time_t timestamp) {
+    parent_db->invalidate(id, deleted, false);
+    entry->setExpiration(timestamp);
+}
+
+void CachedDBEntry::setExpired(const time_t timestamp) {
+    parent_db->invalidate(id, deleted, false);
+    entry->setExpired(timestamp);
+}
+
+void CachedDBEntry::setReminderSent(const time_t timestamp) {
+    parent_db->invalidate(id, deleted, false);
+    entry->setReminderSent(timestamp);
+}
+
+void CachedDBEntry::release(time_t& timestamp) {
+    parent_db->invalidate(id, deleted, true);
+    entry->release(timestamp);
+}
+
+void CachedDBEntry::expire(time_t& timestamp) {
+    parent_db->invalidate(id, deleted, true);
+    entry->expire(timestamp);
+}
+
+void CachedDBEntry::useExtension(const long expiration, const string& mail, const int reminder, const string& comment) {
+    parent_db->invalidate(id, deleted, false);
+    entry->useExtension(expiration, mail, reminder, comment);
+}
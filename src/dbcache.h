@@ -0,0 +1,126 @@
+#ifndef DBCACHE_H
+#define DBCACHE_H
+
+/*
+ *  hpc-workspace-v2
+ *
+ *  dbcache.h
+ *
+ *  - read-through cache for any database, keeps listings and parsed entries
+ *    until they are changed through the cache
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "db.h"
+
+class CachingDatabase;
+
+// entry handed out by CachingDatabase, shares the parsed entry of the backend with the cache,
+// every modifying call drops it from the cache, so the next readEntry reads it again
+class CachedDBEntry : public DBEntry {
+  private:
+    CachingDatabase* parent_db;
+    std::shared_ptr<DBEntry> entry;
+    WsID id;      // id used to read this entry
+    bool deleted; // read from deleted part of DB
+
+  public:
+    CachedDBEntry(CachingDatabase* pdb, std::shared_ptr<DBEntry> _entry, const WsID& _id, const bool _deleted)
+        : parent_db(pdb), entry(_entry), id(_id), deleted(_deleted) {};
+
+    void readFromFile(const WsID& id, const string& filesystem, const string& filename);
+    void writeEntry();
+    void remove();
+    void setExpiration(const time_t timestamp);
+    void setExpired(const time_t timestamp);
+    void setReminderSent(const time_t timestamp);
+    void release(time_t& timestamp);
+    void expire(time_t& timestamp);
+    void useExtension(const long expiration, const string& mail, const int reminder, const string& comment);
+
+    long getRemaining() const { return entry->getRemaining(); }
+    const string& getId() const { return entry->getId(); }
+    int getExtension() const { return entry->getExtension(); }
+    long getCreation() const { return entry->getCreation(); }
+    const string& getWSPath() const { return entry->getWSPath(); }
+    const string& getMailaddress() const { return entry->getMailaddress(); }
+    const string& getComment() const { return entry->getComment(); }
+    long getExpiration() const { return entry->getExpiration(); }
+    long getExpired() const { return entry->getExpired(); }
+    long getReleaseTime() const { return entry->getReleaseTime(); }
+    const string& getFilesystem() const { return entry->getFilesystem(); }
+    long getReminder() const { return entry->getReminder(); }
+    long getReminderSent() const { return entry->getReminderSent(); }
+    const string& getGroup() const { return entry->getGroup(); }
+
+    const Config* getConfig() const { return entry->getConfig(); }
+};
+
+// decorator for a database, caching results of matchPattern and readEntry
+// changes done by others than the cache are not seen, so the cache should only live
+// for one run of a tool, e.g. one filesystem in ws_expirer
+// failed reads are not cached
+class CachingDatabase : public Database {
+  private:
+    std::unique_ptr<Database> backend;
+
+    std::mutex mutex;
+    std::map<std::pair<bool, WsID>, std::shared_ptr<DBEntry>> entries;
+    std::map<std::string, std::vector<WsID>> listings;
+
+    // statistics
+    long hits = 0;
+    long misses = 0;
+
+  public:
+    CachingDatabase(std::unique_ptr<Database> backend_) : backend(std::move(backend_)) {};
+
+    void createEntry(const string& id, const string& workspace, const long creation, const long expiration,
+                     const long reminder, const int extensions, const bool groupflag, const string& group,
+                     const string& mailaddress, const string& comment);
+
+    std::unique_ptr<DBEntry> readEntry(const WsID& id, const bool deleted);
+
+    void deleteEntry(const WsID&, const bool deleted);
+
+    std::vector<WsID> matchPattern(const string& pattern, const string& user, const vector<string>& groups,
+                                   const bool deleted, const bool groupworkspaces);
+
+    std::string createWorkspace(const string& name, const string& user_option, const bool groupflag,
+                                const bool groupwritable, const string& groupname);
+
+    // drop cached entry, and listings if membership of DB changed
+    void invalidate(const WsID& id, const bool deleted, const bool dropListings);
+
+    // number of readEntry calls served from cache and from backend
+    long getHits() const { return hits; }
+    long getMisses() const { return misses; }
+};
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  dbinmemory.cpp
+ *
+ *  - in-memory database, implementing the same semantics as the v1 format database
+ *    without touching any filesystem, for tests, benchmarks and as backing store
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <unistd.h>
+
+#include "dbinmemory.h"
+#include "fmt/base.h"
+#include "fmt/ranges.h" // IWYU pragma: keep
+#include "user.h"
+#include "utils.h"
+
+#include "spdlog/spdlog.h"
+
+using namespace std;
+
+// globals
+extern bool debugflag;
+extern bool traceflag;
+
+// create new DB entry, replaces existing one like a file would be overwritten
+void InMemoryDatabase::createEntry(const WsID& id, const string& workspace, const long creation, const long expiration,
+                                   const long reminder, const int extensions, const bool groupflag, const string& group,
+                                   const string& mailaddress, const string& comment) {
+    InMemoryRecord record;
+    record.workspace = workspace;
+    record.creation = creation;
+    record.expiration = expiration;
+    record.reminder = reminder;
+    record.extensions = extensions;
+    record.groupflag = groupflag;
+    record.group = group;
+    record.mailaddress = mailaddress;
+    record.comment = comment;
+    storeRecord(id, false, record);
+}
+
+// read entry, throws if it does not exist
+std::unique_ptr<DBEntry> InMemoryDatabase::readEntry(const WsID& id, const bool deleted) {
+    if (traceflag)
+        spdlog::trace("readEntry({},{})", id, deleted);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& map = deleted ? this->deleted : active;
+    auto it = map.find(id);
+    if (it == map.end()) {
+        throw DatabaseException(fmt::format("could not open file {}", id));
+    }
+    return std::unique_ptr<DBEntry>(new InMemoryDBEntry(this, id, fs, deleted, it->second));
+}
+
+// delete entry, ID can include timestamp of deleted workspace
+void InMemoryDatabase::deleteEntry(const string& wsid, const bool deleted) {
+    if (debugflag)
+        spdlog::debug("deleting DB entry {}", wsid);
+    eraseRecord(wsid, deleted);
+}
+
+// get a list of ids of matching DB entries for a user, see FilesystemDBV1::matchPattern
+vector<WsID> InMemoryDatabase::matchPattern(const string& pattern, const string& user, const vector<string>& groups,
+                                            const bool deleted, const bool groupworkspaces) {
+    if (traceflag)
+        spdlog::trace("matchPattern(pattern={},user={},groups={},deleted={},groupworkspace={})", pattern, user, groups,
+                      deleted, groupworkspaces);
+
+    string filepattern;
+    if (groupworkspaces)
+        filepattern = fmt::format("*-{}", pattern);
+    else
+        filepattern = fmt::format("{}-{}", user, pattern);
+
+    vector<WsID> list;
+    const std::unordered_set<string> groupset(groups.begin(), groups.end());
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto const& [id, record] : deleted ? this->deleted : active) {
+        if (!utils::glob_match(filepattern.c_str(), id.c_str()))
+            continue;
+        if (groupworkspaces && !groupset.count(record.group))
+            continue;
+        list.push_back(id);
+    }
+    return list;
+}
+
+// name of workspace as FilesystemDBV1 would create it, without creating anything
+string InMemoryDatabase::createWorkspace(const string& name, const string& user_option, const bool groupflag,
+                                         const bool groupwritable, const string& groupname) {
+    const auto& spaces = config->getFsConfig(fs).spaces;
+    if (spaces.empty()) {
+        throw DatabaseException(fmt::format("no spaces configured for {}", fs));
+    }
+
+    string username = user::getUsername();
+    if (user_option.length() > 0 && getuid() == 0) {
+        username = user_option;
+    }
+
+    return spaces[0] + "/" + username + "-" + name;
+}
+
+// number of entries in active or deleted part
+size_t InMemoryDatabase::size(const bool deleted) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return deleted ? this->deleted.size() : active.size();
+}
+
+// write back record of an entry
+void InMemoryDatabase::storeRecord(const WsID& id, const bool deleted, const InMemoryRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    (deleted ? this->deleted : active)[id] = record;
+}
+
+// store record under new id, but never replace existing one
+bool InMemoryDatabase::insertRecord(const WsID& id, const bool deleted, const InMemoryRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (deleted ? this->deleted : active).emplace(id, record).second;
+}
+
+// remove record
+bool InMemoryDatabase::eraseRecord(const WsID& id, const bool deleted) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (deleted ? this->deleted : active).erase(id) > 0;
+}
+
+// there are no files to read from
+void InMemoryDBEntry::readFromFile(const WsID& id, const string& filesystem, const string& filename) {
+    throw DatabaseException(fmt::format("in-memory DB can not read file {}", filename));
+}
+
+// Use extension or update content of entry, same rules as DBEntryV1::useExtension
+void InMemoryDBEntry::useExtension(const long _expiration, const string& _mailaddress, const int _reminder,
+                                   const string& _comment) {
+    if (_mailaddress != "")
+        data.mailaddress = _mailaddress;
+    if (_reminder != 0)
+        data.reminder = _reminder;
+    if (_comment != "")
+        data.comment = _comment;
+
+    // if root does this, we do not use an extension
+    if ((getuid() != 0) && (_expiration != -1) && (_expiration > data.expiration)) {
+        data.extensions--;
+    }
+    if ((data.extensions < 0) && (getuid() != 0)) {
+        throw DatabaseException("no more extensions!");
+    }
+    if (_expiration != -1) {
+        data.expiration = _expiration;
+    }
+    writeEntry();
+}
+
+void InMemoryDBEntry::setExpiration(const time_t timestamp) { data.expiration = timestamp; }
+
+void InMemoryDBEntry::setExpired(const time_t timestamp) { data.expired = timestamp; }
+
+void InMemoryDBEntry::setReminderSent(const time_t timestamp) { data.remindersent = timestamp; }
+
+// mark as released and move to deleted part
+void InMemoryDBEntry::release(time_t& timestamp) {
+    data.released = time(NULL);
+    moveToDeleted(timestamp);
+}
+
+// mark as expired and move to deleted part
+void InMemoryDBEntry::expire(time_t& timestamp) {
+    data.expired = time(0L);
+    moveToDeleted(timestamp);
+}
+
+// store as <id>-<timestamp>, incrementing timestamp on collision, and remove active record
+void InMemoryDBEntry::moveToDeleted(time_t& timestamp) {
+    WsID target;
+    do {
+        target = fmt::format("{}-{}", id, timestamp);
+        if (parent_db->insertRecord(target, true, data))
+            break;
+        timestamp++;
+    } while (true);
+
+    if (!parent_db->eraseRecord(key, deleted)) {
+        parent_db->eraseRecord(target, true);
+        throw DatabaseException("database entry could not be deleted!");
+    }
+
+    key = target; // entry knows now the new name, for remove
+    deleted = true;
+}
+
+// write data back to DB
+void InMemoryDBEntry::writeEntry() { parent_db->storeRecord(key, deleted, data); }
+
+// remove entry from DB
+void InMemoryDBEntry::remove() { parent_db->eraseRecord(key, deleted); }
+
+long InMemoryDBEntry::getRemaining() const { return data.expiration - time(0L); }
+
+int InMemoryDBEntry::getExtension() const { return data.extensions; }
+
+const string& InMemoryDBEntry::getMailaddress() const { return data.mailaddress; }
+
+const string& InMemoryDBEntry::getComment() const { return data.comment; }
+
+const string& InMemoryDBEntry::getId() const { return id; }
+
+long InMemoryDBEntry::getCreation() const { return data.creation; }
+
+const string& InMemoryDBEntry::getWSPath() const { return data.workspace; }
+
+long InMemoryDBEntry::getExpiration() const { return data.expiration; }
+
+long InMemoryDBEntry::getReleaseTime() const { return data.released; }
+
+long InMemoryDBEntry::getExpired() const { return data.expired; }
+
+const string& InMemoryDBEntry::getFilesystem() const { return filesystem; }
+
+long InMemoryDBEntry::getReminder() const { return data.reminder; }
+
+long InMemoryDBEntry::getReminderSent() const { return data.remindersent; }
+
+const string& InMemoryDBEntry::getGroup() const { return data.group; }
+
+const Config* InMemoryDBEntry::getConfig() const { return parent_db->getconfig(); }
@@ -0,0 +1,160 @@
+#ifndef DBINMEMORY_H
+#define DBINMEMORY_H
+
+/*
+ *  hpc-workspace-v2
+ *
+ *  dbinmemory.h
+ *
+ *  - in-memory database, implementing the same semantics as the v1 format database
+ *    without touching any filesystem, for tests, benchmarks and as backing store
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "config.h"
+#include "db.h"
+
+class InMemoryDatabase;
+
+// content of an entry, as it would be written to a V1 DB file
+struct InMemoryRecord {
+    string workspace;
+    long creation = 0;
+    long expiration = 0;
+    long released = 0;
+    long expired = 0;
+    long reminder = 0;
+    long remindersent = 0;
+    int extensions = 0;
+    bool groupflag = false;
+    string group;
+    string mailaddress;
+    string comment;
+};
+
+// entry of in-memory DB, a copy of the record, changes are visible in DB after writeEntry()
+// and mutations (useExtension, release, expire, remove), like with files
+class InMemoryDBEntry : public DBEntry {
+  private:
+    InMemoryDatabase* parent_db;
+    WsID id;
+    WsID key; // key in DB, is <id>-<timestamp> after release or expire
+    string filesystem;
+    bool deleted; // entry lives in deleted part of DB
+    InMemoryRecord data;
+
+  public:
+    InMemoryDBEntry(InMemoryDatabase* pdb, const WsID& _id, const string& _filesystem, const bool _deleted,
+                    const InMemoryRecord& _data)
+        : parent_db(pdb), id(_id), key(_id), filesystem(_filesystem), deleted(_deleted), data(_data) {};
+
+    // there are no files, always throws
+    void readFromFile(const WsID& id, const string& filesystem, const string& filename);
+
+    void useExtension(const long expiration, const string& mail, const int reminder, const string& comment);
+    void setExpiration(const time_t timestamp);
+    void setExpired(const time_t timestamp);
+    void setReminderSent(const time_t timestamp);
+    void release(time_t& timestamp);
+    void expire(time_t& timestamp);
+    void writeEntry();
+    void remove();
+
+    long getRemaining() const;
+    int getExtension() const;
+    const string& getMailaddress() const;
+    const string& getComment() const;
+    const string& getId() const;
+    long getCreation() const;
+    const string& getWSPath() const;
+    long getExpiration() const;
+    long getReleaseTime() const;
+    long getExpired() const;
+    const string& getFilesystem() const;
+    long getReminder() const;
+    long getReminderSent() const;
+    const string& getGroup() const;
+
+    const Config* getConfig() const;
+
+  private:
+    // store entry in deleted part of DB as <id>-<timestamp> and remove it from active part
+    void moveToDeleted(time_t& timestamp);
+};
+
+// database keeping all entries in memory, thread safe, content is lost with the object
+// opened by Config::openDB for filesystems with "database: :memory:", or constructed directly in tests
+class InMemoryDatabase : public Database {
+  private:
+    const Config* config;
+    string fs;
+
+    std::mutex mutex;
+    std::unordered_map<WsID, InMemoryRecord> active;
+    std::unordered_map<WsID, InMemoryRecord> deleted;
+
+  public:
+    InMemoryDatabase(const Config* config_, const string& fs_) : config(config_), fs(fs_) {};
+
+    // create new DB entry
+    void createEntry(const WsID& id, const string& workspace, const long creation, const long expiration,
+                     const long reminder, const int extensions, const bool groupflag, const string& group,
+                     const string& mailaddress, const string& comment);
+
+    // read entry
+    std::unique_ptr<DBEntry> readEntry(const WsID& id, const bool deleted);
+
+    // delete entry
+    void deleteEntry(const string& wsid, const bool deleted);
+
+    // return list of identifiers of DB entries matching pattern, same rules as FilesystemDBV1
+    std::vector<WsID> matchPattern(const string& pattern, const string& user, const vector<string>& groups,
+                                   const bool deleted, const bool groupworkspaces);
+
+    // return the name a workspace would get in FilesystemDBV1, no directory is created
+    std::string createWorkspace(const string& name, const string& user_option, const bool groupflag,
+                                const bool writable, const string& groupname);
+
+    // access to config
+    const Config* getconfig() const { return config; }
+
+    // access to fs
+    std::string getfs() { return fs; }
+
+    // number of entries in active or deleted part
+    size_t size(const bool deleted);
+
+    // used by entries to write back
+    void storeRecord(const WsID& id, const bool deleted, const InMemoryRecord& record);
+    // store record under new id, but never replace existing one, returns false if id exists
+    bool insertRecord(const WsID& id, const bool deleted, const InMemoryRecord& record);
+    // remove record, returns false if it did not exist
+    bool eraseRecord(const WsID& id, const bool deleted);
+};
+
+#endif
@@ -30,6 +30,7 @@
 
 #include <filesystem>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 // use for speed, but needs testing // FIXME:
@@ -66,6 +67,10 @@
 #include <sys/types.h>
 
 #include <syslog.h>
+// for mkostemp
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
 
 #include <fstream>
 
@@ -85,18 +90,18 @@ extern Cap caps;
 namespace cppfs = std::filesystem;
 
 // create the workspace directory with the structure of this DB
-string FilesystemDBV1::createWorkspace(const string name, const string user_option, const bool groupflag,
-                                       const bool groupwritable, const string groupname) {
+string FilesystemDBV1::createWorkspace(const string& name, const string& user_option, const bool groupflag,
+                                       const bool groupwritable, const string& groupname) {
     string wsdir;
 
     std::string username = user::getUsername(); // current user
 
     int spaceid = 0;
 
-    auto spaces = config->getFsConfig(fs).spaces;
+    const auto& spaces = config->getFsConfig(fs).spaces;
 
     if (spaces.size() > 1) {
-        auto spaceselection = config->getFsConfig(fs).spaceselection;
+        const auto& spaceselection = config->getFsConfig(fs).spaceselection;
         if (debugflag) {
             spdlog::debug("spaceseletion for {} = {}", fs, spaceselection);
         }
@@ -144,15 +149,13 @@ string FilesystemDBV1::createWorkspace(const string name, const string user_opti
 
     // make directory and change owner + permissions
     try {
-        caps.raise_cap({CAP_DAC_OVERRIDE}, utils::SrcPos(__FILE__, __LINE__, __func__));
+        CapScope scope(caps, {CAP_DAC_OVERRIDE}, db_uid, utils::SrcPos(__FILE__, __LINE__, __func__));
         mode_t oldmask = umask(077); // as we create intermediate directories, we better take care of umask!!
         cppfs::create_directories(wsdir);
         umask(oldmask);
-        caps.lower_cap({CAP_DAC_OVERRIDE}, db_uid, utils::SrcPos(__FILE__, __LINE__, __func__));
     } catch (cppfs::filesystem_error const& e) {
         auto uid = getuid();
         auto euid = geteuid();
-        caps.lower_cap({CAP_DAC_OVERRIDE}, db_uid, utils::SrcPos(__FILE__, __LINE__, __func__));
         spdlog::error("could not create workspace directory <{}>!", wsdir);
         if (debugflag) {
             spdlog::debug("error = {}", e.what());
@@ -177,17 +180,15 @@ string FilesystemDBV1::createWorkspace(const string name, const string user_opti
         }
     }
 
-    caps.raise_cap({CAP_CHOWN}, utils::SrcPos(__FILE__, __LINE__, __func__));
+    // one elevated section for owner and permissions
+    CapScope scope(caps, {CAP_CHOWN, CAP_FOWNER}, db_uid, utils::SrcPos(__FILE__, __LINE__, __func__));
 
     if (chown(wsdir.c_str(), tuid, tgid)) {
-        caps.lower_cap({CAP_CHOWN}, db_uid, utils::SrcPos(__FILE__, __LINE__, __func__));
         spdlog::error("could not change owner of workspace!");
         unlink(wsdir.c_str());
         exit(-1); // FIXME: throw
     }
-    caps.lower_cap({CAP_CHOWN}, db_uid, utils::SrcPos(__FILE__, __LINE__, __func__));
 
-    caps.raise_cap({CAP_FOWNER}, utils::SrcPos(__FILE__, __LINE__, __func__));
     mode_t mode = S_IRUSR | S_IWUSR | S_IXUSR;
 
     // group workspaces can be read and listed by group
@@ -200,20 +201,18 @@ string FilesystemDBV1::createWorkspace(const string name, const string user_opti
         mode |= S_IWGRP;
     }
     if (chmod(wsdir.c_str(), mode)) {
-        caps.lower_cap({CAP_FOWNER}, db_uid, utils::SrcPos(__FILE__, __LINE__, __func__));
         spdlog::error("could not change permissions of workspace!");
         unlink(wsdir.c_str());
         exit(-1); // FIXME: throw
     }
-    caps.lower_cap({CAP_FOWNER}, db_uid, utils::SrcPos(__FILE__, __LINE__, __func__));
 
     return wsdir;
 }
 
 // create new DB entry
-void FilesystemDBV1::createEntry(const WsID id, const string workspace, const long creation, const long expiration,
-                                 const long reminder, const int extensions, const bool groupflag, const string group,
-                                 const string mailaddress, const string comment) {
+void FilesystemDBV1::createEntry(const WsID& id, const string& workspace, const long creation, const long expiration,
+                                 const long reminder, const int extensions, const bool groupflag, const string& group,
+                                 const string& mailaddress, const string& comment) {
 
     DBEntryV1 entry(this, id, workspace, creation, expiration, reminder, extensions, groupflag, group, mailaddress,
                     comment);
@@ -223,14 +222,14 @@ void FilesystemDBV1::createEntry(const WsID id, const string workspace, const lo
 // get a list of ids of matching DB entries for a user
 // groupworkspaces flag determines if content of DB entry has to be checked for correct group
 //  unittest: yes
-vector<WsID> FilesystemDBV1::matchPattern(const string pattern, const string user, const vector<string> groups,
+vector<WsID> FilesystemDBV1::matchPattern(const string& pattern, const string& user, const vector<string>& groups,
                                           const bool deleted, const bool groupworkspaces) {
     if (traceflag)
         spdlog::trace("matchPattern(pattern={},user={},groups={},deleted={},groupworkspace={})", pattern, user, groups,
                       deleted, groupworkspaces);
 
     // list directory, this also reads YAML file in case of groupworkspaces
-    auto listdir = [&groupworkspaces, &groups](const string pathname, const string filepattern) -> vector<string> {
+    auto listdir = [&groupworkspaces, &groups](const string& pathname, const string& filepattern) -> vector<string> {
         if (debugflag)
             spdlog::debug("listdir({},{})", pathname, filepattern);
         try {
@@ -239,6 +238,8 @@ vector<WsID> FilesystemDBV1::matchPattern(const string pattern, const string use
                 auto filelist = utils::dirEntries(pathname, filepattern, false);
                 vector<string> list;
                 utils::HasGroupIntersection groupintersection(user::getUsername());
+                // group of entry is a name, hash caller groups once instead of searching list per entry
+                const std::unordered_set<string> groupset(groups.begin(), groups.end());
 
                 for (auto const& f : filelist) {
                     // optimization: check if owner (from filename) has common groups with caller. if not, do not read
@@ -272,7 +273,7 @@ vector<WsID> FilesystemDBV1::matchPattern(const string pattern, const string use
                         group = "";
 #endif
 
-                    if (canFind(groups, group)) {
+                    if (groupset.count(group)) {
                         list.push_back(f);
                     }
                 }
@@ -301,7 +302,7 @@ vector<WsID> FilesystemDBV1::matchPattern(const string pattern, const string use
 
 // read entry
 //  unittest: yes
-std::unique_ptr<DBEntry> FilesystemDBV1::readEntry(const WsID id, const bool deleted) {
+std::unique_ptr<DBEntry> FilesystemDBV1::readEntry(const WsID& id, const bool deleted) {
     if (traceflag)
         spdlog::trace("readEntry({},{})", id, deleted);
     std::unique_ptr<DBEntry> entry(new DBEntryV1(this));
@@ -316,7 +317,7 @@ std::unique_ptr<DBEntry> FilesystemDBV1::readEntry(const WsID id, const bool del
 }
 
 // delete entry, ID can include timestamp of deleted workspace
-void FilesystemDBV1::deleteEntry(const string wsid, const bool deleted) {
+void FilesystemDBV1::deleteEntry(const string& wsid, const bool deleted) {
     cppfs::path dbentrypath;
 
     if (deleted) {
@@ -335,20 +336,21 @@ void FilesystemDBV1::deleteEntry(const string wsid, const bool deleted) {
 }
 
 // constructor to make new entry to write out
-DBEntryV1::DBEntryV1(FilesystemDBV1* pdb, const WsID _id, const string _workspace, const long _creation,
+DBEntryV1::DBEntryV1(FilesystemDBV1* pdb, const WsID& _id, const string& _workspace, const long _creation,
                      const long _expiration, const long _reminder, const int _extensions, const bool _groupflag,
-                     const string _group, const string _mailaddress, const string _comment)
+                     const string& _group, const string& _mailaddress, const string& _comment)
     : parent_db(pdb), id(_id), workspace(_workspace), creation(_creation), expiration(_expiration), reminder(_reminder),
       extensions(_extensions), groupflag(_groupflag), group(_group), mailaddress(_mailaddress), comment(_comment) {
     dbfilepath = pdb->getconfig()->getFsConfig(pdb->getfs()).database + "/" + id;
     // init extra internals here to avoid problems in release builds
     released = 0;
     expired = 0;
+    remindersent = 0;
 }
 
 // read db entry from yaml file
 //  unittest: yes
-void DBEntryV1::readFromFile(const WsID id, const string filesystem, const string filename) {
+void DBEntryV1::readFromFile(const WsID& id, const string& filesystem, const string& filename) {
     if (traceflag)
         spdlog::trace("readFromFile({},{},{})", id, filesystem, filename);
 
@@ -404,6 +406,7 @@ void DBEntryV1::readFromString(std::string str) {
     expiration = dbentry["expiration"] ? dbentry["expiration"].as<long>() : 0;
     expired = dbentry["expired"] ? dbentry["expired"].as<long>() : 0;
     reminder = dbentry["reminder"] ? dbentry["reminder"].as<long>() : 0;
+    remindersent = dbentry["remindersent"] ? dbentry["remindersent"].as<long>() : 0;
     workspace = dbentry["workspace"] ? dbentry["workspace"].as<string>() : "";
     extensions = dbentry["extensions"] ? dbentry["extensions"].as<int>() : 0;
     mailaddress = dbentry["mailaddress"] ? dbentry["mailaddress"].as<string>() : "";
@@ -483,6 +486,11 @@ void DBEntryV1::readFromString(std::string str) {
         node >> reminder;
     else
         reminder = 0;
+    node = dbentry["remindersent"];
+    if (node.has_val())
+        node >> remindersent;
+    else
+        remindersent = 0;
     node = dbentry["workspace"];
     if (node.has_val() && node.val() != "")
         node >> workspace;
@@ -517,8 +525,8 @@ void DBEntryV1::readFromString(std::string str) {
 
 // Use extension or update content of entry
 //  unittest: yes
-void DBEntryV1::useExtension(const long _expiration, const string _mailaddress, const int _reminder,
-                             const string _comment) {
+void DBEntryV1::useExtension(const long _expiration, const string& _mailaddress, const int _reminder,
+                             const string& _comment) {
     if (traceflag)
         spdlog::trace("useExtension(expiration={},mailaddress={},reminder={},comment={})\n");
     if (_mailaddress != "")
@@ -549,15 +557,15 @@ int DBEntryV1::getExtension() const {
     return extensions;
 }
 
-string DBEntryV1::getId() const { return id; }
+const string& DBEntryV1::getId() const { return id; }
 
 long DBEntryV1::getCreation() const { return creation; }
 
-string DBEntryV1::getWSPath() const { return workspace; };
+const string& DBEntryV1::getWSPath() const { return workspace; };
 
-string DBEntryV1::getMailaddress() const { return mailaddress; }
+const string& DBEntryV1::getMailaddress() const { return mailaddress; }
 
-string DBEntryV1::getComment() const { return comment; }
+const string& DBEntryV1::getComment() const { return comment; }
 
 long DBEntryV1::getExpired() const { return expired; }
 
@@ -565,11 +573,13 @@ long DBEntryV1::getExpiration() const { return expiration; }
 
 long DBEntryV1::getReleaseTime() const { return released; }
 
-string DBEntryV1::getFilesystem() const { return filesystem; }
+const string& DBEntryV1::getFilesystem() const { return filesystem; }
 
 long DBEntryV1::getReminder() const { return reminder; }
 
-string DBEntryV1::getGroup() const { return group; }
+long DBEntryV1::getReminderSent() const { return remindersent; }
+
+const string& DBEntryV1::getGroup() const { return group; }
 
 // change expiration time
 void DBEntryV1::setExpiration(const time_t timestamp) { expiration = timestamp; }
@@ -577,124 +587,167 @@ void DBEntryV1::setExpiration(const time_t timestamp) { expiration = timestamp;
 // change expired time
 void DBEntryV1::setExpired(const time_t timestamp) { expired = timestamp; }
 
+// change time of last reminder mail
+void DBEntryV1::setReminderSent(const time_t timestamp) { remindersent = timestamp; }
+
 // change release date (mark as released and not expired)
-// write DB entry
-// move DB entry to releases entries
+// write DB entry into deleted DB and remove it from active DB
+// timestamp can be incremented in case of name collisions
 void DBEntryV1::release(time_t& timestamp_time) {
 
     // TODO: is this ctrl-c save? should it be ignored for all of this?
     // probably ok, even if there is some partial state, ws_expirer would deal with it
 
-    string timestamp = fmt::format("{}", timestamp_time);
-
     released = time(NULL); // now
-    writeEntry();
-
-    auto wsconfig = parent_db->getconfig()->getFsConfig(filesystem);
-    cppfs::path dbtarget = cppfs::path(wsconfig.database) / cppfs::path(wsconfig.deletedPath) /
-                           cppfs::path(fmt::format("{}-{}", id, timestamp));
 
-    if (debugflag)
-        spdlog::debug("dbtarget={}", dbtarget.string());
-
-    caps.raise_cap({CAP_FOWNER, CAP_DAC_OVERRIDE}, utils::SrcPos(__FILE__, __LINE__, __func__));
+    CapScope scope(caps, {CAP_FOWNER, CAP_DAC_OVERRIDE}, parent_db->getconfig()->dbuid(),
+                   utils::SrcPos(__FILE__, __LINE__, __func__));
 
     if (caps.isSetuid()) {
         // for filesystem with root_squash, we need to be DB user here
         if (setegid(parent_db->getconfig()->dbgid()) || seteuid(parent_db->getconfig()->dbuid())) {
-            caps.lower_cap({CAP_DAC_OVERRIDE, CAP_FOWNER}, parent_db->getconfig()->dbuid(),
-                           utils::SrcPos(__FILE__, __LINE__, __func__));
             throw DatabaseException("can not seteuid or setgid. Bad installation?");
         }
     }
 
-    // check if target exists, as std::filesystem::rename does delete target if it exists
-    // in case of collision, delay and wait for 1s resolution (but increment to avoid glitches)
-    if (cppfs::exists(dbtarget)) {
-        spdlog::info("delaying to avoid name collision");
-        sleep(1);
-        timestamp_time++;
-        timestamp = fmt::format("{}", timestamp_time);
-        // create name again with new timestamp
-        dbtarget = cppfs::path(wsconfig.database) / cppfs::path(wsconfig.deletedPath) /
-                   cppfs::path(fmt::format("{}-{}", id, timestamp));
-    }
-
-    // do the rename with collision free name
-    try {
-        if (debugflag)
-            spdlog::debug("rename({}, {})", dbfilepath, dbtarget.string());
-        cppfs::rename(dbfilepath, dbtarget);
-        dbfilepath = dbtarget.string(); // entry knows now the new name, for remove, but is not persistent
-    } catch (const std::filesystem::filesystem_error& e) {
-        caps.lower_cap({CAP_DAC_OVERRIDE, CAP_FOWNER}, parent_db->getconfig()->dbuid(),
-                       utils::SrcPos(__FILE__, __LINE__, __func__));
-        if (debugflag)
-            spdlog::error("{}", e.what());
-        throw DatabaseException("database entry could not be deleted!");
-    }
-
-    caps.lower_cap({CAP_DAC_OVERRIDE, CAP_FOWNER}, parent_db->getconfig()->dbuid(),
-                   utils::SrcPos(__FILE__, __LINE__, __func__));
+    moveToDeleted(timestamp_time);
 }
 
 // set expired (not released)
+// timestamp can be incremented in case of name collisions
 // SPEC: can be called by root only!
 // SPEC: does not work on root_squash!
-void DBEntryV1::expire(const std::string timestamp) {
-    auto wsconfig = parent_db->getconfig()->getFsConfig(filesystem);
-    cppfs::path dbtarget = cppfs::path(wsconfig.database) / cppfs::path(wsconfig.deletedPath) /
-                           cppfs::path(fmt::format("{}-{}", id, timestamp));
+void DBEntryV1::expire(time_t& timestamp_time) {
+    // update expired entry so we can later see when this was expired by this method
+    expired = time(0L); // insteaf of making long from string again, just get time again as in caller
 
-    if (debugflag)
-        spdlog::debug("dbtarget={}", dbtarget.string());
+    moveToDeleted(timestamp_time);
+}
 
-    // DB part
+// write entry into a temp file in the deleted DB, with final permissions set through the file descriptor,
+// publish it as <id>-<timestamp> with a rename that never replaces an existing entry, and remove the
+// active entry afterwards. Compared to write in place + chmod + chown + exists + rename, this saves
+// several round trips on NFS. On name collision timestamp is incremented instead of waiting.
+void DBEntryV1::moveToDeleted(time_t& timestamp_time) {
+    auto config = parent_db->getconfig();
+    auto deleteddir = cppfs::path(config->database(filesystem)) / config->deletedPath(filesystem);
 
-    // update expired entry so we can later see when this was expired by this method
-    expired = time(0L); // insteaf of making long from string again, just get time again as in caller
-    writeEntry();
+    std::string entry = serialize();
 
-    // filesystem part
-    try {
+    // suppress ctrl-c to prevent broken DB entries when FS is hanging and user gets nervous
+    signal(SIGINT, SIG_IGN);
+
+    // no '-' in the name, so pattern matching of DB never sees temp files
+    std::string tmpname = (deleteddir / ".ws_tmp_XXXXXX").string();
+    int fd = mkostemp(tmpname.data(), O_CLOEXEC);
+    if (fd < 0) {
+        signal(SIGINT, SIG_DFL);
+        if (debugflag)
+            spdlog::debug("mkostemp({}) -> {}", tmpname, std::strerror(errno));
+        throw DatabaseException("database entry could not be deleted!");
+    }
+
+    bool ok = utils::writeAll(fd, entry);
+    if (fchmod(fd, filePermissions()) != 0) {
+        spdlog::error("could not change permissions of database entry");
+        if (debugflag)
+            spdlog::error("{}", std::strerror(errno));
+    }
+    if (caps.isSetuid()) {
+        // root for chown, back to DB user afterwards
+        CapScope scope(caps, {CAP_CHOWN}, config->dbuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+        if (fchown(fd, config->dbuid(), config->dbgid()) != 0) {
+            spdlog::error("could not change owner of database entry.");
+        }
+    }
+    if (close(fd) != 0) {
+        ok = false;
+    }
+
+    if (!ok) {
+        unlink(tmpname.c_str());
+        signal(SIGINT, SIG_DFL);
+        spdlog::error("could not write DB file!");
+        throw DatabaseException("database entry could not be deleted!");
+    }
+
+    // publish, on collision try next second
+    cppfs::path dbtarget;
+    int err = 0;
+    for (;;) {
+        dbtarget = deleteddir / fmt::format("{}-{}", id, timestamp_time);
         if (debugflag)
-            spdlog::debug("rename({}, {})", dbfilepath, dbtarget.string());
-        cppfs::rename(dbfilepath, dbtarget);
-        dbfilepath = dbtarget.string(); // entry knows now the new name, for remove, but is not persistent
-    } catch (const std::filesystem::filesystem_error& e) {
+            spdlog::debug("renameNoReplace({}, {})", tmpname, dbtarget.string());
+        err = utils::renameNoReplace(tmpname.c_str(), dbtarget.c_str()) == 0 ? 0 : errno;
+        if (err != EEXIST)
+            break;
+        spdlog::info("name collision for {}, incrementing timestamp", dbtarget.string());
+        timestamp_time++;
+    }
+
+    if (err != 0) {
         if (debugflag)
-            spdlog::error("{}", e.what());
+            spdlog::error("{}", std::strerror(err));
+        unlink(tmpname.c_str());
+        signal(SIGINT, SIG_DFL);
         throw DatabaseException("database entry could not be deleted!");
     }
+    // link fallback of renameNoReplace can leave the temp file behind, as second link of the target
+    struct stat tmpstat, targetstat;
+    if (lstat(tmpname.c_str(), &tmpstat) == 0 && lstat(dbtarget.c_str(), &targetstat) == 0 &&
+        tmpstat.st_dev == targetstat.st_dev && tmpstat.st_ino == targetstat.st_ino) {
+        if (unlink(tmpname.c_str()) != 0)
+            spdlog::error("could not remove temporary file {} ({})", tmpname, std::strerror(errno));
+    }
+
+    // remove active entry, undo publish if that fails, to avoid an entry being active and deleted at once
+    if (unlink(dbfilepath.c_str()) != 0) {
+        if (debugflag)
+            spdlog::error("unlink({}) -> {}", dbfilepath, std::strerror(errno));
+        unlink(dbtarget.c_str());
+        signal(SIGINT, SIG_DFL);
+        throw DatabaseException("database entry could not be deleted!");
+    }
+
+    dbfilepath = dbtarget.string(); // entry knows now the new name, for remove, but is not persistent
+
+    // normal signal handling
+    signal(SIGINT, SIG_DFL);
 }
 
 // remove DB entry
 void DBEntryV1::remove() {
-    caps.raise_cap({CAP_DAC_OVERRIDE}, utils::SrcPos(__FILE__, __LINE__, __func__));
+    {
+        CapScope scope(caps, {CAP_DAC_OVERRIDE}, getConfig()->dbuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
 
-    if (caps.isSetuid()) {
-        // for filesystem with root_squash, we need to be DB user here
-        if (setegid(getConfig()->dbgid()) || seteuid(getConfig()->dbuid())) {
-            spdlog::error("can not setuid, bad installation?");
+        if (caps.isSetuid()) {
+            // for filesystem with root_squash, we need to be DB user here
+            if (setegid(getConfig()->dbgid()) || seteuid(getConfig()->dbuid())) {
+                spdlog::error("can not setuid, bad installation?");
+            }
         }
-    }
-
-    if (debugflag)
-        spdlog::debug("deleting db entry file {}", dbfilepath);
 
-    cppfs::remove(dbfilepath);
+        if (debugflag)
+            spdlog::debug("deleting db entry file {}", dbfilepath);
 
-    caps.lower_cap({CAP_DAC_OVERRIDE}, getConfig()->dbuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+        cppfs::remove(dbfilepath);
+    }
 
     syslog(LOG_INFO, "removed db entry <%s> for user <%s>.", id.c_str(), user::getUsername().c_str());
 }
 
-// write data to file
-//  unittest: yes
-void DBEntryV1::writeEntry() {
-    if (traceflag)
-        spdlog::trace("writeEntry()");
-    int perm;
+// permissions of DB entry file
+int DBEntryV1::filePermissions() const {
+    if (group.length() > 0) {
+        // for group workspaces, we set the x-bit
+        return 0744;
+    } else {
+        return 0644;
+    }
+}
+
+// serialize entry to YAML
+std::string DBEntryV1::serialize() const {
 #ifndef WS_RAPIDYAML_DB
     YAML::Node entry;
     entry["workspace"] = workspace;
@@ -706,6 +759,9 @@ void DBEntryV1::writeEntry() {
     entry["extensions"] = extensions;
     entry["acctcode"] = "";
     entry["reminder"] = reminder;
+    if (remindersent > 0) {
+        entry["remindersent"] = remindersent;
+    }
     entry["mailaddress"] = mailaddress;
     if (groupflag && group.length() > 0) {
         entry["group"] = group;
@@ -714,6 +770,8 @@ void DBEntryV1::writeEntry() {
         entry["released"] = released;
     }
     entry["comment"] = comment;
+
+    return YAML::Dump(entry);
 #else
     ryml::Tree tree;
     ryml::NodeRef root = tree.rootref();
@@ -727,6 +785,9 @@ void DBEntryV1::writeEntry() {
     root["extensions"] << extensions;
     root["acctcode"] << "";
     root["reminder"] << reminder;
+    if (remindersent > 0) {
+        root["remindersent"] << remindersent;
+    }
     root["mailaddress"] << mailaddress;
     if (groupflag && group.length() > 0) {
         root["group"] << group;
@@ -736,22 +797,32 @@ void DBEntryV1::writeEntry() {
     }
     root["comment"] << comment;
 
-    std::string entry = ryml::emitrs_yaml<std::string>(tree);
+    return ryml::emitrs_yaml<std::string>(tree);
 #endif
+}
+
+// write data to file
+//  unittest: yes
+void DBEntryV1::writeEntry() {
+    if (traceflag)
+        spdlog::trace("writeEntry()");
+
+    std::string entry = serialize();
 
     // suppress ctrl-c to prevent broken DB entries when FS is hanging and user gets nervous
     signal(SIGINT, SIG_IGN);
 
-    caps.raise_cap({CAP_DAC_OVERRIDE},
-                   utils::SrcPos(__FILE__, __LINE__, __func__)); // === Section with raised capabuility START ====
-
     long dbgid = 0, dbuid = 0;
-
     if (user::isSetuid()) {
-        // for filesystem with root_squash, we need to be DB user here
         dbuid = parent_db->getconfig()->dbuid();
         dbgid = parent_db->getconfig()->dbgid();
+    }
 
+    // === Section with raised capabilities, one for write, chmod and chown ====
+    CapScope scope(caps, {CAP_DAC_OVERRIDE, CAP_FOWNER}, dbuid, utils::SrcPos(__FILE__, __LINE__, __func__));
+
+    if (user::isSetuid()) {
+        // for filesystem with root_squash, we need to be DB user here
         if (debugflag)
             spdlog::debug("isSetuid -> dbuid={}, dbgid={}", dbuid, dbgid);
 
@@ -782,29 +853,18 @@ void DBEntryV1::writeEntry() {
     }
     fout.close();
 
-    if (group.length() > 0) {
-        // for group workspaces, we set the x-bit
-        perm = 0744;
-    } else {
-        perm = 0644;
-    }
-
-    caps.raise_cap({CAP_FOWNER}, utils::SrcPos(__FILE__, __LINE__, __func__));
-    if (chmod(dbfilepath.c_str(), perm) != 0) {
+    if (chmod(dbfilepath.c_str(), filePermissions()) != 0) {
         spdlog::error("could not change permissions of database entry");
         if (debugflag)
             spdlog::error("{}", std::strerror(errno));
     }
 
-    caps.lower_cap({CAP_FOWNER, CAP_DAC_OVERRIDE}, dbuid, utils::SrcPos(__FILE__, __LINE__, __func__));
-
     if (caps.isSetuid()) {
-        caps.raise_cap({CAP_CHOWN}, utils::SrcPos(__FILE__, __LINE__, __func__));
+        // nested scope switches to root for chown and back to DB user
+        CapScope chownscope(caps, {CAP_CHOWN}, dbuid, utils::SrcPos(__FILE__, __LINE__, __func__));
         if (chown(dbfilepath.c_str(), dbuid, dbgid)) {
-            caps.lower_cap({CAP_CHOWN}, dbuid, utils::SrcPos(__FILE__, __LINE__, __func__));
             spdlog::error("could not change owner of database entry.");
         }
-        caps.lower_cap({CAP_CHOWN}, dbuid, utils::SrcPos(__FILE__, __LINE__, __func__));
     }
 
     // normal signal handling
@@ -62,6 +62,7 @@ class DBEntryV1 : public DBEntry {
     long released;     // epoch time of manual release
     long expired;      // epoch time when expirer actually expired this file
     long reminder;     // epoch time of reminder to be sent out
+    long remindersent; // epoch time of last reminder mail sent by ws_expirer
     int extensions;    // extensions, counting down
     // internal flag, here to avoid order warnings, does not end in DB
     bool groupflag;     // flag to mark group workspaces
@@ -74,25 +75,27 @@ class DBEntryV1 : public DBEntry {
     // simple constructor to read from file
     DBEntryV1(FilesystemDBV1* pdb) : parent_db(pdb) {};
     // constructor to make new entry to write out
-    DBEntryV1(FilesystemDBV1* pdb, const WsID _id, const string _workspace, const long _creation,
+    DBEntryV1(FilesystemDBV1* pdb, const WsID& _id, const string& _workspace, const long _creation,
               const long _expiration, const long _reminder, const int _extensions, const bool _groupflag,
-              const string _group, const string _mailaddress, const string _comment);
+              const string& _group, const string& _mailaddress, const string& _comment);
 
     // read yaml entry from string
     void readFromString(std::string str);
     // read yaml entry from file
-    void readFromFile(const WsID id, const string filesystem, const string filename);
+    void readFromFile(const WsID& id, const string& filesystem, const string& filename);
 
     // use extension and write back file
-    void useExtension(const long expiration, const string mail, const int reminder, const string comment);
+    void useExtension(const long expiration, const string& mail, const int reminder, const string& comment);
     // change expiration time
     void setExpiration(const time_t timestamp);
     // change expired time
     void setExpired(const time_t timestamp);
+    // change time of last reminder mail
+    void setReminderSent(const time_t timestamp);
     // change release date (mark as released and not expired) and write updated entry and move entry
     void release(time_t& timestamp);
     // set expired (not released) can be called by root only
-    void expire(const std::string timestamp);
+    void expire(time_t& timestamp);
     // write entry to DB after update (read with readEntry) or creation
     void writeEntry();
     // remove entry from DB
@@ -100,20 +103,29 @@ class DBEntryV1 : public DBEntry {
 
     long getRemaining() const;
     int getExtension() const;
-    string getMailaddress() const;
-    string getComment() const;
-    string getId() const;
+    const string& getMailaddress() const;
+    const string& getComment() const;
+    const string& getId() const;
     long getCreation() const;
-    string getWSPath() const;
+    const string& getWSPath() const;
     long getExpiration() const;
     long getReleaseTime() const;
     long getExpired() const;
-    string getFilesystem() const;
+    const string& getFilesystem() const;
     long getReminder() const;
-    string getGroup() const;
+    long getReminderSent() const;
+    const string& getGroup() const;
 
     // return config of parent DB
     const Config* getConfig() const;
+
+  private:
+    // YAML representation of entry as written to DB
+    std::string serialize() const;
+    // permissions of DB entry file
+    int filePermissions() const;
+    // write entry to deleted DB as <id>-<timestamp> and remove it from active DB
+    void moveToDeleted(time_t& timestamp);
 };
 
 // implementation of V1 DB format from workspace++
@@ -123,29 +135,29 @@ class FilesystemDBV1 : public Database {
     string fs;
 
   public:
-    FilesystemDBV1(const Config* config_, const string fs_) : config(config_), fs(fs_) {};
+    FilesystemDBV1(const Config* config_, const string& fs_) : config(config_), fs(fs_) {};
 
     // create new DB entry
-    void createEntry(const WsID id, const string workspace, const long creation, const long expiration,
-                     const long reminder, const int extensions, const bool groupflag, const string group,
-                     const string mailaddress, const string comment);
+    void createEntry(const WsID& id, const string& workspace, const long creation, const long expiration,
+                     const long reminder, const int extensions, const bool groupflag, const string& group,
+                     const string& mailaddress, const string& comment);
 
     // read entry
-    std::unique_ptr<DBEntry> readEntry(const WsID id, const bool deleted);
+    std::unique_ptr<DBEntry> readEntry(const WsID& id, const bool deleted);
 
     // delete entry
-    void deleteEntry(const string wsid, const bool deleted);
+    void deleteEntry(const string& wsid, const bool deleted);
 
     // return list of identifiers of DB entries matching pattern from filesystem or all valid filesystems
     //  does not check if request for "deleted" is valid, has to be done on caller side
     //  throws IO exceptions in case of access problems
-    std::vector<WsID> matchPattern(const string pattern, const string user, const vector<string> groups,
+    std::vector<WsID> matchPattern(const string& pattern, const string& user, const vector<string>& groups,
                                    const bool deleted, const bool groupworkspaces);
 
     // create workspace directory according to rules of this DB
     // and return the name
-    std::string createWorkspace(const string name, const string user_option, const bool groupflag, const bool writable,
-                                const string groupname);
+    std::string createWorkspace(const string& name, const string& user_option, const bool groupflag,
+                                const bool writable, const string& groupname);
 
     // access to config
     const Config* getconfig() const { return config; }
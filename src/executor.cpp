@@ -0,0 +1,261 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  executor.cpp
+ *
+ *  - work stealing executor shared by all parallel code of a tool
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <optional>
+#include <string>
+
+#include "spdlog/spdlog.h"
+
+#include "executor.h"
+
+extern bool debugflag;
+
+// upper limit for thread count, protects against typos like WS_THREADS=-1
+static const unsigned maxthreads = 1024;
+
+// worker of which executor is running this thread, -1 for other threads
+static thread_local const Executor* current_executor = nullptr;
+static thread_local long current_worker = -1;
+
+Executor& Executor::instance() {
+    static Executor executor;
+    return executor;
+}
+
+unsigned Executor::threadCount(const unsigned option, const int configured, const unsigned minimum) {
+    unsigned count = option;
+
+    if (count == 0) {
+        const char* env_threads = std::getenv("WS_THREADS");
+        if (env_threads != nullptr && std::string(env_threads) != "") {
+            try {
+                count = std::stoul(env_threads);
+                if (count == 0)
+                    count = 1;
+                if (debugflag) {
+                    spdlog::debug("Using WS_THREADS={} from environment", count);
+                }
+            } catch (...) {
+                spdlog::warn("Invalid WS_THREADS value '{}', using default", env_threads);
+            }
+        }
+    }
+
+    if (count == 0 && configured > 0)
+        count = configured;
+
+    if (count == 0) {
+        count = std::thread::hardware_concurrency();
+        if (count == 0)
+            count = 1; // fallback if hardware_concurrency fails
+    }
+
+    if (count < minimum) {
+        if (debugflag) {
+            spdlog::debug("thread count {} too low, increasing to {}", count, minimum);
+        }
+        count = minimum;
+    }
+
+    return std::min(count, maxthreads);
+}
+
+void Executor::start(const unsigned threads_, std::function<void()> init) {
+    stop();
+
+    threads = std::max(1u, threads_);
+    stopping = false;
+
+    if (debugflag) {
+        spdlog::debug("starting executor with {} threads", threads);
+    }
+
+    // calling thread is one of the threads
+    queues.clear();
+    for (unsigned i = 0; i + 1 < threads; i++)
+        queues.push_back(std::make_unique<PathWorkStealingQueue<Job>>());
+    for (unsigned i = 0; i + 1 < threads; i++)
+        workers.emplace_back(&Executor::workerLoop, this, i, init);
+}
+
+void Executor::stop() {
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepmutex);
+        wakeup.notify_all();
+    }
+    for (auto& worker : workers) {
+        // exit() called from a task, can not join ourself
+        if (worker.get_id() == std::this_thread::get_id())
+            worker.detach();
+        else if (worker.joinable())
+            worker.join();
+    }
+    workers.clear();
+}
+
+void Executor::submit(Job&& job) {
+    if (current_executor == this && current_worker >= 0) {
+        auto& queue = *queues[current_worker];
+        // own queue is full, do it right away instead of waiting for thieves
+        if (queue.size() >= queue.capacity() / 2) {
+            execute(job);
+            return;
+        }
+        queue.push(std::move(job));
+    } else {
+        std::lock_guard<std::mutex> lock(injectmutex);
+        injected.push_back(std::move(job));
+    }
+
+    if (sleepers.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(sleepmutex);
+        wakeup.notify_one();
+    }
+}
+
+bool Executor::runOne() {
+    std::optional<Job> job;
+
+    // newest own task first, it is most likely in cache
+    if (current_executor == this && current_worker >= 0)
+        job = queues[current_worker]->pop();
+
+    if (!job) {
+        std::lock_guard<std::mutex> lock(injectmutex);
+        if (!injected.empty()) {
+            job = std::move(injected.front());
+            injected.pop_front();
+        }
+    }
+
+    // oldest task of others, which is most likely the biggest one
+    if (!job) {
+        size_t start = current_executor == this && current_worker >= 0 ? current_worker + 1 : 0;
+        for (size_t i = 0; i < queues.size() && !job; i++) {
+            size_t victim = (start + i) % queues.size();
+            if (static_cast<long>(victim) != current_worker || current_executor != this)
+                job = queues[victim]->steal();
+        }
+    }
+
+    if (!job)
+        return false;
+
+    execute(*job);
+    return true;
+}
+
+void Executor::execute(Job& job) {
+    try {
+        job.task();
+    } catch (...) {
+        // waiter of the group rethrows it
+        std::lock_guard<std::mutex> lock(job.group->mutex);
+        if (!job.group->error)
+            job.group->error = std::current_exception();
+    }
+    job.group->finish();
+}
+
+void Executor::workerLoop(const size_t id, std::function<void()> init) {
+    current_executor = this;
+    current_worker = id;
+    if (init)
+        init();
+
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (runOne())
+            continue;
+        // nothing to do, sleep until new work is submitted, timeout covers missed wakeups
+        std::unique_lock<std::mutex> lock(sleepmutex);
+        sleepers++;
+        wakeup.wait_for(lock, std::chrono::milliseconds(2));
+        sleepers--;
+    }
+}
+
+void Executor::TaskGroup::run(Task task) {
+    pending.fetch_add(1, std::memory_order_acq_rel);
+    executor.submit(Job{std::move(task), this});
+}
+
+void Executor::TaskGroup::finish() {
+    long count = pending.load(std::memory_order_acquire);
+    while (count > 1) {
+        if (pending.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+            return;
+    }
+    // probably the last one, the waiter may destroy the group as soon as it sees 0,
+    // so it is only reached with the mutex held, which the waiter takes before returning
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        done.notify_all();
+}
+
+void Executor::TaskGroup::waitIdle() {
+    while (true) {
+        // help as long as there is work
+        while (pending.load(std::memory_order_acquire) > 0 && executor.runOne())
+            ;
+        // remaining tasks run in other threads, sleep until the last one finished.
+        // timeout covers tasks submitted meanwhile, which this thread can help with
+        std::unique_lock<std::mutex> lock(mutex);
+        if (done.wait_for(lock, std::chrono::milliseconds(2),
+                          [this] { return pending.load(std::memory_order_acquire) == 0; }))
+            return;
+    }
+}
+
+void Executor::TaskGroup::wait() {
+    waitIdle();
+    std::exception_ptr failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(failed, error);
+    }
+    if (failed)
+        std::rethrow_exception(failed);
+}
+
+Executor::TaskGroup::~TaskGroup() {
+    waitIdle();
+    if (error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::exception& e) {
+            spdlog::error("parallel task failed: {}", e.what());
+        } catch (...) {
+            spdlog::error("parallel task failed");
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+/*
+ *  hpc-workspace-v2
+ *
+ *  executor.h
+ *
+ *  - work stealing executor shared by all parallel code of a tool
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PathWorkStealingQueue.hpp"
+
+// one pool of threads per process, every worker owns a PathWorkStealingQueue, idle workers steal.
+// tasks can spawn tasks and wait for them, a waiting thread executes other tasks meanwhile,
+// so nested parallel code (e.g. workspaces in parallel, directories of each workspace in parallel)
+// never runs more threads than configured.
+// the thread calling wait() counts as one of the threads, threads==1 runs everything in the caller.
+class Executor {
+  public:
+    using Task = std::function<void()>;
+
+    // set of tasks to wait for, tasks may add further tasks to their own group
+    class TaskGroup {
+      private:
+        Executor& executor;
+        std::atomic<long> pending{0};
+        std::mutex mutex; // guards error, last task completes under it
+        std::condition_variable done;
+        std::exception_ptr error; // first exception of a task
+        friend class Executor;
+
+        // task completed, wakes the waiter when it was the last one
+        void finish();
+        void waitIdle();
+
+      public:
+        explicit TaskGroup(Executor& executor_ = Executor::instance()) : executor(executor_) {};
+        // waits, exceptions not fetched with wait() are logged
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        // run task asynchronously
+        void run(Task task);
+        // wait for all tasks of this group, executes tasks while there are some, sleeps otherwise.
+        // rethrows the first exception thrown by a task of the group
+        void wait();
+    };
+
+  private:
+    struct Job {
+        Task task;
+        TaskGroup* group = nullptr;
+    };
+
+    std::vector<std::unique_ptr<PathWorkStealingQueue<Job>>> queues; // one per worker
+    std::vector<std::thread> workers;
+    std::mutex injectmutex;
+    std::deque<Job> injected; // tasks submitted by threads not belonging to the executor
+
+    std::atomic<bool> stopping{false};
+    std::mutex sleepmutex;
+    std::condition_variable wakeup;
+    std::atomic<int> sleepers{0};
+
+    unsigned threads = 1;
+
+    void submit(Job&& job);
+    // execute one pending task, false if nothing was found
+    bool runOne();
+    void execute(Job& job);
+    void workerLoop(const size_t id, std::function<void()> init);
+    void stop();
+
+  public:
+    Executor() = default;
+    ~Executor() { stop(); }
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // the executor of this process
+    static Executor& instance();
+
+    // (re)start with given number of threads, including the calling thread, only call while idle.
+    // init is called first in every new thread, e.g. to set up thread local state
+    void start(const unsigned threads_, std::function<void()> init = {});
+    unsigned getThreads() const { return threads; }
+
+    // call f(i) for all i in [begin, end) and wait for completion, can be used from within tasks
+    template <typename F> void parallel_for(const size_t begin, const size_t end, F&& f) {
+        if (begin >= end)
+            return;
+        // some chunks per thread, so stealing can balance uneven work
+        size_t chunks = std::min<size_t>(end - begin, std::max(1u, threads) * 4);
+        size_t chunksize = (end - begin + chunks - 1) / chunks;
+        TaskGroup group(*this);
+        for (size_t first = begin; first < end; first += chunksize) {
+            size_t last = std::min(end, first + chunksize);
+            group.run([&f, first, last] {
+                for (size_t i = first; i < last; i++)
+                    f(i);
+            });
+        }
+        group.wait();
+    }
+
+    // number of threads to use: command line option, WS_THREADS environment variable, config, number of cores,
+    // first one set (>0) wins. minimum is for I/O bound callers, which mostly wait for metadata servers
+    static unsigned threadCount(const unsigned option, const int configured, const unsigned minimum = 1);
+};
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  listing.cpp
+ *
+ *  - printing of DB entries for ws_list, does not allocate per entry
+ *    (all strings are references into entry and config, or live on the stack)
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fmt/base.h"
+#include "fmt/color.h"
+#include "fmt/format.h" // IWYU pragma: keep
+
+#include "listing.h"
+#include "utils.h"
+
+namespace cppfs = std::filesystem;
+
+using namespace std;
+
+// Mutex for synchronizing output from multiple threads
+static mutex print_entry_mtx;
+
+// newline and indentation for fields longer than their column in table format
+static string_view wrapColumn(const size_t length, const size_t width, const size_t indent) {
+    static const string wrap = "\n" + string(128, ' ');
+    return length > width ? string_view(wrap).substr(0, indent) : string_view();
+}
+
+// time left until deletion of an expired or released entry
+static long remainingUntilDeletion(const DBEntry* entry, const Filesystem_config& fsconfig) {
+    long remaining;
+    if (entry->getReleaseTime() != 0) {
+        remaining = (entry->getReleaseTime() + (fsconfig.releasekeeptime * 86400)) - time(0L);
+    } else {
+        remaining = (entry->getExpired() + (fsconfig.keeptime * 86400)) - time(0L);
+        if (remaining == 0) { // compatability with v1 --> get expiration from the name if expired is not defined
+            const auto& id = entry->getId();
+            remaining = (std::strtol(id.c_str() + id.rfind('-') + 1, nullptr, 10) + (fsconfig.keeptime * 86400)) -
+                        time(0L);
+        }
+    }
+    return remaining;
+}
+
+// Helper to get masked ID for display, respecting admin/root privileges
+string_view getMaskedID(const DBEntry* entry, const user::Identity& identity) {
+    if (identity.admin) {
+        return entry->getId();
+    } else {
+        return utils::getIDView(identity.username, entry->getId());
+    }
+}
+
+// print only masked ID
+void print_entry_short(const DBEntry* entry, const user::Identity& identity) {
+    lock_guard<mutex> lock(print_entry_mtx);
+    fmt::println("{}", getMaskedID(entry, identity));
+}
+
+// print entry in traditional format, one below each other, multiline
+void print_entry(const DBEntry* entry, const Config& config, const user::Identity& identity, const bool verbose,
+                 const bool terse, const bool permissions, const bool listexpired) {
+    lock_guard<mutex> lock(print_entry_mtx);
+    char timebuf[80];
+
+    fmt::println("Id: {}", getMaskedID(entry, identity));
+
+    fmt::println("    workspace directory  : {}", entry->getWSPath());
+    long remaining;
+    const auto& fsconfig = config.getFsConfig(entry->getFilesystem());
+
+    if (!listexpired) {
+        remaining = entry->getRemaining();
+        fmt::println("    remaining time       : {} days, {} hours", remaining / (24 * 3600),
+                     (remaining % (24 * 3600)) / 3600);
+    } else {
+        fmt::println("    remaining time       : {}", entry->getReleaseTime() != 0 ? "released" : "expired");
+        remaining = remainingUntilDeletion(entry, fsconfig);
+
+        if (remaining <= 0) {
+            fmt::println("    until deletion       : 0 days, 0 hours");
+        } else {
+            fmt::println("    until deletion       : {} days, {} hours", remaining / (24 * 3600),
+                         (remaining % (24 * 3600)) / 3600);
+        }
+    }
+
+    if (!terse) {
+        if (entry->getComment() != "")
+            fmt::println("    comment              : {}", entry->getComment());
+        if (entry->getCreation() > 0)
+            fmt::println("    creation time        : {}", utils::ctime(entry->getCreation(), timebuf, sizeof(timebuf)));
+        fmt::println("    expiration time      : {}", utils::ctime(entry->getExpiration(), timebuf, sizeof(timebuf)));
+        if (entry->getExpired() > 0)
+            fmt::println("    expired time         : {}", utils::ctime(entry->getExpired(), timebuf, sizeof(timebuf)));
+        if (entry->getReleaseTime() > 0)
+            fmt::println("    release time         : {}",
+                         utils::ctime(entry->getReleaseTime(), timebuf, sizeof(timebuf)));
+        if (entry->getGroup() != "")
+            fmt::println("    group                : {}", entry->getGroup());
+        fmt::println("    filesystem name      : {}", entry->getFilesystem());
+    }
+    fmt::println("    available extensions : {}", entry->getExtension());
+    if (verbose) {
+        long rd = (entry->getExpiration() - (entry->getReminder() * 24 * 3600));
+        fmt::println("    reminder             : {}", utils::ctime(rd, timebuf, sizeof(timebuf)));
+        if (entry->getMailaddress() != "")
+            fmt::println("    mailaddress          : {}", entry->getMailaddress());
+    }
+
+    if (permissions) {
+        // stat instead of std::filesystem::status, to avoid building a path object
+        struct stat st;
+        auto perm = stat(entry->getWSPath().c_str(), &st) == 0 ? cppfs::perms(st.st_mode & 07777)
+                                                                 : cppfs::perms::unknown;
+        fmt::println("    permissions          : {}", utils::permstring(perm));
+    }
+}
+
+// print entry as line of a table, prints header before first entry
+void print_entry_tableformat(const DBEntry* entry, const Config& config, const user::Identity& identity,
+                             [[maybe_unused]] const bool verbose, const bool terse,
+                             [[maybe_unused]] const bool permissions, const bool listexpired) {
+    static bool headerprinted = false;
+    static bool color_checked = false;
+    static bool color_output = true;
+    static mutex mtx; // protect static variables
+
+    long remaining;
+    const auto& fsconfig = config.getFsConfig(entry->getFilesystem());
+
+    if (!listexpired) {
+        remaining = entry->getRemaining();
+    } else {
+        remaining = remainingUntilDeletion(entry, fsconfig);
+    }
+
+    const auto ID = getMaskedID(entry, identity);
+    const auto& path = entry->getWSPath();
+
+    // Check color support (thread-safe with mutex)
+    {
+        lock_guard<mutex> lock(mtx);
+        if (!color_checked) {
+            color_checked = true;
+            const char* no_color = std::getenv("NO_COLOR");
+            if (no_color != nullptr && no_color[0] != '\0')
+                color_output = false;
+            if (!isatty(STDOUT_FILENO))
+                color_output = false;
+        }
+    }
+
+#pragma GCC diagnostic push                            // save the actual diag context
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" // disable maybe warnings
+    fmt::color remaincolor;
+
+    if (color_output) {
+        if (remaining / (24 * 3600) < 3)
+            remaincolor = fmt::color::red;
+        else if (remaining / (24 * 3600) < 7)
+            remaincolor = fmt::color::orange;
+        else
+            remaincolor = fmt::color::green;
+    }
+
+    bool must_print_header = false;
+    {
+        lock_guard<mutex> lock(mtx);
+        if (!headerprinted) {
+            headerprinted = true;
+            must_print_header = true;
+        }
+    }
+    if (must_print_header) {
+        if (terse) {
+            fmt::println("{:<30} {:<50} {:<9}", "ID", "PATH", "REMAINING");
+            fmt::println("{:=<30} {:=<50} {:=<9}", "", "", "");
+        } else {
+            fmt::println("{:<30} {:<50} {:<25} {:10} {:<9}", "ID", "PATH", "EXPIRATION", "EXTENSIONS", "REMAINING");
+            fmt::println("{:=<30} {:=<50} {:=<25} {:=<10} {:=<9}", "", "", "", "", "");
+        }
+    }
+
+    if (terse) {
+        if (color_output)
+            fmt::println("{:<30}{} {:<50}{} {:<9}", ID, wrapColumn(ID.length(), 30, 31), path,
+                         wrapColumn(path.length(), 50, 82), fmt::styled(remaining / (24 * 3600), fg(remaincolor)));
+        else
+            fmt::println("{:<30}{} {:<50}{} {:<9}", ID, wrapColumn(ID.length(), 30, 31), path,
+                         wrapColumn(path.length(), 50, 82), remaining / (24 * 3600));
+    } else {
+        char timebuf[80];
+        utils::ctime(entry->getExpiration(), timebuf, sizeof(timebuf));
+        if (color_output)
+            fmt::println("{:<30}{} {:<50}{} {:<25} {:<10} {:<9}", ID, wrapColumn(ID.length(), 30, 31), path,
+                         wrapColumn(path.length(), 50, 82), timebuf, entry->getExtension(),
+                         fmt::styled(remaining / (24 * 3600), fg(remaincolor)));
+        else
+            fmt::println("{:<30}{} {:<50}{} {:<25} {:<10} {:<9}", ID, wrapColumn(ID.length(), 30, 31), path,
+                         wrapColumn(path.length(), 50, 82), timebuf, entry->getExtension(), remaining / (24 * 3600));
+    }
+#pragma GCC diagnostic pop
+}
@@ -0,0 +1,53 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+/*
+ *  hpc-workspace-v2
+ *
+ *  listing.h
+ *
+ *  - printing of DB entries for ws_list, does not allocate per entry
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string_view>
+
+#include "config.h"
+#include "db.h"
+#include "user.h"
+
+// ID for display, full ID for admins, ID without username for others
+std::string_view getMaskedID(const DBEntry* entry, const user::Identity& identity);
+
+// print only masked ID
+void print_entry_short(const DBEntry* entry, const user::Identity& identity);
+
+// print entry in traditional format, one below each other, multiline
+void print_entry(const DBEntry* entry, const Config& config, const user::Identity& identity, const bool verbose,
+                 const bool terse, const bool permissions, const bool listexpired);
+
+// print entry as line of a table, prints header before first entry
+void print_entry_tableformat(const DBEntry* entry, const Config& config, const user::Identity& identity,
+                             const bool verbose, const bool terse, const bool permissions, const bool listexpired);
+
+#endif
@@ -1,6 +1,11 @@
 #include "mail.h"
+#include "fmt/ranges.h" // IWYU pragma: keep
 #include "spdlog/spdlog.h"
 
+#include <functional>
+#include <iterator>
+#include <sstream>
+
 #include <unistd.h>
 
 extern bool debugflag;
@@ -27,39 +32,81 @@ void initCurl() { curl_global_init(CURL_GLOBAL_DEFAULT); }
 
 void cleanupCurl() { curl_global_cleanup(); }
 
-bool sendCurl(const std::string& smtpUrl, const std::string& mail_from, std::vector<std::string>& mail_to,
-              const std::string& completeMail) {
-    CURL* curl;
-    CURLcode res = CURLE_OK;
+Session::Session(const std::string& smtpUrl_) : smtpUrl(smtpUrl_) {}
 
-    curl = curl_easy_init();
-    if (!curl) {
-        if (debugflag)
-            spdlog::debug("Failed to initialize curl");
-        return false;
-    }
+// closes the connection with QUIT
+Session::~Session() {
+    if (curl)
+        curl_easy_cleanup(curl);
+}
 
+// one mail transaction, on the open connection of the handle if there is one and fresh is false,
+// sets uploaded if the server accepted DATA and got (part of) the mail
+CURLcode Session::perform(const std::string& mail_from, const std::vector<std::string>& mail_to,
+                          const std::string& completeMail, const bool fresh) {
     EmailData emailData(completeMail);
 
-    curl_easy_setopt(curl, CURLOPT_URL, smtpUrl.c_str());
-
     struct curl_slist* recipients = nullptr;
     for (const auto& mailaddress : mail_to) {
         recipients = curl_slist_append(recipients, mailaddress.c_str());
     }
     curl_easy_setopt(curl, CURLOPT_MAIL_RCPT, recipients);
     curl_easy_setopt(curl, CURLOPT_MAIL_FROM, mail_from.c_str());
-
-    curl_easy_setopt(curl, CURLOPT_READFUNCTION, readEmailCallback);
     curl_easy_setopt(curl, CURLOPT_READDATA, &emailData);
-    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, fresh ? 1L : 0L);
 
-    if (debugflag) {
-        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+    CURLcode res = curl_easy_perform(curl);
+    // curl reads the mail only after the 354 reply to DATA
+    uploaded = emailData.index > 0;
+
+    long count = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &count) == CURLE_OK)
+        connects += count;
+
+    // handle keeps pointers to them
+    curl_easy_setopt(curl, CURLOPT_MAIL_RCPT, nullptr);
+    curl_easy_setopt(curl, CURLOPT_READDATA, nullptr);
+    curl_slist_free_all(recipients);
+    return res;
+}
+
+bool Session::send(const std::string& mail_from, const std::vector<std::string>& mail_to,
+                   const std::string& completeMail) {
+    if (!curl) {
+        curl = curl_easy_init();
+        if (!curl) {
+            if (debugflag)
+                spdlog::debug("Failed to initialize curl");
+            result = CURLE_FAILED_INIT;
+            return false;
+        }
+        curl_easy_setopt(curl, CURLOPT_URL, smtpUrl.c_str());
+        curl_easy_setopt(curl, CURLOPT_READFUNCTION, readEmailCallback);
+        curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+        if (debugflag) {
+            curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+        }
     }
 
-    res = curl_easy_perform(curl);
+    uploaded = false;
+    CURLcode res = perform(mail_from, mail_to, completeMail, false);
+
+    // server closed the kept connection, e.g. after an idle timeout or a limit of mails per connection,
+    // a mail refused by the server (e.g. RCPT 550) is a send error with the reply code of the server.
+    // not retried once the mail was sent, the server might have accepted it
+    long code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    bool lost = res == CURLE_SEND_ERROR || res == CURLE_RECV_ERROR || res == CURLE_GOT_NOTHING;
+    if (lost && (code == 0 || code == 421) && !uploaded) {
+        if (debugflag)
+            spdlog::debug("connection lost ({}), reconnecting", curl_easy_strerror(res));
+        res = perform(mail_from, mail_to, completeMail, true);
+    } else if (lost && uploaded) {
+        spdlog::warn("connection lost after sending mail to {}, it might have been delivered",
+                     fmt::join(mail_to, ","));
+    }
 
+    result = res;
     if (debugflag) {
         if (res == CURLE_OK) {
             spdlog::debug("Email sent successfully");
@@ -68,12 +115,17 @@ bool sendCurl(const std::string& smtpUrl, const std::string& mail_from, std::vec
         }
     }
 
-    curl_slist_free_all(recipients);
-    curl_easy_cleanup(curl);
-
+    if (res == CURLE_OK)
+        sent++;
     return (res == CURLE_OK);
 }
 
+bool sendCurl(const std::string& smtpUrl, const std::string& mail_from, const std::vector<std::string>& mail_to,
+              const std::string& completeMail) {
+    Session session(smtpUrl);
+    return session.send(mail_from, mail_to, completeMail);
+}
+
 std::string generateMailDateFormat(const time_t time) {
     char timeString[std::size("Mon, 29 Nov 2010 21:54:29 +1100")];
     struct tm tm_buf;
@@ -94,7 +146,7 @@ std::string generateMessageID(const std::string& domain) {
     return fmt::format("{}.{}.{}@{}", now, pid, hash, domain);
 }
 
-std::string generateToHeader(std::vector<std::string> mail_to) {
+std::string generateToHeader(const std::vector<std::string>& mail_to) {
     std::string to_header;
     for (size_t i = 0; i < mail_to.size(); ++i) {
         if (i > 0)
@@ -104,4 +156,91 @@ std::string generateToHeader(std::vector<std::string> mail_to) {
     return to_header;
 }
 
+// Generate the Date Format used for ics attachments from time_t
+std::string generateICSDateFormat(const time_t time) {
+    char timeString[std::size("yyyymmddThhmmssZ")];
+    struct tm tm_buf;
+    localtime_r(&time, &tm_buf);
+    std::strftime(std::data(timeString), std::size(timeString), "%Y%m%dT%H%M00Z", &tm_buf);
+    std::string s(timeString);
+    return s;
+}
+
+// Encode ics input for Base64
+std::string base64Encode(const std::string& input) {
+    const std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    unsigned int val = 0;
+    int valb = -6;
+    for (unsigned char c : input) {
+        val = (val << 8) + c;
+        valb += 8;
+        while (valb >= 0) {
+            result.push_back(chars[(val >> valb) & 0x3F]);
+            valb -= 6;
+        }
+    }
+    if (valb > -6)
+        result.push_back(chars[((val << 8) >> (valb + 8)) & 0x3F]);
+    while (result.size() % 4)
+        result.push_back('=');
+    return result;
+}
+
+// Generate the ICS File
+std::string generateICS(const std::vector<CalendarEvent>& events, const std::string& clustername,
+                        const time_t createtime) {
+    const std::string CRLF = "\r\n";
+    std::string createtimestr = generateICSDateFormat(createtime);
+
+    std::stringstream ics;
+
+    // HEADER
+    ics << "BEGIN:VCALENDAR" << CRLF;
+    ics << "VERSION:2.0" << CRLF;
+    ics << "PRODID:-//HLRS Cluster Team//Workspace V2.1//EN" << CRLF; // ???
+    ics << "METHOD:REQUEST" << CRLF;
+    ics << "BEGIN:VTIMEZONE" << CRLF;
+    ics << "TZID:Europe/Berlin" << CRLF;
+    ics << "BEGIN:DAYLIGHT" << CRLF;
+    ics << "TZOFFSETFROM:+0100" << CRLF;
+    ics << "TZOFFSETTO:+0200" << CRLF;
+    ics << "TZNAME:CEST" << CRLF;
+    ics << "DTSTART:19700329T020000" << CRLF;
+    ics << "RRULE:FREQ=YEARLY;BYDAY=-1SU;BYMONTH=3" << CRLF;
+    ics << "END:DAYLIGHT" << CRLF;
+    ics << "BEGIN:STANDARD" << CRLF;
+    ics << "TZOFFSETFROM:+0200" << CRLF;
+    ics << "TZOFFSETTO:+0100" << CRLF;
+    ics << "TZNAME:CET" << CRLF;
+    ics << "DTSTART:19701025T030000" << CRLF;
+    ics << "RRULE:FREQ=YEARLY;BYDAY=-1SU;BYMONTH=10" << CRLF;
+    ics << "END:STANDARD" << CRLF;
+    ics << "END:VTIMEZONE" << CRLF;
+
+    // EVENTS
+    for (const auto& event : events) {
+        std::string starttimestr = generateICSDateFormat(event.expiration - 7200);
+        std::string expirationtimestr = generateICSDateFormat(event.expiration);
+        std::size_t entryhash = std::hash<std::string>{}(event.wsname);
+
+        ics << "BEGIN:VEVENT\r\n";
+        ics << "CREATED:" << createtimestr << CRLF;
+        ics << "DTSTAMP:" << createtimestr << CRLF;
+        ics << "UID:587a1aa6-" << entryhash << CRLF;
+        ics << "DESCRIPTION:Workspace " << event.wsname << " will be deleted on host " << clustername << CRLF;
+        ics << "LOCATION:" << clustername << ":" << event.filesystem << CRLF;
+        ics << "SUMMARY:Workspace " << event.wsname << " expires" << CRLF;
+        ics << "DTSTART;TZID=Europe/Berlin:" << starttimestr << CRLF;
+        ics << "DTEND;TZID=Europe/Berlin:" << expirationtimestr << CRLF;
+        ics << "LAST_MODIFIED:" << createtimestr << CRLF;
+        ics << "CLASS:PRIVATE" << CRLF;
+        ics << "END:VEVENT" << CRLF;
+    }
+
+    ics << "END:VCALENDAR" << CRLF;
+
+    return ics.str();
+}
+
 } // namespace mail
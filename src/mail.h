@@ -24,8 +24,43 @@ void initCurl();
 // Cleanup Curl
 void cleanupCurl();
 
-// Send a Mail with curl to the smtpUrl
-bool sendCurl(const std::string& smtpUrl, const std::string& mail_from, std::vector<std::string>& mail_to,
+// SMTP session with curl, keeps the connection to the server open between mails,
+// and reconnects if the server closed it. one session per thread, it is not thread safe
+class Session {
+  private:
+    std::string smtpUrl;
+    CURL* curl = nullptr;
+    long sent = 0;     // mails accepted by the server
+    long connects = 0; // connections opened
+    CURLcode result = CURLE_OK;
+    bool uploaded = false; // last mail was sent to the server, even if the reply was lost
+
+    CURLcode perform(const std::string& mail_from, const std::vector<std::string>& mail_to,
+                     const std::string& completeMail, const bool fresh);
+
+  public:
+    explicit Session(const std::string& smtpUrl_);
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    // send one mail, true if the server accepted it.
+    // a connection lost before the mail data was sent is retried once on a new connection. one lost after it
+    // is not, the server may have accepted the mail already, and sending it again (e.g. from the mail spool)
+    // can deliver it twice
+    bool send(const std::string& mail_from, const std::vector<std::string>& mail_to, const std::string& completeMail);
+
+    long getSent() const { return sent; }
+    long getConnects() const { return connects; }
+    // result of the last mail
+    CURLcode lastResult() const { return result; }
+    // last mail was sent to the server, it might have been delivered even if send failed
+    bool lastUploaded() const { return uploaded; }
+};
+
+// Send a Mail with curl to the smtpUrl, with a session of its own
+bool sendCurl(const std::string& smtpUrl, const std::string& mail_from, const std::vector<std::string>& mail_to,
               const std::string& completeMail);
 
 // Generate the Date Format used for Mime Mails from time_t
@@ -36,7 +71,24 @@ std::string generateMailDateFormat(const time_t time);
 std::string generateMessageID(const std::string& domain);
 
 // Generate the To Header for Mails
-std::string generateToHeader(std::vector<std::string> mail_to);
+std::string generateToHeader(const std::vector<std::string>& mail_to);
+
+// expiration of a workspace, an event of a calendar file
+struct CalendarEvent {
+    std::string wsname;
+    std::string filesystem;
+    time_t expiration;
+};
+
+// Generate the Date Format used for ics attachments from time_t
+std::string generateICSDateFormat(const time_t time);
+
+// Encode ics input for Base64
+std::string base64Encode(const std::string& input);
+
+// Generate an ICS File with one event per workspace
+std::string generateICS(const std::vector<CalendarEvent>& events, const std::string& clustername,
+                        const time_t createtime);
 
 } // namespace mail
 
@@ -0,0 +1,296 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  mailspool.cpp
+ *
+ *  - spool directory for outgoing mails, filled by ws_expirer and drained later
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "fmt/format.h"
+#include "fmt/ranges.h" // IWYU pragma: keep
+#include "spdlog/spdlog.h"
+
+#include "mail.h"
+#include "mailspool.h"
+
+extern bool debugflag;
+
+namespace cppfs = std::filesystem;
+
+namespace mail {
+
+// first line of a spool file, followed by header lines, an empty line and the mail
+static const std::string spoolmagic = "ws_mailspool 1";
+
+// server can not be reached at all, no point in trying the other mails now
+static bool unreachable(const CURLcode res) {
+    return res == CURLE_COULDNT_RESOLVE_HOST || res == CURLE_COULDNT_CONNECT || res == CURLE_OPERATION_TIMEDOUT;
+}
+
+// write data to a new file and flush it to disk
+static bool writeFile(const std::string& path, const std::string& data) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+    size_t done = 0;
+    while (done < data.size()) {
+        auto len = ::write(fd, data.data() + done, data.size() - done);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            unlink(path.c_str());
+            return false;
+        }
+        done += len;
+    }
+    bool ok = fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    if (!ok)
+        unlink(path.c_str());
+    return ok;
+}
+
+// make a rename in dir durable
+static void syncDir(const std::string& dir) {
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+time_t Spool::backoff(const int attempts) {
+    // 5 minutes, doubled for each failed attempt, at most 6 hours
+    time_t wait = 300;
+    for (int i = 1; i < attempts && wait < 6 * 3600; i++)
+        wait *= 2;
+    return std::min<time_t>(wait, 6 * 3600);
+}
+
+// write mail as new/name, replacing an older version atomically
+bool Spool::write(const std::string& name, const SpooledMail& mail) const {
+    std::string data = fmt::format("{}\nqueued {}\nattempts {}\nnext {}\nfrom {}\n", spoolmagic, mail.queued,
+                                   mail.attempts, mail.next, mail.mail_from);
+    for (const auto& to : mail.mail_to)
+        data += fmt::format("to {}\n", to);
+    data += "\n";
+    data += mail.completeMail;
+
+    std::error_code ec;
+    cppfs::create_directories(cppfs::path(dir) / "tmp", ec);
+    cppfs::create_directories(cppfs::path(dir) / "new", ec);
+
+    auto tmp = (cppfs::path(dir) / "tmp" / name).string();
+    unlink(tmp.c_str()); // leftover of a crashed writer
+    if (!writeFile(tmp, data)) {
+        spdlog::error("could not write mail to spool file {}: {}", tmp, strerror(errno));
+        return false;
+    }
+    auto target = (cppfs::path(dir) / "new" / name).string();
+    if (rename(tmp.c_str(), target.c_str()) != 0) {
+        spdlog::error("could not move spool file {} to {}: {}", tmp, target, strerror(errno));
+        unlink(tmp.c_str());
+        return false;
+    }
+    syncDir((cppfs::path(dir) / "new").string());
+    return true;
+}
+
+bool Spool::enqueue(const std::string& mail_from, const std::vector<std::string>& mail_to,
+                    const std::string& completeMail) const {
+    static std::atomic<unsigned long> sequence{0};
+
+    // addresses are header lines of the spool file
+    auto badaddress = [](const std::string& address) { return address.find('\n') != std::string::npos; };
+    if (badaddress(mail_from) || std::any_of(mail_to.begin(), mail_to.end(), badaddress)) {
+        spdlog::error("not spooling mail with newline in address");
+        return false;
+    }
+
+    SpooledMail mail{mail_from, mail_to, completeMail, 0, time(nullptr), 0};
+    // sorts in order of queueing within a process
+    auto name = fmt::format("{}.{:08}.{:08}", mail.queued, getpid(), sequence++);
+    if (!write(name, mail))
+        return false;
+    if (debugflag)
+        spdlog::debug("spooled mail {} to {}", name, fmt::join(mail_to, ","));
+    return true;
+}
+
+std::vector<std::string> Spool::queued() const {
+    std::vector<std::string> names;
+    std::error_code ec;
+    for (const auto& entry : cppfs::directory_iterator(cppfs::path(dir) / "new", ec)) {
+        if (entry.is_regular_file(ec))
+            names.push_back(entry.path().filename().string());
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+bool Spool::read(const std::string& path, SpooledMail& mail) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    std::string line;
+    if (!std::getline(in, line) || line != spoolmagic)
+        return false;
+    mail = SpooledMail();
+    while (std::getline(in, line) && !line.empty()) {
+        auto space = line.find(' ');
+        if (space == std::string::npos)
+            return false;
+        auto key = line.substr(0, space);
+        auto value = line.substr(space + 1);
+        try {
+            if (key == "queued")
+                mail.queued = std::stol(value);
+            else if (key == "attempts")
+                mail.attempts = std::stoi(value);
+            else if (key == "next")
+                mail.next = std::stol(value);
+            else if (key == "from")
+                mail.mail_from = value;
+            else if (key == "to")
+                mail.mail_to.push_back(value);
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    std::ostringstream rest;
+    rest << in.rdbuf();
+    mail.completeMail = rest.str();
+    return !mail.mail_to.empty();
+}
+
+Spool::Stats Spool::drain(const std::string& smtpUrl, const int rate, const time_t deadline) const {
+    Stats stats;
+    auto names = queued();
+    if (names.empty())
+        return stats;
+
+    // one sender at a time, others leave the mails to it
+    auto lockpath = (cppfs::path(dir) / "lock").string();
+    int lockfd = open(lockpath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockfd < 0 || flock(lockfd, LOCK_EX | LOCK_NB) != 0) {
+        spdlog::warn("mail spool {} is locked by another sender, leaving mails to it", dir);
+        if (lockfd >= 0)
+            close(lockfd);
+        stats.pending = names.size();
+        return stats;
+    }
+
+    Session session(smtpUrl);
+    const auto interval = std::chrono::microseconds(rate > 0 ? 60000000 / rate : 0);
+    auto nextsend = std::chrono::steady_clock::now();
+    bool stop = false;
+
+    for (const auto& name : names) {
+        time_t now = time(nullptr);
+        if (stop || (deadline != 0 && now >= deadline)) {
+            stats.pending++;
+            continue;
+        }
+        auto path = (cppfs::path(dir) / "new" / name).string();
+        SpooledMail mail;
+        if (!read(path, mail)) {
+            if (!cppfs::exists(path))
+                continue; // sent by an earlier sender meanwhile
+            spdlog::error("invalid spool file {}, moving it to failed", path);
+            cppfs::create_directories(cppfs::path(dir) / "failed");
+            rename(path.c_str(), (cppfs::path(dir) / "failed" / name).c_str());
+            stats.failed++;
+            continue;
+        }
+        if (mail.next > now) {
+            stats.deferred++;
+            continue;
+        }
+
+        if (rate > 0) {
+            std::this_thread::sleep_until(nextsend);
+            nextsend = std::chrono::steady_clock::now() + interval;
+        }
+
+        if (session.send(mail.mail_from, mail.mail_to, mail.completeMail)) {
+            unlink(path.c_str());
+            stats.sent++;
+            continue;
+        }
+
+        if (unreachable(session.lastResult())) {
+            // outage does not count as attempt of this mail
+            spdlog::warn("mail server {} not reachable ({}), keeping mails in spool", smtpUrl,
+                         curl_easy_strerror(session.lastResult()));
+            stats.pending++;
+            stop = true;
+            continue;
+        }
+
+        if (session.lastUploaded()) {
+            // sending it again could deliver it twice
+            spdlog::warn("connection lost after sending mail to {} ({}), it might have been delivered, "
+                         "not sending it again, moving it to failed",
+                         fmt::join(mail.mail_to, ","), curl_easy_strerror(session.lastResult()));
+            cppfs::create_directories(cppfs::path(dir) / "failed");
+            rename(path.c_str(), (cppfs::path(dir) / "failed" / name).c_str());
+            stats.failed++;
+            continue;
+        }
+
+        mail.attempts++;
+        if (mail.attempts >= maxattempts) {
+            spdlog::error("giving up mail to {} after {} attempts ({}), moving it to failed",
+                          fmt::join(mail.mail_to, ","), mail.attempts, curl_easy_strerror(session.lastResult()));
+            cppfs::create_directories(cppfs::path(dir) / "failed");
+            rename(path.c_str(), (cppfs::path(dir) / "failed" / name).c_str());
+            stats.failed++;
+        } else {
+            mail.next = time(nullptr) + backoff(mail.attempts);
+            spdlog::warn("failed to send mail to {} ({}), attempt {}, retrying in {}s", fmt::join(mail.mail_to, ","),
+                         curl_easy_strerror(session.lastResult()), mail.attempts, backoff(mail.attempts));
+            write(name, mail);
+            stats.deferred++;
+        }
+    }
+
+    close(lockfd);
+    return stats;
+}
+
+} // namespace mail
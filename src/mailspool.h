@@ -0,0 +1,91 @@
+#ifndef MAILSPOOL_H
+#define MAILSPOOL_H
+
+/*
+ *  hpc-workspace-v2
+ *
+ *  mailspool.h
+ *
+ *  - spool directory for outgoing mails, filled by ws_expirer and drained later
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace mail {
+
+// spooled mail, with its delivery state
+struct SpooledMail {
+    std::string mail_from;
+    std::vector<std::string> mail_to;
+    std::string completeMail;
+    int attempts = 0; // failed attempts so far
+    time_t queued = 0;
+    time_t next = 0; // no attempt before
+};
+
+// durable queue of outgoing mails in a directory, one file per mail.
+// mails are written to tmp/ and renamed to new/, so a mail is either queued completely or not at all,
+// and removed from new/ when the server accepted it. mails given up are moved to failed/.
+// any number of threads and processes can enqueue, drain takes a lock so only one sends at a time.
+class Spool {
+  public:
+    // outcome of a drain
+    struct Stats {
+        long sent = 0;     // accepted by the server
+        long deferred = 0; // retried later
+        long failed = 0;   // given up, moved to failed/
+        long pending = 0;  // not tried, deadline passed, server unreachable or spool locked
+    };
+
+    static const int maxattempts = 12; // about 2.5 days with backoff()
+
+  private:
+    std::string dir;
+
+    bool write(const std::string& name, const SpooledMail& mail) const;
+
+  public:
+    explicit Spool(const std::string& dir_) : dir(dir_) {}
+
+    // queue mail, false if it could not be stored
+    bool enqueue(const std::string& mail_from, const std::vector<std::string>& mail_to,
+                 const std::string& completeMail) const;
+
+    // send due mails over one connection, at most rate mails per minute (0 unlimited),
+    // stops at deadline (0 none) or if the server is unreachable
+    Stats drain(const std::string& smtpUrl, const int rate, const time_t deadline) const;
+
+    // names of queued mails, oldest first
+    std::vector<std::string> queued() const;
+    static bool read(const std::string& path, SpooledMail& mail);
+
+    // seconds to wait before the next attempt after attempts failed attempts
+    static time_t backoff(const int attempts);
+};
+
+} // namespace mail
+
+#endif
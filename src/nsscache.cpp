@@ -0,0 +1,185 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  nsscache.cpp
+ *
+ *  - process wide cache of group memberships of users, for scans over many workspace owners
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <grp.h>
+#include <pwd.h>
+
+#include "spdlog/spdlog.h"
+
+#include "nsscache.h"
+#include "user.h"
+
+extern bool traceflag;
+extern bool debugflag;
+
+namespace user {
+
+NSSCache& NSSCache::instance() {
+    static NSSCache cache;
+    return cache;
+}
+
+void NSSCache::configure(const long ttl_, const size_t threshold_, const std::string& nsswitch) {
+    std::ifstream in(nsswitch);
+    std::stringstream content;
+    content << in.rdbuf();
+    bool enumerationcomplete = in && enumerable(content.str());
+    if (debugflag && threshold_ > 0 && !enumerationcomplete)
+        spdlog::debug("NSS sources in {} can not be enumerated completely, looking up users one by one", nsswitch);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ttl = ttl_;
+    threshold = threshold_;
+    complete = enumerationcomplete;
+}
+
+bool NSSCache::enumerable(const std::string& nsswitchconf) {
+    std::istringstream in(nsswitchconf);
+    std::string line;
+    int databases = 0;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string database, source;
+        words >> database;
+        if (database != "passwd:" && database != "group:")
+            continue;
+        databases++;
+        while (words >> source) {
+            // actions like [NOTFOUND=return] and sources, which return all entries with getpwent/getgrent
+            if (source[0] != '[' && source != "files" && source != "systemd")
+                return false;
+        }
+    }
+    return databases == 2;
+}
+
+void NSSCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    users.clear();
+    members.clear();
+    enumerated = 0;
+    misses = 0;
+}
+
+// read all users and groups once, user -> primary gid + all groups listing the user as member,
+// only one thread at a time, getpwent and getgrent keep their position in global state
+std::unordered_map<std::string, std::vector<gid_t>> NSSCache::enumerate() {
+    if (traceflag)
+        spdlog::trace("NSSCache::enumerate()");
+
+    std::unordered_map<std::string, std::vector<gid_t>> members;
+
+    setpwent();
+    while (struct passwd* pw = getpwent()) {
+        members[pw->pw_name].push_back(pw->pw_gid);
+    }
+    endpwent();
+
+    setgrent();
+    while (struct group* gr = getgrent()) {
+        for (char** mem = gr->gr_mem; mem != nullptr && *mem != nullptr; mem++) {
+            // members without passwd entry have no primary gid, they are looked up one by one
+            auto it = members.find(*mem);
+            if (it != members.end())
+                it->second.push_back(gr->gr_gid);
+        }
+    }
+    endgrent();
+
+    for (auto& [name, gids] : members) {
+        std::sort(gids.begin(), gids.end());
+        gids.erase(std::unique(gids.begin(), gids.end()), gids.end());
+    }
+
+    if (debugflag)
+        spdlog::debug("enumerated {} users from NSS", members.size());
+    return members;
+}
+
+std::vector<gid_t> NSSCache::getUserGids(const std::string& username) {
+    time_t now = time(nullptr);
+    bool enumerate_now = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // drop outdated enumeration, start counting again
+        if (enumerated != 0 && now - enumerated >= ttl) {
+            members.clear();
+            enumerated = 0;
+            misses = 0;
+        }
+
+        if (enumerated != 0) {
+            auto it = members.find(username);
+            if (it != members.end())
+                return it->second;
+        }
+
+        auto it = users.find(username);
+        if (it != users.end() && it->second.expires > now)
+            return it->second.gids;
+
+        // many different users, cheaper to read everything at once, others look up one by one meanwhile
+        if (enumerated == 0 && !enumerating && complete && threshold > 0 && ttl > 0 && misses >= threshold) {
+            enumerating = true;
+            enumerate_now = true;
+        } else {
+            misses++;
+            lookups++;
+        }
+    }
+
+    if (enumerate_now) {
+        auto all = enumerate();
+        std::lock_guard<std::mutex> lock(mutex);
+        members = std::move(all);
+        enumerated = now;
+        enumerating = false;
+        enumerations++;
+        auto it = members.find(username);
+        if (it != members.end())
+            return it->second;
+        misses++;
+        lookups++;
+    }
+
+    auto gids = user::getUserGids(username);
+    if (ttl > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        users[username] = Entry{gids, now + ttl};
+    }
+    return gids;
+}
+
+} // namespace user
@@ -0,0 +1,100 @@
+#ifndef NSSCACHE_H
+#define NSSCACHE_H
+
+/*
+ *  hpc-workspace-v2
+ *
+ *  nsscache.h
+ *
+ *  - process wide cache of group memberships of users, for scans over many workspace owners
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace user {
+
+// cache for user::getUserGids
+// users are looked up one by one with getpwnam/getgrouplist, once more than threshold
+// distinct users were looked up, passwd and group databases are enumerated once with
+// getpwent/getgrent and all later lookups are served from memory.
+// enumeration is only used if nsswitch.conf has no sources besides files and systemd for passwd and group,
+// others (e.g. sssd, ldap) may not enumerate all users, or not all groups of a user.
+// users missing in the enumeration are still looked up one by one.
+// everything is dropped after ttl seconds. NSS is called without holding the lock, so threads do not
+// wait for the lookups of others.
+class NSSCache {
+  private:
+    struct Entry {
+        std::vector<gid_t> gids;
+        time_t expires;
+    };
+
+    std::mutex mutex;
+    long ttl = 600;         // seconds until cached data is dropped, 0 disables caching
+    size_t threshold = 200; // distinct single lookups before enumeration, 0 never enumerates
+
+    std::unordered_map<std::string, Entry> users;                 // single lookups
+    std::unordered_map<std::string, std::vector<gid_t>> members; // from enumeration, sorted gids
+    time_t enumerated = 0;                                        // time of enumeration, 0 if none
+    bool enumerating = false;                                     // a thread is enumerating
+    bool complete = false;                                        // enumeration returns all users and groups
+    size_t misses = 0;                                            // single lookups since enumeration
+
+    // statistics
+    long lookups = 0;
+    long enumerations = 0;
+
+    // read all users with their gids, called without lock
+    static std::unordered_map<std::string, std::vector<gid_t>> enumerate();
+
+  public:
+    // the one cache of this process
+    static NSSCache& instance();
+
+    // nsswitch is read to find out if enumeration is complete
+    void configure(const long ttl_, const size_t threshold_, const std::string& nsswitch = "/etc/nsswitch.conf");
+
+    // true if passwd and group sources in the nsswitch.conf content can be enumerated completely
+    static bool enumerable(const std::string& nsswitchconf);
+
+    // same as user::getUserGids, sorted gids of user, empty if user is unknown
+    std::vector<gid_t> getUserGids(const std::string& username);
+
+    // drop everything
+    void clear();
+
+    // number of single user lookups and enumerations done
+    long getLookups() const { return lookups; }
+    long getEnumerations() const { return enumerations; }
+};
+
+} // namespace user
+
+#endif
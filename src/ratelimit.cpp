@@ -0,0 +1,157 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  ratelimit.cpp
+ *
+ *  - per filesystem limit of metadata operations, protects metadata servers from parallel tools
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include "config.h"
+#include "ratelimit.h"
+
+extern bool debugflag;
+
+MetadataLimiter& MetadataLimiter::forFilesystem(const std::string& fs) {
+    static std::mutex registrymutex;
+    static std::map<std::string, std::unique_ptr<MetadataLimiter>> registry;
+
+    std::lock_guard<std::mutex> lock(registrymutex);
+    auto& limiter = registry[fs];
+    if (!limiter)
+        limiter = std::make_unique<MetadataLimiter>();
+    return *limiter;
+}
+
+void MetadataLimiter::configure(const Config& config) {
+    for (const auto& fs : config.Filesystems()) {
+        const auto& fsconfig = config.getFsConfig(fs);
+        forFilesystem(fs).setLimits(fsconfig.metadatarate, fsconfig.metadataconcurrency);
+    }
+}
+
+void MetadataLimiter::setLimits(const unsigned rate_, const unsigned concurrency_) {
+    {
+        std::lock_guard<std::mutex> lock(bucketmutex);
+        rate = rate_;
+        tokens = 0;
+        refilled = clock::time_point{};
+    }
+    {
+        std::lock_guard<std::mutex> lock(slotmutex);
+        concurrency = concurrency_;
+    }
+    slotfree.notify_all();
+
+    if (debugflag && (rate_ > 0 || concurrency_ > 0))
+        spdlog::debug("metadata limit {} operations/s, {} concurrent", rate_, concurrency_);
+}
+
+void MetadataLimiter::acquire(const unsigned count) {
+    ops.fetch_add(count, std::memory_order_relaxed);
+
+    unsigned r = rate.load(std::memory_order_relaxed);
+    if (r == 0)
+        return;
+
+    // bucket holds 100ms of operations, short bursts but no second long spikes
+    double burst = std::max(1.0, r / 10.0);
+    clock::duration wait{0};
+    {
+        std::lock_guard<std::mutex> lock(bucketmutex);
+        auto now = clock::now();
+        double elapsed = std::chrono::duration<double>(now - refilled).count();
+        tokens = std::min(burst, tokens + elapsed * r);
+        refilled = now;
+        // granted right away, the caller pays by sleeping until the bucket would have had them
+        tokens -= count;
+        if (tokens < 0)
+            wait = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(-tokens / r));
+    }
+
+    if (wait.count() > 0) {
+        std::this_thread::sleep_for(wait);
+        throttled.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count(),
+                            std::memory_order_relaxed);
+    }
+}
+
+MetadataLimiter::Slot::Slot(MetadataLimiter& limiter_) : limiter(limiter_) {
+    if (limiter.concurrency.load(std::memory_order_relaxed) == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(limiter.slotmutex);
+    if (limiter.concurrency != 0 && limiter.active >= limiter.concurrency) {
+        auto begin = clock::now();
+        limiter.slotfree.wait(lock,
+                              [this] { return limiter.concurrency == 0 || limiter.active < limiter.concurrency; });
+        limiter.throttled.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count(),
+                                    std::memory_order_relaxed);
+    }
+    limiter.active++;
+    held = true;
+}
+
+MetadataLimiter::Slot::~Slot() {
+    if (!held)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(limiter.slotmutex);
+        limiter.active--;
+    }
+    limiter.slotfree.notify_one();
+}
+
+MetadataLimiter::Usage MetadataLimiter::usage() const {
+    Usage u;
+    u.ops = ops.load(std::memory_order_relaxed);
+    u.throttled = std::chrono::duration_cast<clock::duration>(
+        std::chrono::nanoseconds(throttled.load(std::memory_order_relaxed)));
+    u.when = clock::now();
+    return u;
+}
+
+void MetadataLimiter::logRate(const std::string& what, const Usage& since) const {
+    auto now = usage();
+    uint64_t count = now.ops - since.ops;
+    if (count == 0)
+        return;
+
+    double secs = std::chrono::duration<double>(now.when - since.when).count();
+    // throttled time is summed over threads, it can be larger than the elapsed time
+    double waited = std::chrono::duration<double>(now.throttled - since.throttled).count();
+    std::string limits;
+    if (rate > 0 || concurrency > 0)
+        limits = fmt::format(" (limit {} ops/s, {} concurrent, throttled {:.1f}s)", rate.load(), concurrency.load(),
+                             waited);
+    spdlog::info("    {}: {} metadata operations in {:.1f}s, {:.0f} ops/s{}", what, count, secs,
+                 secs > 0 ? count / secs : 0.0, limits);
+}
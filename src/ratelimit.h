@@ -0,0 +1,109 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+/*
+ *  hpc-workspace-v2
+ *
+ *  ratelimit.h
+ *
+ *  - per filesystem limit of metadata operations, protects metadata servers from parallel tools
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+class Config;
+
+// token bucket for metadata operations (unlink, stat, readdir, ...) on one filesystem, shared by all threads
+// working on that filesystem. a rate of 0 is unlimited and costs one atomic increment per operation.
+// concurrency limits the threads doing metadata operations at the same time, slots are never held while
+// waiting for other tasks, so nested parallel code can not deadlock.
+class MetadataLimiter {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    // counters for rate reports, see logRate()
+    struct Usage {
+        uint64_t ops = 0;
+        clock::duration throttled{0};
+        clock::time_point when;
+    };
+
+    // concurrency slot, held while doing a batch of metadata operations
+    class Slot {
+      private:
+        MetadataLimiter& limiter;
+        bool held = false;
+
+      public:
+        explicit Slot(MetadataLimiter& limiter_);
+        ~Slot();
+
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+    };
+
+  private:
+    std::atomic<unsigned> rate{0};        // operations per second, 0 unlimited
+    std::atomic<unsigned> concurrency{0}; // threads doing operations at the same time, 0 unlimited
+
+    std::mutex bucketmutex;
+    double tokens = 0; // negative if operations were granted in advance, callers sleep until paid
+    clock::time_point refilled;
+
+    std::mutex slotmutex;
+    std::condition_variable slotfree;
+    unsigned active = 0;
+
+    std::atomic<uint64_t> ops{0};
+    std::atomic<int64_t> throttled{0}; // nanoseconds waited for tokens and slots
+
+  public:
+    MetadataLimiter() = default;
+    MetadataLimiter(const MetadataLimiter&) = delete;
+    MetadataLimiter& operator=(const MetadataLimiter&) = delete;
+
+    // limiter of filesystem, unlimited until configured
+    static MetadataLimiter& forFilesystem(const std::string& fs);
+    // configure limiters of all filesystems from config
+    static void configure(const Config& config);
+
+    // set limits, 0 for unlimited
+    void setLimits(const unsigned rate, const unsigned concurrency);
+    unsigned getRate() const { return rate; }
+    unsigned getConcurrency() const { return concurrency; }
+
+    // account count operations, waits until the rate allows them
+    void acquire(const unsigned count = 1);
+
+    Usage usage() const;
+    // log achieved rate of what since earlier usage
+    void logRate(const std::string& what, const Usage& since) const;
+};
+
+#endif
@@ -0,0 +1,619 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  rmtree.cpp
+ *
+ *  - tamper safe removal of directory trees, in parallel on the executor
+ *  - checkpoints to continue a removal stopped by its deadline in a later run
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include "caps.h"
+#include "executor.h"
+#include "ratelimit.h"
+#include "utils.h"
+
+extern bool traceflag;
+extern bool debugflag;
+extern Cap caps;
+
+namespace {
+
+// directories not started before the deadline kept in a checkpoint, more are found by reading their parents
+const size_t maxfrontier = 10000;
+
+// limiter of rmtree calls without filesystem
+MetadataLimiter unlimited;
+
+// state shared by all tasks of one rmtree call
+struct Removal {
+    std::string top;      // path given to rmtree
+    std::time_t deadline; // 0 for none
+    bool parallel;
+    MetadataLimiter& limiter;
+    bool inodeorder;
+    bool countbytes;
+    Executor& executor;
+    std::atomic<bool> expired{false};
+
+    std::atomic<long> files{0};
+    std::atomic<long> dirs{0};
+    std::atomic<uint64_t> bytes{0}; // allocated space freed, of stated entries
+    std::atomic<long> errors{0};
+
+    std::mutex frontiermutex;
+    std::vector<std::string> frontier; // directories not started, relative to top
+
+    Removal(const std::string& top_, const std::time_t deadline_, const bool parallel_,
+            const utils::RmtreeOptions& options)
+        : top(top_), deadline(deadline_), parallel(parallel_),
+          limiter(options.limiter ? *options.limiter : unlimited), inodeorder(options.inodeorder),
+          countbytes(options.countbytes), executor(options.executor ? *options.executor : Executor::instance()) {}
+
+    void error() { errors.fetch_add(1, std::memory_order_relaxed); }
+
+    // remember directory path, which was not started due to the deadline
+    void postpone(const std::string& path) {
+        if (path.size() <= top.size() + 1)
+            return;
+        std::lock_guard<std::mutex> lock(frontiermutex);
+        if (frontier.size() < maxfrontier)
+            frontier.push_back(path.substr(top.size() + 1));
+    }
+
+    // deadline is checked before a directory is started, so it is soft and can be missed significantly
+    bool deadlinePassed() {
+        if (expired.load(std::memory_order_relaxed))
+            return true;
+        if (deadline != 0 && std::time(nullptr) >= deadline) {
+            if (!expired.exchange(true))
+                spdlog::info("rmtree deadline passed, exiting.");
+            return true;
+        }
+        return false;
+    }
+};
+
+bool removeDirectory(Removal& removal, const int parentfd, const std::string& name, const std::string& path);
+
+// entry as returned by getdents64, glibc before 2.30 has no wrapper
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// bytes read per getdents64 call, some hundred entries
+const size_t batchsize = 32 * 1024;
+// names of subdirectories queued as tasks before waiting for them, bounds memory for wide directories
+const size_t maxpendingnames = 256 * 1024;
+// a directory is read again if removing it fails because it is not empty, entries can be skipped when deleting
+// while reading, or be created meanwhile. emptied directories are not read again
+const int maxpasses = 3;
+
+// type, allocated blocks and links of entry, false if it is gone.
+// AT_STATX_DONT_SYNC takes the attributes the server has, Lustre does not ask the OSTs for sizes.
+bool statEntry(const int dirfd, const char* name, const std::string& path, struct statx& stx) {
+    if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_TYPE | STATX_BLOCKS | STATX_NLINK,
+              &stx)) {
+        if (errno != ENOENT)
+            spdlog::error("statx {}/{} -> {}", path, name, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// read one batch of entries of dirfd, unlink files and append names of subdirectories \0 separated to subdirs.
+// entries are handled in readdir order or, if configured, in inode order.
+// returns bytes read, 0 at end of directory, -1 on error. a concurrency slot of the limiter is held for the
+// batch, it is released before subdirectories are started, they need slots themselves.
+long removeBatch(Removal& removal, const int dirfd, const std::string& path, std::vector<char>& buffer,
+                 std::string& subdirs) {
+    MetadataLimiter::Slot slot(removal.limiter);
+
+    removal.limiter.acquire();
+    long bytes = syscall(SYS_getdents64, dirfd, buffer.data(), buffer.size());
+    if (bytes < 0) {
+        spdlog::error("getdents64 {} -> {}", path, strerror(errno));
+        removal.error();
+        return -1;
+    }
+
+    auto handle = [&](const linux_dirent64* ent) {
+        const char* name = &ent->d_name[0];
+
+        // ignore . and .. !!!!!!!
+        if (!strcmp(name, ".") || !strcmp(name, ".."))
+            return;
+
+        // directories are stated when they are opened. other entries only if the filesystem does not return
+        // types in getdents, or if the freed space of files is wanted, it costs a metadata operation per file
+        struct statx stx;
+        bool stated = false;
+        if (ent->d_type == DT_UNKNOWN || (ent->d_type != DT_DIR && removal.countbytes)) {
+            removal.limiter.acquire();
+            if (!statEntry(dirfd, name, path, stx))
+                return;
+            stated = true;
+        }
+        if (stated ? S_ISDIR(stx.stx_mode) : ent->d_type == DT_DIR) {
+            subdirs.append(name);
+            subdirs.push_back('\0');
+        } else {
+            removal.limiter.acquire();
+            if (unlinkat(dirfd, name, 0) == 0) {
+                removal.files.fetch_add(1, std::memory_order_relaxed);
+                // space of hard linked files is still used by the other links
+                if (stated && stx.stx_nlink <= 1)
+                    removal.bytes.fetch_add(stx.stx_blocks * 512, std::memory_order_relaxed);
+            } else {
+                spdlog::error("unlinkat {}/{} -> {}", path, name, strerror(errno));
+                removal.error();
+            }
+        }
+    };
+
+    if (removal.inodeorder) {
+        // inode order follows the on disk layout of inode tables on ext4 and XFS, fewer seeks and journal blocks
+        std::vector<const linux_dirent64*> entries;
+        for (long pos = 0; pos < bytes; pos += entries.back()->d_reclen)
+            entries.push_back(reinterpret_cast<const linux_dirent64*>(buffer.data() + pos));
+        std::sort(entries.begin(), entries.end(), [](const auto* a, const auto* b) { return a->d_ino < b->d_ino; });
+        for (const auto* ent : entries)
+            handle(ent);
+    } else {
+        for (long pos = 0; pos < bytes;) {
+            auto ent = reinterpret_cast<const linux_dirent64*>(buffer.data() + pos);
+            pos += ent->d_reclen;
+            handle(ent);
+        }
+    }
+
+    return bytes;
+}
+
+// delete contents of the verified directory dirfd in one pass from its current position, dirfd stays open
+// entries are read in fixed size batches, files are unlinked right away, subdirectories become tasks.
+// the directory is complete when all tasks returned, so directories are removed bottom up by the
+// task that waited for their children. memory per directory does not depend on its number of entries.
+// returns false if the directory was not started due to the deadline
+bool removeContents(Removal& removal, const int dirfd, const std::string& path) {
+    if (traceflag)
+        spdlog::trace("removeContents({}, {})", dirfd, path);
+
+    if (removal.deadlinePassed()) {
+        removal.postpone(path);
+        return false;
+    }
+
+    // on heap, directories are processed recursively and worker stacks are small
+    std::vector<char> buffer(batchsize);
+
+    size_t pendingnames = 0;
+    // dirfd stays open until all children are done, they are opened relative to it
+    Executor::TaskGroup group(removal.executor);
+
+    while (true) {
+        // subdirectories of this batch, shared by their tasks
+        auto subdirs = std::make_shared<std::string>();
+        if (removeBatch(removal, dirfd, path, buffer, *subdirs) <= 0)
+            break;
+
+        for (size_t offset = 0; offset < subdirs->size(); offset = subdirs->find('\0', offset) + 1) {
+            if (removal.parallel) {
+                group.run([&removal, dirfd, subdirs, offset, &path] {
+                    const char* sub = subdirs->c_str() + offset;
+                    removeDirectory(removal, dirfd, sub, path + "/" + sub);
+                });
+            } else {
+                const char* sub = subdirs->c_str() + offset;
+                removeDirectory(removal, dirfd, sub, path + "/" + sub);
+            }
+        }
+
+        pendingnames += subdirs->size();
+        if (pendingnames >= maxpendingnames) {
+            group.wait();
+            pendingnames = 0;
+        }
+    }
+
+    group.wait();
+    return true;
+}
+
+// open directory name in parentfd without following symlinks, -1 if it is no directory or was replaced
+// orig_stat is the stat of the directory
+int openVerified(Removal& removal, const int parentfd, const std::string& name, const std::string& path,
+                 struct stat& orig_stat) {
+    struct stat new_stat;
+
+    MetadataLimiter::Slot slot(removal.limiter);
+    removal.limiter.acquire(2);
+
+    if (fstatat(parentfd, name.c_str(), &orig_stat, AT_SYMLINK_NOFOLLOW)) {
+        // gone meanwhile is fine, e.g. directories of a checkpoint
+        if (errno != ENOENT) {
+            spdlog::error("fstatat {} -> {}", path, strerror(errno));
+            removal.error();
+        }
+        return -1;
+    }
+
+    if (!S_ISDIR(orig_stat.st_mode))
+        return -1;
+
+    int dirfd = openat(parentfd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dirfd < 0) {
+        spdlog::error("openat {} -> {}", path, strerror(errno));
+        removal.error();
+        return -1;
+    }
+
+    // protect against a directory being replaced by a symlink or something else between stat and open
+    if (fstatat(dirfd, "", &new_stat, AT_EMPTY_PATH) != 0 || memcmp(&new_stat, &orig_stat, sizeof(struct stat)) != 0) {
+        spdlog::error("rmtree hit a symbolic link!");
+        removal.error();
+        close(dirfd);
+        return -1;
+    }
+
+    return dirfd;
+}
+
+// delete directory name in parentfd with contents, if it is still the directory we looked at.
+// returns true if it was removed
+bool removeDirectory(Removal& removal, const int parentfd, const std::string& name, const std::string& path) {
+    struct stat dir_stat;
+    int dirfd = openVerified(removal, parentfd, name, path, dir_stat);
+    if (dirfd < 0)
+        return false;
+
+    bool removed = false;
+    for (int pass = 0; pass < maxpasses; pass++) {
+        if (pass > 0 && lseek(dirfd, 0, SEEK_SET) < 0) {
+            spdlog::error("lseek {} -> {}", path, strerror(errno));
+            removal.error();
+            break;
+        }
+        if (!removeContents(removal, dirfd, path))
+            break;
+
+        // directories emptied before the deadline passed are removed, so the next run does not read them again,
+        // parents of unfinished directories are not empty
+        MetadataLimiter::Slot slot(removal.limiter);
+        removal.limiter.acquire();
+        if (unlinkat(parentfd, name.c_str(), AT_REMOVEDIR) == 0) {
+            removed = true;
+            break;
+        }
+        // entries were skipped or created meanwhile, read again
+        if (errno == ENOTEMPTY && !removal.expired && pass + 1 < maxpasses)
+            continue;
+        if (!removal.expired || errno != ENOTEMPTY) {
+            spdlog::error("unlinkat {} -> {}", path, strerror(errno));
+            removal.error();
+        }
+        break;
+    }
+    close(dirfd);
+
+    if (removed) {
+        removal.dirs.fetch_add(1, std::memory_order_relaxed);
+        removal.bytes.fetch_add(dir_stat.st_blocks * 512, std::memory_order_relaxed);
+    }
+    return removed;
+}
+
+// delete directory rel below verified topfd, each path component is opened without following symlinks
+void removeBelow(Removal& removal, const int topfd, const std::string& rel) {
+    std::vector<std::string> components;
+    std::string component;
+    std::istringstream stream(rel);
+    while (std::getline(stream, component, '/')) {
+        if (component.empty() || component == "." || component == "..") {
+            spdlog::error("invalid path {} in checkpoint of {}", rel, removal.top);
+            return;
+        }
+        components.push_back(component);
+    }
+    if (components.empty())
+        return;
+
+    // fds[i] is components[i - 1], dirstats[i] its stat
+    std::vector<int> fds{topfd};
+    std::vector<struct stat> dirstats(1);
+    std::string path = removal.top;
+    for (size_t i = 0; i + 1 < components.size(); i++) {
+        path += "/" + components[i];
+        struct stat st;
+        int fd = openVerified(removal, fds.back(), components[i], path, st);
+        if (fd < 0)
+            break;
+        fds.push_back(fd);
+        dirstats.push_back(st);
+    }
+
+    // parents might be gone meanwhile
+    if (fds.size() == components.size() &&
+        removeDirectory(removal, fds.back(), components.back(), path + "/" + components.back())) {
+        // parents left empty by it are removed bottom up, so the pass from the top does not read them again.
+        // others still have contents, or were removed by the task of another frontier directory
+        MetadataLimiter::Slot slot(removal.limiter);
+        for (size_t i = fds.size() - 1; i > 0; i--) {
+            removal.limiter.acquire();
+            if (unlinkat(fds[i - 1], components[i - 1].c_str(), AT_REMOVEDIR) != 0)
+                break;
+            removal.dirs.fetch_add(1, std::memory_order_relaxed);
+            removal.bytes.fetch_add(dirstats[i].st_blocks * 512, std::memory_order_relaxed);
+        }
+    }
+
+    for (size_t i = 1; i < fds.size(); i++)
+        close(fds[i]);
+}
+
+// checkpoint of a removal stopped by its deadline
+struct Checkpoint {
+    dev_t dev = 0;
+    ino_t ino = 0;
+    long files = 0;
+    long dirs = 0;
+    uint64_t bytes = 0;
+    long runs = 0;
+    std::vector<std::string> frontier;
+};
+
+const std::string checkpointmagic = "ws_rmtree_checkpoint 1";
+
+// header lines with counters, followed by \0 terminated frontier, names can contain newlines
+bool readCheckpoint(const std::string& filename, Checkpoint& checkpoint) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        return false;
+    std::string line;
+    if (!std::getline(in, line) || line != checkpointmagic)
+        return false;
+
+    unsigned long long dev = 0, ino = 0;
+    while (std::getline(in, line) && line != "frontier") {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "dev")
+            fields >> dev;
+        else if (key == "ino")
+            fields >> ino;
+        else if (key == "files")
+            fields >> checkpoint.files;
+        else if (key == "dirs")
+            fields >> checkpoint.dirs;
+        else if (key == "bytes")
+            fields >> checkpoint.bytes;
+        else if (key == "runs")
+            fields >> checkpoint.runs;
+    }
+    if (line != "frontier")
+        return false;
+    checkpoint.dev = dev;
+    checkpoint.ino = ino;
+
+    std::string rel;
+    while (std::getline(in, rel, '\0'))
+        checkpoint.frontier.push_back(rel);
+    return true;
+}
+
+// write via temporary file and rename, a crash leaves old or new checkpoint
+void writeCheckpoint(const std::string& filename, const Checkpoint& checkpoint) {
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << checkpointmagic << "\n";
+        out << "dev " << static_cast<unsigned long long>(checkpoint.dev) << "\n";
+        out << "ino " << static_cast<unsigned long long>(checkpoint.ino) << "\n";
+        out << "files " << checkpoint.files << "\n";
+        out << "dirs " << checkpoint.dirs << "\n";
+        out << "bytes " << checkpoint.bytes << "\n";
+        out << "runs " << checkpoint.runs << "\n";
+        out << "frontier\n";
+        for (const auto& rel : checkpoint.frontier)
+            out << rel << '\0';
+        if (!out.flush()) {
+            spdlog::error("could not write rmtree checkpoint {}", tmp);
+            unlink(tmp.c_str());
+            return;
+        }
+    }
+    if (rename(tmp.c_str(), filename.c_str())) {
+        spdlog::error("could not rename rmtree checkpoint {} -> {}", tmp, strerror(errno));
+        unlink(tmp.c_str());
+    }
+}
+
+} // namespace
+
+namespace utils {
+
+// hidden file next to path, /a/b -> /a/.b<suffix>
+static std::string hiddenSibling(const std::string& path, const std::string& suffix) {
+    std::string dir = path;
+    while (dir.size() > 1 && dir.back() == '/')
+        dir.pop_back();
+    auto pos = dir.rfind('/');
+    if (pos == std::string::npos)
+        return "." + dir + suffix;
+    return dir.substr(0, pos + 1) + "." + dir.substr(pos + 1) + suffix;
+}
+
+// name of checkpoint file for path, hidden file next to it
+std::string rmtreeCheckpoint(const std::string& path) { return hiddenSibling(path, ".rmtree"); }
+
+// name of marker requesting deletion of path, hidden file next to it
+std::string purgeMarker(const std::string& path) { return hiddenSibling(path, ".purge"); }
+
+// request deletion of path by ws_expirer, the marker contains the time of the request
+bool requestPurge(const std::string& path) {
+    auto marker = purgeMarker(path);
+    int fd = open(marker.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        // requested before, but do not accept anything else under that name
+        struct stat st;
+        if (errno == EEXIST && lstat(marker.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            return true;
+        spdlog::error("could not create {} -> {}", marker, strerror(errno));
+        return false;
+    }
+    bool ok = utils::writeAll(fd, fmt::format("{}\n", std::time(nullptr)));
+    if (close(fd) != 0 || !ok) {
+        spdlog::error("could not write {}", marker);
+        return false;
+    }
+    return true;
+}
+
+// delete path, continue from checkpoint file if one exists for path, write checkpoint if deadline passed
+RmtreeStats rmtree(const std::string& path, const std::time_t deadline, const std::string& checkpointfile,
+                   const RmtreeOptions& options) {
+    if (traceflag) {
+        spdlog::trace("rmtree({}, {}, {})", path, deadline, checkpointfile);
+    }
+
+    // capabilities are per thread, and the workers of the executor do not have the ones raised by a scope
+    // of the caller, setuid and root are process wide
+    Removal removal(path, deadline, !caps.hasCaps() || caps.scopeDepth() == 0, options);
+
+    RmtreeStats stats;
+    Checkpoint checkpoint;
+    auto start = std::chrono::steady_clock::now();
+
+    struct stat top_stat;
+    if (fstatat(AT_FDCWD, path.c_str(), &top_stat, AT_SYMLINK_NOFOLLOW)) {
+        if (errno == ENOENT) {
+            // nothing left, maybe deleted by someone else
+            if (checkpointfile != "")
+                unlink(checkpointfile.c_str());
+            stats.complete = true;
+            return stats;
+        }
+        spdlog::error("fstatat {} -> {}", path, strerror(errno));
+        stats.errors = 1;
+        return stats;
+    }
+
+    if (checkpointfile != "" && readCheckpoint(checkpointfile, checkpoint)) {
+        if (checkpoint.dev != top_stat.st_dev || checkpoint.ino != top_stat.st_ino) {
+            spdlog::warn("ignoring checkpoint {}, it belongs to another directory", checkpointfile);
+            checkpoint = Checkpoint();
+        } else if (debugflag) {
+            spdlog::debug("continuing removal of {}, {} directories in checkpoint", path, checkpoint.frontier.size());
+        }
+    }
+
+    // directories not started last time first, then everything left
+    if (checkpoint.frontier.size() > 0) {
+        struct stat st;
+        int topfd = openVerified(removal, AT_FDCWD, path, path, st);
+        if (topfd >= 0) {
+            if (removal.parallel) {
+                Executor::TaskGroup group(removal.executor);
+                for (const auto& rel : checkpoint.frontier)
+                    group.run([&removal, topfd, &rel] { removeBelow(removal, topfd, rel); });
+                group.wait();
+            } else {
+                for (const auto& rel : checkpoint.frontier)
+                    removeBelow(removal, topfd, rel);
+            }
+            close(topfd);
+        }
+    }
+
+    // only directories not removed with the frontier are left
+    bool gone = removeDirectory(removal, AT_FDCWD, path, path);
+    if (!gone) {
+        struct stat st;
+        gone = fstatat(AT_FDCWD, path.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0 && errno == ENOENT;
+    }
+
+    stats.files = checkpoint.files + removal.files;
+    stats.dirs = checkpoint.dirs + removal.dirs;
+    stats.bytes = checkpoint.bytes + removal.bytes;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.errors = removal.errors;
+    stats.runs = checkpoint.runs + 1;
+    stats.complete = gone;
+    stats.expired = removal.expired;
+    stats.pending = removal.frontier.size();
+
+    if (checkpointfile != "") {
+        if (stats.complete) {
+            if (unlink(checkpointfile.c_str()) && errno != ENOENT)
+                spdlog::error("could not remove rmtree checkpoint {} -> {}", checkpointfile, strerror(errno));
+        } else {
+            checkpoint.dev = top_stat.st_dev;
+            checkpoint.ino = top_stat.st_ino;
+            checkpoint.files = stats.files;
+            checkpoint.dirs = stats.dirs;
+            checkpoint.bytes = stats.bytes;
+            checkpoint.runs = stats.runs;
+            checkpoint.frontier = std::move(removal.frontier);
+            writeCheckpoint(checkpointfile, checkpoint);
+        }
+    }
+
+    return stats;
+}
+
+// delete path be deleting contents and deleting path itself
+RmtreeStats rmtree(std::string path, std::time_t deadline) { return rmtree(path, deadline, ""); }
+
+// delete path be deleting contents and deleting path itself
+// without deadline
+void rmtree(std::string path) { rmtree(path, (std::time_t)0L, ""); }
+
+} // namespace utils
@@ -0,0 +1,64 @@
+/*
+ *  hpc-workspace-v2
+ *
+ *  stray.cpp
+ *
+ *  - matching of directories found in spaces with DB entries, for stray detection of ws_expirer
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <filesystem>
+#include <string_view>
+#include <unordered_set>
+
+#include "stray.h"
+
+namespace cppfs = std::filesystem;
+
+std::vector<bool> matchDirectories(const std::vector<FoundDir>& dirs,
+                                   const std::vector<std::pair<std::string, std::string>>& entries) {
+    // views into entries, which outlive the sets
+    std::unordered_set<std::string_view> ids, paths;
+    ids.reserve(entries.size());
+    paths.reserve(entries.size());
+    for (const auto& [id, wspath] : entries) {
+        ids.insert(id);
+        if (!wspath.empty())
+            paths.insert(wspath);
+    }
+
+    std::vector<bool> found(dirs.size());
+    for (size_t i = 0; i < dirs.size(); i++) {
+        // same path the workspace path of a matching entry has
+        found[i] = ids.count(dirs[i].dir) > 0 || paths.count((cppfs::path(dirs[i].space) / dirs[i].dir).string()) > 0;
+    }
+    return found;
+}
+
+std::vector<bool> matchDirectories(const std::vector<FoundDir>& dirs, const std::vector<std::string>& ids) {
+    std::unordered_set<std::string_view> idset(ids.begin(), ids.end());
+    std::vector<bool> found(dirs.size());
+    for (size_t i = 0; i < dirs.size(); i++)
+        found[i] = idset.count(dirs[i].dir) > 0;
+    return found;
+}
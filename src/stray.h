@@ -0,0 +1,52 @@
+#ifndef STRAY_H
+#define STRAY_H
+
+/*
+ *  hpc-workspace-v2
+ *
+ *  stray.h
+ *
+ *  - matching of directories found in spaces with DB entries, for stray detection of ws_expirer
+ *
+ *  c++ version of workspace utility
+ *  a workspace is a temporary directory created in behalf of a user with a limited lifetime.
+ *
+ *  (c) Holger Berger 2021,2023,2024,2025,2026
+ *
+ *  hpc-workspace-v2 is based on workspace by Holger Berger, Thomas Beisel and Martin Hecht
+ *
+ *  hpc-workspace-v2 is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  hpc-workspace-v2 is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with workspace-ng  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// directory found in a space
+struct FoundDir {
+    std::string space;
+    std::string dir; // name in space
+};
+
+// for each directory, if it has a DB entry: its path (space/dir) is the workspace path of an entry,
+// or its name is the ID of an entry. entries are pairs of (id, wspath), wspath is empty for unreadable entries.
+// hash join, linear in directories and entries
+std::vector<bool> matchDirectories(const std::vector<FoundDir>& dirs,
+                                   const std::vector<std::pair<std::string, std::string>>& entries);
+
+// for each directory, if its name is one of the IDs, for deleted workspaces
+std::vector<bool> matchDirectories(const std::vector<FoundDir>& dirs, const std::vector<std::string>& ids);
+
+#endif
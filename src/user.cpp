@@ -28,6 +28,8 @@
  *
  */
 
+#include <algorithm>
+#include <cerrno>
 #include <grp.h>
 #include <pwd.h>
 #include <set>
@@ -49,17 +51,73 @@ extern int debuglevel;
 
 namespace user {
 
+// groups of current process
+static std::vector<gid_t> getProcessGids() {
+    // find first size and get list
+    int size = getgroups(0, nullptr);
+
+    if (size == -1) {
+        spdlog::error("error in getgroups()!");
+        return {};
+    }
+
+    std::vector<gid_t> gids(size);
+    int ret = getgroups(size, gids.data());
+    gids.resize(ret < 0 ? 0 : ret);
+    return gids;
+}
+
+// names of given groups, skips unknown groups
+static std::vector<std::string> getGroupnames(const std::vector<gid_t>& gids) {
+    std::vector<std::string> grplist;
+    for (auto gid : gids) {
+        struct group* group = getgrgid(gid);
+        // this pointer can get null, happens e.g. with PBSPro which assigns a group to a process
+        // that does not exist
+        if (group == nullptr) {
+            continue;
+        }
+        grplist.push_back(std::string(group->gr_name));
+    }
+    return grplist;
+}
+
+// resolve identity of current process with one passwd lookup and one group lookup per group
+Identity getIdentity(const std::vector<std::string>& admins) {
+    if (traceflag)
+        spdlog::trace("getIdentity()");
+    Identity id;
+    id.uid = getuid();
+    gsl::not_null<struct passwd*> pw = getpwuid(id.uid);
+    id.username = pw->pw_name;
+    id.home = pw->pw_dir;
+    struct group* grp = getgrgid(getegid());
+    id.groupname = grp != nullptr ? grp->gr_name : "";
+    id.gids = getProcessGids();
+    // names keep order of getgroups, gids are sorted for intersections
+    id.groups = getGroupnames(id.gids);
+    std::sort(id.gids.begin(), id.gids.end());
+    id.root = (id.uid == 0);
+    id.admin = std::find(admins.begin(), admins.end(), id.username) != admins.end();
+
+    if (debugflag && debuglevel > 0)
+        spdlog::debug("identity: user={}, groups={}, admin={}", id.username, id.groups, id.admin);
+
+    return id;
+}
+
 // get current username via real user id and passwd
+// real user id does not change while running, so passwd is asked only once
 std::string getUsername() {
-    gsl::not_null<struct passwd*> pw = getpwuid(getuid());
-    return std::string(pw->pw_name);
+    static const std::string username = gsl::not_null<struct passwd*>(getpwuid(getuid()))->pw_name;
+    return username;
 }
 
 // get home of current user via real user id and pwassd
 // we have this to avoid $HOME
 std::string getUserhome() {
-    gsl::not_null<struct passwd*> pw = getpwuid(getuid());
-    return std::string(pw->pw_dir);
+    static const std::string home = gsl::not_null<struct passwd*>(getpwuid(getuid()))->pw_dir;
+    return home;
 }
 
 // see if we are root
@@ -87,30 +145,8 @@ std::string getGroupname() {
 std::vector<std::string> getGrouplist() {
     if (traceflag)
         spdlog::trace("getGroupList()");
-    std::vector<std::string> grplist;
-
-    // find first size and get list
-    int size = getgroups(0, nullptr);
-
-    if (size == -1) {
-        spdlog::error("error in getgroups()!");
-        return grplist;
-    }
-
-    gsl::not_null<gid_t*> gids = new gid_t[size];
-    int ret = getgroups(size, gids);
 
-    for (int i = 0; i < ret; i++) {
-        struct group* group = getgrgid(gids.get()[i]);
-        // this pointer can get null, happens e.g. with PBSPro which assigns a group to a process
-        // that does not exist
-        if (group == nullptr) {
-            continue;
-        }
-        grplist.push_back(std::string(group->gr_name));
-    }
-
-    delete[] gids;
+    auto grplist = getGroupnames(getProcessGids());
 
     if (debugflag && debuglevel > 0)
         spdlog::debug("groups={}", grplist);
@@ -121,62 +157,77 @@ std::vector<std::string> getGrouplist() {
 // return a list of groupnames for a given user
 std::vector<std::string> getUserGroupList(const std::string& username) {
     std::vector<std::string> groupList;
-    struct passwd* pw;
 
-    // Get user information by username
-    pw = getpwnam(username.c_str());
-    if (pw == nullptr) {
-        spdlog::warn("user {} not found.", username);
-        return groupList; // Return empty vector
+    // Use a set to store unique group names, as two gids can have the same name
+    std::set<std::string> uniqueGroupNames;
+    for (auto gid : getUserGids(username)) {
+        struct group* gr = getgrgid(gid);
+        if (gr != nullptr) {
+            uniqueGroupNames.insert(gr->gr_name);
+        } else {
+            spdlog::warn("could not get group name for GID {}", gid);
+        }
     }
 
-    // Get primary group name
-    struct group* gr = getgrgid(pw->pw_gid);
-    if (gr != nullptr) {
-        groupList.push_back(gr->gr_name);
-    } else {
-        spdlog::warn("could not get primary group name for GID {}", pw->pw_gid);
+    // Convert set back to vector
+    groupList.assign(uniqueGroupNames.begin(), uniqueGroupNames.end());
+
+    return groupList;
+}
+
+// return sorted gids (primary and supplementary) of a given user, empty if user is unknown
+// this does not resolve group names, which is one NSS lookup per group less
+std::vector<gid_t> getUserGids(const std::string& username) {
+    // Get user information by username, reentrant, the cache calls this from many threads
+    struct passwd pwbuf;
+    struct passwd* pw = nullptr;
+    std::vector<char> buffer(16384);
+    while (getpwnam_r(username.c_str(), &pwbuf, buffer.data(), buffer.size(), &pw) == ERANGE)
+        buffer.resize(buffer.size() * 2);
+    if (pw == nullptr) {
+        spdlog::warn("user {} not found.", username);
+        return {};
     }
+    gid_t primary = pw->pw_gid;
 
-    // Get supplementary groups
     // getgrouplist needs a buffer for gids. We'll start with a reasonable size
     // and resize if needed.
     int ngroups = 10; // Initial guess for number of groups
     std::vector<gid_t> gids(ngroups);
 
-    int result = getgrouplist(username.c_str(), pw->pw_gid, gids.data(), &ngroups);
+    int result = getgrouplist(username.c_str(), primary, gids.data(), &ngroups);
 
     if (result == -1) {
         // Buffer was too small. ngroups now contains the required size.
         gids.resize(ngroups);
-        result = getgrouplist(username.c_str(), pw->pw_gid, gids.data(), &ngroups);
+        result = getgrouplist(username.c_str(), primary, gids.data(), &ngroups);
     }
 
     if (result == -1) {
-        spdlog::warn("getgrouplist failed for user ", username);
-        return groupList; // Return what we have so far (primary group, if any)
+        spdlog::warn("getgrouplist failed for user {}", username);
+        return {primary}; // Return what we have so far
     }
 
-    // Use a set to store unique group names, as getgrouplist might return
-    // the primary group name again.
-    std::set<std::string> uniqueGroupNames;
-    if (!groupList.empty()) { // Add primary group if it was successfully found
-        uniqueGroupNames.insert(groupList[0]);
-    }
+    // getgrouplist returns the primary group as well
+    gids.resize(ngroups);
+    std::sort(gids.begin(), gids.end());
+    gids.erase(std::unique(gids.begin(), gids.end()), gids.end());
+    return gids;
+}
 
-    for (int i = 0; i < ngroups; ++i) {
-        gr = getgrgid(gids[i]);
-        if (gr != nullptr) {
-            uniqueGroupNames.insert(gr->gr_name);
-        } else {
-            spdlog::warn("could not get group name for GID {}", gids[i]);
-        }
+// check if two sorted gid lists have a common gid, merge without allocation
+bool hasCommonGid(const std::vector<gid_t>& a, const std::vector<gid_t>& b) {
+    auto ia = a.begin();
+    auto ib = b.begin();
+    while (ia != a.end() && ib != b.end()) {
+        if (*ia < *ib)
+            ++ia;
+        else if (*ib < *ia)
+            ++ib;
+        else
+            return true;
     }
-
-    // Convert set back to vector
-    groupList.assign(uniqueGroupNames.begin(), uniqueGroupNames.end());
-
-    return groupList;
+    return false;
 }
 
 } // namespace user
@@ -38,6 +38,22 @@
 
 namespace user {
 
+// identity of the calling user, resolved once at startup and passed to where it is needed,
+// so NSS lookups do not grow with the number of processed entries
+struct Identity {
+    uid_t uid;                       // real uid
+    std::string username;            // name of real uid
+    std::string home;                // home of real uid
+    std::string groupname;           // name of effective group, empty if unknown
+    std::vector<gid_t> gids;         // groups of current process, sorted
+    std::vector<std::string> groups; // names of groups of current process, unknown groups skipped
+    bool root;                       // real uid is root
+    bool admin;                      // user is in admins list of config
+};
+
+// resolve identity of current process, admins is the admins list of the config
+Identity getIdentity(const std::vector<std::string>& admins);
+
 std::string getUsername();
 std::string getUserhome();
 bool isRoot();
@@ -49,6 +65,10 @@ std::string getGroupname();
 std::vector<std::string> getGrouplist();
 // return a list of groupnames for a given user
 std::vector<std::string> getUserGroupList(const std::string& username);
+// return sorted gids (primary and supplementary) of a given user, empty if user is unknown
+std::vector<gid_t> getUserGids(const std::string& username);
+// check if two sorted gid lists have a common gid
+bool hasCommonGid(const std::vector<gid_t>& a, const std::vector<gid_t>& b);
 
 } // namespace user
 
@@ -29,10 +29,10 @@
  */
 
 #include <cassert>
+#include <cstdio> // renameat2
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
-#include <dirent.h>
 #include <fcntl.h>
 #include <filesystem>
 #include <fstream>
@@ -83,14 +83,8 @@ extern bool traceflag;
 extern int debuglevel;
 extern Cap caps;
 
-// fwd
-static void rmtree_fd(int topfd, std::string path, const std::time_t deadline);
-
 namespace utils {
 
-// fwd
-static bool glob_match(char const* pat, char const* str);
-
 // read a (small) file into a string
 std::string getFileContents(const char* filename) {
     std::ifstream in(filename, std::ios::in | std::ios::binary);
@@ -103,7 +97,7 @@ std::string getFileContents(const char* filename) {
 }
 
 // write a (small) string to a file
-void writeFile(const std::string filename, const std::string content) {
+void writeFile(const std::string& filename, const std::string& content) {
     std::ofstream out(filename);
     if (out.is_open()) {
         out << content;
@@ -113,8 +107,25 @@ void writeFile(const std::string filename, const std::string content) {
     }
 }
 
+// write a string completely to a file descriptor, return false on error
+bool writeAll(int fd, const std::string& content) {
+    const char* buf = content.data();
+    size_t left = content.size();
+    while (left > 0) {
+        ssize_t n = write(fd, buf, left);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        buf += n;
+        left -= n;
+    }
+    return true;
+}
+
 // get file names matching glob pattern from path, ("/etc", "p*d") -> passwd, match dirs if dirs==true
-std::vector<string> dirEntries(const string path, const string pattern, const bool dirs) {
+std::vector<string> dirEntries(const string& path, const string& pattern, const bool dirs) {
     if (traceflag)
         spdlog::trace("dirEntries({},{})", path, pattern);
     vector<string> fl;
@@ -133,7 +144,7 @@ std::vector<string> dirEntries(const string path, const string pattern, const bo
 
 // glob matching stolen from linux kernel, under MIT/GPL
 //   https://github.com/torvalds/linux/blob/master/lib/glob.c
-static bool glob_match(char const* pat, char const* str) {
+bool glob_match(char const* pat, char const* str) {
     if (traceflag)
         spdlog::trace("glob_match({},{})", pat, str);
 
@@ -275,14 +286,19 @@ std::string getFirstLine(const std::string& multilineString) {
 
 // getID returns id part of workspace id <username-id>
 // Updated to accept the username explicitly and correctly handle usernames that contain '-'
-std::string getID(const std::string username, const std::string wsid) {
-    const std::string prefix = username + "-";
+std::string getID(const std::string& username, const std::string& wsid) {
+    return std::string(getIDView(username, wsid));
+}
+
+// same as getID, but returns a view into wsid, does not allocate
+std::string_view getIDView(const std::string& username, const std::string& wsid) {
     // Verify that wsid actually starts with the expected "username-" prefix
-    if (wsid.rfind(prefix, 0) != 0) {
-        spdlog::error("wsid '{}' does not start with expected username- prefix '{}'", wsid, prefix);
+    if (wsid.size() <= username.size() || wsid.compare(0, username.size(), username) != 0 ||
+        wsid[username.size()] != '-') {
+        spdlog::error("wsid '{}' does not start with expected username- prefix '{}-'", wsid, username);
         return "";
     }
-    return wsid.substr(prefix.size());
+    return std::string_view(wsid).substr(username.size() + 1);
 }
 
 /*
@@ -443,7 +459,7 @@ std::vector<std::string> splitString(const std::string& str, char delimiter) {
 
 // parse ACL list into a map, empty intent list should be interpreted as all permissions granted
 // FIXME: add unit tests
-auto parseACL(const std::vector<std::string> acl) -> std::map<std::string, std::pair<std::string, std::vector<int>>> {
+auto parseACL(const std::vector<std::string>& acl) -> std::map<std::string, std::pair<std::string, std::vector<int>>> {
     if (traceflag)
         spdlog::trace("parseACL({})", acl);
     std::map<std::string, std::pair<std::string, std::vector<int>>> aclmap;
@@ -475,42 +491,6 @@ auto parseACL(const std::vector<std::string> acl) -> std::map<std::string, std::
     return aclmap;
 }
 
-// delete path be deleting contents and deleting path itself
-void rmtree(std::string path, std::time_t deadline) {
-    if (traceflag) {
-        spdlog::trace("rmtree({}, {})", path, deadline);
-    }
-
-    struct stat orig_stat, new_stat;
-
-    int r = fstatat(0, path.c_str(), &orig_stat, AT_SYMLINK_NOFOLLOW);
-    if (r) {
-        spdlog::error("fstatat {} -> {}", path, errno);
-    }
-
-    if (S_ISDIR(orig_stat.st_mode)) {
-        bool dirfd_closed = false;
-        int dirfd = openat(0, path.c_str(), O_RDONLY | O_CLOEXEC);
-        r = fstatat(dirfd, "", &new_stat, AT_EMPTY_PATH);
-        if (r == 0 && memcmp(&new_stat, &orig_stat, sizeof(struct stat)) == 0) {
-            rmtree_fd(dirfd, path, deadline);
-            close(dirfd);
-            dirfd_closed = true;
-
-            r = unlinkat(0, path.c_str(), AT_REMOVEDIR);
-            if (r) {
-                spdlog::error("unlinkat {} -> {}", path, strerror(errno));
-            }
-        }
-        if (!dirfd_closed)
-            close(dirfd);
-    }
-}
-
-// delete path be deleting contents and deleting path itself
-// without deadline
-void rmtree(std::string path) { rmtree(path, (std::time_t)0L); }
-
 // pretty print a size in bytes
 string prettyBytes(const uint64_t size) {
     string postfixes[] = {"B", "KB", "MB", "GB", "TB", "PB", "EP", "ZB", "YB", "RB", "QB"};
@@ -528,7 +508,7 @@ string prettyBytes(const uint64_t size) {
 // setup logging
 //  set format
 //  change to stderr
-void setupLogging(const std::string ident) {
+void setupLogging(const std::string& ident) {
     // spdlog::set_pattern("%^%10l%$ : %v");
 
     if (user::isRoot()) {
@@ -582,33 +562,31 @@ std::string trimright(const char* in) {
 
 // thread safe ctime implementation, use this where std::ctime was used
 // please note: this does NOT append a \n!
-std::string ctime(const time_t* timer) {
-    char buffer[80];
-
-    auto ret = std::strftime(buffer, sizeof(buffer), "%c", localtime(timer));
-    if (ret == 0) {
-        spdlog::warn("bad strftime call in utils::ctime");
-    }
-    return std::string(buffer);
-}
+std::string ctime(const time_t* timer) { return ctime(*timer); }
 
 // thread safe ctime implementation, use this where std::ctime was used
 // please note: this does NOT append a \n!
 std::string ctime(const time_t ctimer) {
     char buffer[80];
+    return std::string(ctime(ctimer, buffer, sizeof(buffer)));
+}
 
-    time_t timer = ctimer;
-    auto ret = std::strftime(buffer, sizeof(buffer), "%c", localtime(&timer));
+// ctime into caller provided buffer, for loops that should not allocate
+const char* ctime(const time_t timer, char* buffer, const size_t size) {
+    struct tm tm;
+    auto ret = std::strftime(buffer, size, "%c", localtime_r(&timer, &tm));
     if (ret == 0) {
+        buffer[0] = '\0';
         spdlog::warn("bad strftime call in utils::ctime");
     }
-    return std::string(buffer);
+    return buffer;
 }
 
 std::string permstring(const fs::perms p) {
-    stringstream str;
+    // fits into small string buffer, no allocation
+    string ret;
     using std::filesystem::perms;
-    auto show = [&](char op, perms perm) { str << (perms::none == (perm & p) ? '-' : op); };
+    auto show = [&](char op, perms perm) { ret.push_back(perms::none == (perm & p) ? '-' : op); };
     show('r', perms::owner_read);
     show('w', perms::owner_write);
     show('x', perms::owner_exec);
@@ -618,8 +596,6 @@ std::string permstring(const fs::perms p) {
     show('r', perms::others_read);
     show('w', perms::others_write);
     show('x', perms::others_exec);
-    string ret;
-    str >> ret;
     return ret;
 }
 
@@ -643,80 +619,43 @@ int mv(const char* source, const char* target) {
     return 0;
 }
 
-} // end of namespace utils
-
-// internal recursive functions, based on file handles
-// delete a directory and its contents, should be temper safe, with a deadline (epoch time)
-// after the deadline is passed, no new recursion will be started,
-// so the deadline is not hard but soft and can be missed significantly
-// deadline==0 disables the deadline
-static void rmtree_fd(int topfd, std::string path, const std::time_t deadline) {
-    if (traceflag) {
-        spdlog::trace("rmtree_fd({}, {}, {})", topfd, path, deadline);
+// rename source to target, but fail with EEXIST instead of replacing an existing target
+// this is atomic and saves the exists() check and the race that comes with it
+int renameNoReplace(const char* source, const char* target) {
+#if defined(__linux__) && defined(RENAME_NOREPLACE)
+    int r = renameat2(AT_FDCWD, source, AT_FDCWD, target, RENAME_NOREPLACE);
+    // EINVAL/ENOSYS: filesystem (e.g. older NFS) or kernel does not know the flag
+    if (r == 0 || (errno != EINVAL && errno != ENOSYS)) {
+        return r;
     }
-
-    // check for deadline
-    if (deadline != 0 && std::time((long*)0L) >= deadline) {
-        spdlog::info("rmtree_fd deadline passed, exiting.");
-        return;
+#endif
+    // fallback, link fails atomically if target exists
+    if (link(source, target) != 0) {
+        return -1;
     }
-
-    auto dir = fdopendir(topfd);
-    if (dir != nullptr) {
-        std::vector<struct dirent*> entries;
-
-        auto entry = readdir(dir);
-        while (entry) {
-            entries.push_back(entry);
-            errno = 0;
-            entry = readdir(dir);
-            if (entry == nullptr && errno != 0) {
-                spdlog::error("errno={}", errno);
-            }
-        }
-
-        for (auto& ent : entries) {
-            if (ent->d_type == DT_DIR) {
-                // ignore . and .. !!!!!!!
-                if (strcmp((const char*)&ent->d_name[0], ".") && strcmp((const char*)&ent->d_name[0], "..")) {
-                    struct stat orig_stat, new_stat;
-
-                    int r = fstatat(topfd, (const char*)&ent->d_name[0], &orig_stat, AT_SYMLINK_NOFOLLOW);
-                    if (r) {
-                        spdlog::error("fstatat {} {}/{} -> {}", topfd, path, (const char*)&ent->d_name[0], errno);
-                        continue;
-                    }
-
-                    if (S_ISDIR(orig_stat.st_mode)) {
-                        int dirfd = openat(topfd, (const char*)&ent->d_name[0], O_RDONLY | O_CLOEXEC);
-                        bool dirfd_closed = false;
-                        r = fstatat(dirfd, "", &new_stat, AT_EMPTY_PATH);
-                        if (r == 0 && memcmp(&new_stat, &orig_stat, sizeof(struct stat)) == 0) {
-                            rmtree_fd(dirfd, fs::path(path) / (const char*)&ent->d_name[0], deadline);
-                            close(dirfd);
-                            dirfd_closed = true;
-
-                            r = unlinkat(topfd, (const char*)&ent->d_name[0], AT_REMOVEDIR);
-                            if (r) {
-                                spdlog::error("unlinkat {}/{} -> {}", path, (const char*)&ent->d_name[0],
-                                              strerror(errno));
-                            }
-                        } else {
-                            spdlog::error("rmtree hit a symbolic link!");
-                        }
-                        if (!dirfd_closed)
-                            close(dirfd);
-                    }
-                }
-            } else {
-                int r = unlinkat(topfd, (const char*)&ent->d_name[0], 0);
-                if (r) {
-                    spdlog::error("unlinkat {}/{} -> {}", path, (const char*)&ent->d_name[0], strerror(errno));
-                }
-            }
-        }
-        closedir(dir);
-    } else {
-        spdlog::error("fdopendir {} -> {}", topfd, errno);
+    // target is published now, so this is a success, caller has to care for a remaining source
+    if (unlink(source) != 0) {
+        spdlog::warn("could not remove {} after linking it to {} ({})", source, target, std::strerror(errno));
     }
+    return 0;
+}
+
+// latest reminder point of a workspace passed at now, 0 if none is passed yet
+std::time_t reminderDue(const std::time_t expiration, const long reminder, const std::vector<int>& schedule,
+                        const std::time_t now) {
+    if (reminder <= 0)
+        return 0;
+    std::time_t due = 0;
+    auto passed = [&](long days) {
+        std::time_t point = expiration - days * 24 * 3600;
+        if (now > point)
+            due = std::max(due, point);
+    };
+    passed(reminder);
+    for (auto days : schedule)
+        if (days > 0 && days < reminder)
+            passed(days);
+    return due;
 }
+
+} // end of namespace utils
@@ -31,16 +31,23 @@
  */
 
 #include <algorithm>
+#include <cstdint>
 #include <ctime>
 #include <filesystem>
 #include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "fmt/core.h"
 #include "fmt/format.h"
+#include "nsscache.h"
 #include "user.h"
 
+class Executor;
+class MetadataLimiter;
+
 namespace utils {
 
 // helper to show sourcelocation in debugging
@@ -56,13 +63,19 @@ class SrcPos {
 
 // read a small file and returnm as string
 std::string getFileContents(const char* filename);
-inline std::string getFileContents(const std::string filename) { return getFileContents(filename.c_str()); }
+inline std::string getFileContents(const std::string& filename) { return getFileContents(filename.c_str()); }
 
 // write a (small) string to a file
-void writeFile(const std::string filename, const std::string content);
+void writeFile(const std::string& filename, const std::string& content);
+
+// write a string completely to a file descriptor, return false on error
+bool writeAll(int fd, const std::string& content);
 
 // retrurn list of filesnames mit unix name globbing
-std::vector<std::string> dirEntries(const std::string path, const std::string pattern, const bool dirs);
+std::vector<std::string> dirEntries(const std::string& path, const std::string& pattern, const bool dirs);
+
+// match string against unix glob pattern, as used by dirEntries
+bool glob_match(char const* pat, char const* str);
 
 // set C local in every thinkable way
 void setCLocal();
@@ -74,7 +87,9 @@ bool isValidEmail(const std::string& email);
 std::string getFirstLine(const std::string& multilineString);
 
 // getID returns id part of workspace id <username-id>
-std::string getID(const std::string username, const std::string wsid);
+std::string getID(const std::string& username, const std::string& wsid);
+// same as getID, returns a view into wsid
+std::string_view getIDView(const std::string& username, const std::string& wsid);
 
 // check if person behind tty is human
 // bool ruh();
@@ -84,13 +99,50 @@ std::string getID(const std::string username, const std::string wsid);
 bool new_ruh();
 
 // parse a ACL
-auto parseACL(const std::vector<std::string> acl) -> std::map<std::string, std::pair<std::string, std::vector<int>>>;
+auto parseACL(const std::vector<std::string>& acl) -> std::map<std::string, std::pair<std::string, std::vector<int>>>;
+
+// result of rmtree, counters include earlier runs continued from a checkpoint
+struct RmtreeStats {
+    long files = 0;        // deleted files, symlinks etc.
+    long dirs = 0;         // deleted directories
+    uint64_t bytes = 0;    // allocated space freed, files with other hard links do not count
+    double seconds = 0;    // time of this run
+    long errors = 0;       // failed operations in this run
+    long pending = 0;      // directories not started before deadline, kept in checkpoint
+    long runs = 1;         // number of runs
+    bool complete = false; // path is gone
+    bool expired = false;  // deadline passed before it was gone
+};
 
 // delete a directory and its contents, should be temper safe, with a deadline (epoch time)
+// subdirectories are deleted in parallel on the executor (see rmtree.cpp)
 // after the deadline is passed, no new recursion will be started,
 // so the deadline is not hard but soft and can be missed significantly
 // deadline==0 disables the deadline
-void rmtree(std::string path, const std::time_t deadline);
+RmtreeStats rmtree(std::string path, const std::time_t deadline);
+
+// per filesystem settings of rmtree
+struct RmtreeOptions {
+    MetadataLimiter* limiter = nullptr; // limits metadata operations of the filesystem
+    bool inodeorder = false;            // unlink entries of each batch in inode order, for better locality
+    Executor* executor = nullptr;       // threads deleting in parallel, Executor::instance() if not set
+    bool countbytes = false;            // stat every file before unlinking it, for the freed space of files,
+                                        // costs one more metadata operation per file
+};
+
+// same, but continues from checkpointfile if it exists and belongs to path,
+// and writes it if the deadline passed, removes it once path is gone
+RmtreeStats rmtree(const std::string& path, const std::time_t deadline, const std::string& checkpointfile,
+                   const RmtreeOptions& options = {});
+
+// name of checkpoint file for path, hidden file next to it
+std::string rmtreeCheckpoint(const std::string& path);
+
+// name of marker file requesting asynchronous deletion of path by ws_expirer, hidden file next to it
+std::string purgeMarker(const std::string& path);
+
+// create purge marker for path, true if it exists afterwards
+bool requestPurge(const std::string& path);
 
 // delete a directory and its contents, should be temper safe
 void rmtree(std::string path);
@@ -102,7 +154,7 @@ std::vector<std::string> splitString(const std::string& str, char delimiter);
 std::string prettyBytes(const uint64_t size);
 
 // setup the logging
-void setupLogging(const std::string ident);
+void setupLogging(const std::string& ident);
 
 // right trim whitespaces from a string
 std::string trimright(const std::string& in);
@@ -110,44 +162,30 @@ std::string trimright(const char* in);
 
 // class to check existance of intersection of group lists of two users, on user provided through constructor,
 // other user provided through method, with caching for result
+// groups are compared as sorted gid lists, group names are not resolved, lookups go through user::NSSCache
 // returns true if second user is unknown (empty group list)
 class HasGroupIntersection {
   private:
-    std::vector<std::string> baselist;
-    std::map<std::string, bool> resultcache;
+    std::vector<gid_t> baselist;
+    std::unordered_map<std::string, bool> resultcache;
 
   public:
     // call this with caller user
-    HasGroupIntersection(const std::string baseuser) {
-        baselist = user::getUserGroupList(baseuser);
-        std::sort(baselist.begin(), baselist.end());
+    HasGroupIntersection(const std::string& baseuser) {
+        baselist = user::NSSCache::instance().getUserGids(baseuser);
     };
     // call this with another user to check if groups ov the two overlap
-    bool hasCommonGroups(const std::string user) {
+    bool hasCommonGroups(const std::string& user) {
         auto it = resultcache.find(user);
         if (it != resultcache.end())
             return it->second;
 
         // not found
-        auto comparelist = user::getUserGroupList(user);
+        auto comparelist = user::NSSCache::instance().getUserGids(user);
         // if this is empty, user is probably unknown, we better assume there is some intersection
-        if (comparelist.size() == 0) {
-            resultcache[user] = true;
-            return true;
-        }
-        std::sort(comparelist.begin(), comparelist.end());
-
-        std::vector<std::string> intersection;
-        std::set_intersection(baselist.begin(), baselist.end(), comparelist.begin(), comparelist.end(),
-                              std::back_inserter(intersection));
-
-        if (intersection.size() > 0) {
-            resultcache[user] = true;
-            return true;
-        } else {
-            resultcache[user] = false;
-            return false;
-        }
+        bool common = comparelist.empty() || user::hasCommonGid(baselist, comparelist);
+        resultcache[user] = common;
+        return common;
     };
 };
 
@@ -155,6 +193,8 @@ class HasGroupIntersection {
 // please note: this does NOT append a \n!
 std::string ctime(const time_t* timer);
 std::string ctime(const time_t timer);
+// same, formats into buffer and returns it
+const char* ctime(const time_t timer, char* buffer, const size_t size);
 
 // get a string like rwx------ for permissions
 std::string permstring(std::filesystem::perms p);
@@ -162,6 +202,16 @@ std::string permstring(std::filesystem::perms p);
 // move a file/directory to another location using /bin/mv, fallback for rename EXDEV
 int mv(const char* source, const char* target);
 
+// rename source to target, but fail with EEXIST instead of replacing an existing target
+// uses renameat2(RENAME_NOREPLACE), falls back to link+unlink on filesystems without support,
+// where source can remain after success if it could not be unlinked
+int renameNoReplace(const char* source, const char* target);
+
+// latest reminder point of a workspace passed at now, 0 if none is passed yet
+// points are reminder days before expiration, and the days of schedule smaller than reminder
+std::time_t reminderDue(const std::time_t expiration, const long reminder, const std::vector<int>& schedule,
+                        const std::time_t now);
+
 } // namespace utils
 
 #endif
@@ -34,6 +34,9 @@
 
 namespace ws {
 
+// compiled config cache, only used for the default config files
+const auto configcachefile = "/run/hpc-workspace/config.cache";
+
 // regex for workspace name check
 const auto workspace_name_regex = R"(^[a-zA-Z0-9][a-zA-Z0-9\._-]*$)";
 
@@ -224,12 +224,13 @@ void commandline(po::variables_map& opt, string& name, int& duration, string& fi
  *
  *  return true if ok and false if not
  */
-bool validateFsAndGroup(const Config& config, const po::variables_map& opt, const std::string username) {
+bool validateFsAndGroup(const Config& config, const po::variables_map& opt, const user::Identity& identity,
+                        const std::string& username) {
     if (traceflag)
         spdlog::trace("validateFsAndGroup(username={})", username);
 
     // auto groupnames=getgroupnames(username); // FIXME:  use getGrouplist ?
-    auto groupnames = user::getGrouplist();
+    const auto& groupnames = identity.groups;
 
     // if a group was given, check if a valid group was given
     if (opt.count("groupreadable") && opt["groupreadable"].as<string>() != "") {
@@ -262,7 +263,7 @@ bool validateFsAndGroup(const Config& config, const po::variables_map& opt, cons
  *
  * return true if ok and false if not, changes values if out of bounds
  */
-bool validateDuration(const Config& config, const std::string filesystem, int& duration) {
+bool validateDuration(const Config& config, const std::string& filesystem, int& duration) {
     if (traceflag)
         spdlog::trace("validateDurationAndExtensions(filesystem={},duration={})", filesystem, duration);
 
@@ -286,7 +287,7 @@ bool validateDuration(const Config& config, const std::string filesystem, int& d
 }
 
 // count workspaces of user, in all valid filesystems
-int countWorkspaces(const Config& config, const std::string username, const std::vector<std::string>& grouplist) {
+int countWorkspaces(const Config& config, const std::string& username, const std::vector<std::string>& grouplist) {
     int counter = 0;
 
     // where to list from?
@@ -326,19 +327,20 @@ int countWorkspaces(const Config& config, const std::string username, const std:
  *  FIXME: make it -> int and return errors for tesing
  *  FIXME: unit test this? make smaller functions to be able to test?
  */
-bool allocate(const Config& config, const po::variables_map& opt, int duration, string filesystem, const string name,
-              const bool extensionflag, const int reminder, const string mailaddress, string user_option,
-              const string groupreadable, const string groupwritable, const string comment) {
+bool allocate(const Config& config, const user::Identity& identity, const po::variables_map& opt, int duration,
+              string filesystem, const string& name, const bool extensionflag, const int reminder,
+              const string& mailaddress, string user_option, const string& groupreadable, const string& groupwritable,
+              const string& comment) {
     if (traceflag)
         spdlog::trace("allocate({}, {}, {}, {}, {}, {}, {}, {},{}, {})", duration, filesystem, name, extensionflag,
                       reminder, mailaddress, user_option, groupreadable, groupwritable, comment);
 
     long exp;
 
-    std::string username = user::getUsername(); // current user
+    const std::string& username = identity.username; // current user
 
     // get valid filesystems to bail out if there is none
-    auto valid_filesystems = config.validFilesystems(user::getUsername(), user::getGrouplist(), ws::CREATE);
+    auto valid_filesystems = config.validFilesystems(username, identity.groups, ws::CREATE);
 
     if (valid_filesystems.size() == 0) {
         spdlog::error("no valid filesystems in configuration, can not allocate");
@@ -346,7 +348,7 @@ bool allocate(const Config& config, const po::variables_map& opt, int duration,
     }
 
     // validate filesystem and group given on command line
-    if (!validateFsAndGroup(config, opt, user_option)) {
+    if (!validateFsAndGroup(config, opt, identity, user_option)) {
         // fmt::print(stderr, "Error  : aborting!\n");
         exit(-2);
     }
@@ -358,21 +360,18 @@ bool allocate(const Config& config, const po::variables_map& opt, int duration,
         searchlist.push_back(opt["filesystem"].as<string>());
     } else {
         if (extensionflag)
-            searchlist =
-                config.validFilesystems(user::getUsername(), user::getGrouplist(),
-                                        ws::EXTEND); // FIXME: getUsername or user_option? getGrouplist uses current uid
+            searchlist = config.validFilesystems(username, identity.groups,
+                                                 ws::EXTEND); // FIXME: username or user_option? groups of current uid
         else
-            searchlist =
-                config.validFilesystems(user::getUsername(), user::getGrouplist(),
-                                        ws::CREATE); // FIXME: getUsername or user_option? getGrouplist uses current uid
+            searchlist = config.validFilesystems(username, identity.groups,
+                                                 ws::CREATE); // FIXME: username or user_option? groups of current uid
     }
 
     //
     // check if there is already too many workspaces
     //
     if (config.maxuserworkspaces() > 0) {
-        auto grouplist = user::getGrouplist();
-        if (countWorkspaces(config, username, grouplist) > config.maxuserworkspaces()) {
+        if (countWorkspaces(config, username, identity.groups) > config.maxuserworkspaces()) {
             spdlog::error("too many workspaces, exceeding global user limit, failing.");
             syslog(LOG_ERR, "user <%s> exceeding workspace number limit", username.c_str());
             return false;
@@ -570,9 +569,6 @@ bool allocate(const Config& config, const po::variables_map& opt, int duration,
         // if it does not exist, create it
         spdlog::info("creating workspace.");
 
-        // read the possible spaces for the filesystem
-        vector<string> spaces = config.getFsConfig(newfilesystem).spaces;
-
         // SPEC:CHANGE: no LUA callouts
 
         // open DB where workspace will be created
@@ -590,7 +586,7 @@ bool allocate(const Config& config, const po::variables_map& opt, int duration,
         if (groupreadable != "" || groupwritable != "") {
             primarygroup = (groupreadable != "") ? groupreadable : groupwritable;
         } else {
-            primarygroup = user::getGroupname();
+            primarygroup = identity.groupname;
         }
 
         // check if any group option is set
@@ -670,7 +666,8 @@ int main(int argc, char** argv) {
     }
 
     // read the config
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
@@ -681,8 +678,11 @@ int main(int argc, char** argv) {
         duration = config.durationdefault();
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
     // check if user is in debugusers list
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -695,8 +695,8 @@ int main(int argc, char** argv) {
     // spdlog::info("maxuserworkspaces = {}", config.maxuserworkspaces());
 
     // allocate workspace
-    if (!allocate(config, opt, duration, filesystem, name, extensionflag, reminder, mailaddress, user_option,
-                  groupreadable, groupwritable, comment)) {
+    if (!allocate(config, identity, opt, duration, filesystem, name, extensionflag, reminder, mailaddress,
+                  user_option, groupreadable, groupwritable, comment)) {
         return -1;
     }
 }
@@ -34,15 +34,12 @@
 #include <optional>
 #include <sstream>
 
-// Include bshoshany thread-pool
-#define BS_THREAD_POOL_NATIVE_EXTENSIONS
-#include "BS_thread_pool.hpp"
-
 #include "config.h"
 #include <boost/program_options.hpp>
 
 #include "build_info.h"
 #include "db.h"
+#include "executor.h"
 #include "fmt/base.h"
 #include "fmt/ostream.h"
 #include "fmt/ranges.h" // IWYU pragma: keep
@@ -64,9 +61,6 @@ bool debugflag = false;
 bool traceflag = false;
 int debuglevel = 0;
 
-// ThreadPool for database processing
-BS::thread_pool global_pool;
-
 // Mutex for synchronizing access to entrylist
 mutex entrylist_mutex;
 
@@ -188,14 +182,18 @@ int main(int argc, char** argv) {
         }
     }
 
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
     // check if user is in debugusers list, disable debug/trace mode if not
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -230,9 +228,9 @@ int main(int argc, char** argv) {
     }
 
     // root and admins can choose usernames
-    string username = user::getUsername(); // used for rights checks
-    string userpattern;                    // used for pattern matching in DB
-    if (user::isRoot() || config.isAdmin(user::getUsername())) {
+    const string& username = identity.username; // used for rights checks
+    string userpattern;                          // used for pattern matching in DB
+    if (identity.root || identity.admin) {
         if (user != "") {
             userpattern = user;
         } else {
@@ -261,11 +259,8 @@ int main(int argc, char** argv) {
 
     vector<std::unique_ptr<DBEntry>> entrylist;
 
-    // Initialize thread pool once for all filesystems
-    if (debugflag) {
-        spdlog::debug("Creating thread pool");
-    }
-    BS::thread_pool global_pool;
+    // threads for reading DB entries, WS_THREADS or config
+    Executor::instance().start(Executor::threadCount(0, config.threads()));
 
     // iterate over filesystems and collect entries to be edited
     for (auto const& fs : fslist) {
@@ -281,22 +276,21 @@ int main(int argc, char** argv) {
 
         auto matchlist = db->matchPattern(pattern, userpattern, {}, listexpired, false);
 
-        // Use thread pool to collect entries in parallel
-        global_pool
-            .submit_loop(0, matchlist.size(),
-                         [db = db.get(), &matchlist, &entrylist, listexpired](size_t i) {
-                             try {
-                                 std::unique_ptr<DBEntry> entry(db->readEntry(matchlist[i], listexpired));
-                                 // if entry is valid
-                                 if (entry) {
-                                     lock_guard<mutex> lock(entrylist_mutex);
-                                     entrylist.push_back(std::move(entry));
-                                 }
-                             } catch (DatabaseException& e) {
-                                 spdlog::error(e.what());
-                             }
-                         })
-            .wait();
+        // collect entries in parallel
+        Executor::instance().parallel_for(0, matchlist.size(),
+                                          [db = db.get(), &matchlist, &entrylist, listexpired](size_t i) {
+                                              try {
+                                                  std::unique_ptr<DBEntry> entry(
+                                                      db->readEntry(matchlist[i], listexpired));
+                                                  // if entry is valid
+                                                  if (entry) {
+                                                      lock_guard<mutex> lock(entrylist_mutex);
+                                                      entrylist.push_back(std::move(entry));
+                                                  }
+                                              } catch (DatabaseException& e) {
+                                                  spdlog::error(e.what());
+                                              }
+                                          });
 
     } // loop over fs
 
@@ -31,10 +31,20 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <filesystem>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 #include "config.h"
@@ -42,6 +52,8 @@
 
 #include "build_info.h"
 #include "db.h"
+#include "dbcache.h"
+#include "executor.h"
 #include "fmt/base.h"
 #include "fmt/ostream.h"
 #include "fmt/ranges.h" // IWYU pragma: keep
@@ -50,9 +62,13 @@
 #include "caps.h"
 #include "config.h"
 #include "mail.h"
+#include "mailspool.h"
+#include "ratelimit.h"
+#include "stray.h"
 #include "user.h"
 #include "utils.h"
 
+#include "spdlog/pattern_formatter.h"
 #include "spdlog/sinks/daily_file_sink.h" // IWYU pragma: keep
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/sinks/syslog_sink.h" // IWYU pragma: keep
@@ -75,6 +91,43 @@ int debuglevel = 0;
 
 bool cleanermode = false;
 bool forcedeletereleased = false;
+bool countbytes = false; // stat deleted files for the freed space, for the summary mail
+
+// type for statistics of deleted directories
+struct delete_result_t {
+    long completed = 0;  // directories gone
+    long unfinished = 0; // directories with checkpoint, continued in next run
+    long files = 0;      // deleted files, including earlier runs of unfinished directories
+    long dirs = 0;       // deleted directories, same
+    uint64_t bytes = 0;  // freed space, same
+    double seconds = 0;  // time spent deleting in this run
+
+    // count result of one rmtree
+    void add(const utils::RmtreeStats& stats) {
+        if (stats.complete)
+            completed++;
+        else
+            unfinished++;
+        files += stats.files;
+        dirs += stats.dirs;
+        bytes += stats.bytes;
+        seconds += stats.seconds;
+    }
+
+    // unlinks per second of this run, earlier runs of unfinished directories are counted as well
+    double rate() const { return seconds > 0 ? (files + dirs) / seconds : 0; }
+
+    // add elements for global sum
+    delete_result_t& operator+=(const delete_result_t& other) {
+        completed += other.completed;
+        unfinished += other.unfinished;
+        files += other.files;
+        dirs += other.dirs;
+        bytes += other.bytes;
+        seconds += other.seconds;
+        return *this;
+    }
+};
 
 // type for statistics
 struct expire_result_t {
@@ -87,6 +140,8 @@ struct expire_result_t {
     long inactive_keep;
     long inactive_deleted;
 
+    delete_result_t deletion{};
+
     // add elements for global sum
     expire_result_t& operator+=(const expire_result_t& other) {
         active_seen += other.active_seen;
@@ -97,6 +152,7 @@ struct expire_result_t {
         inactive_seen += other.inactive_seen;
         inactive_keep += other.inactive_keep;
         inactive_deleted += other.inactive_deleted;
+        deletion += other.deletion;
         return *this; // Return a reference to the modified object
     }
 };
@@ -108,12 +164,15 @@ struct clean_stray_result_t {
     long valid_deleted;
     long invalid_deleted;
 
+    delete_result_t deletion{};
+
     // add elements for global sum
     clean_stray_result_t& operator+=(const clean_stray_result_t& other) {
         valid_ws += other.valid_ws;
         invalid_ws += other.invalid_ws;
         valid_deleted += other.valid_deleted;
         invalid_deleted += other.invalid_deleted;
+        deletion += other.deletion;
         return *this; // Return a reference to the modified object
     }
 };
@@ -135,6 +194,76 @@ struct morbid_db_files_t {
     }
 };
 
+// time limit of ws_expirer for one filesystem (expirertimelimit), work left is done by the next run
+struct time_budget_t {
+    std::time_t end = 0;          // 0 if unlimited
+    std::atomic<bool> hit{false}; // work was skipped as the limit passed
+
+    // true once the limit passed, callers skip their remaining work then
+    bool passed() {
+        if (end != 0 && !hit.load(std::memory_order_relaxed) && std::time(nullptr) >= end && !hit.exchange(true))
+            spdlog::warn("   time limit of filesystem reached, leaving remaining work to the next run");
+        return hit.load(std::memory_order_relaxed);
+    }
+
+    // deadline of one deletion, deldirtimeout from now, but not after the limit
+    std::time_t deadline(const Config& config) const {
+        std::time_t deadline = std::time(nullptr) + config.deldirtimeout();
+        return end != 0 ? std::min(deadline, end) : deadline;
+    }
+};
+
+// reminder due for a workspace, sent in the digest of its mail address once all filesystems are done
+struct reminder_t {
+    std::string fs;
+    std::string id;
+    std::string mailaddress;
+    long expiration = 0;
+};
+
+// work of ws_expirer on one filesystem, each filesystem is processed by a thread of its own
+struct fs_run_t {
+    std::string fs;
+    enum state_t { pending, running, done, failed, hung } state = pending;
+    std::time_t limit = 0; // end of time limit, 0 if unlimited
+    std::string problem;   // why the filesystem was not processed completely, empty if it was
+
+    delete_result_t purge;
+    clean_stray_result_t stray = {0, 0, 0, 0};
+    expire_result_t expire = {0, 0, 0, 0, 0, 0, 0};
+    morbid_db_files_t morbid = {0, {}};
+    std::vector<reminder_t> reminders; // for digests, if reminderdigest is set
+};
+
+// runs of all filesystems, shared with the threads processing them,
+// which can outlive main if a filesystem hangs
+struct fs_runner_t {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<fs_run_t> runs; // in order of the filesystems, keeps the summary tables deterministic
+    size_t next = 0;            // next run to start
+    unsigned alive = 0;         // threads not yet exited
+};
+
+// time after the time limit until a still running filesystem is given up as hanging,
+// deletions and scans check the limit only between directories
+const std::time_t hunggrace = 600;
+
+// time sending mails from the mail spool at the end of a run, the rest is sent by the next run
+const std::time_t spooldraintime = 900;
+
+// filesystem the thread works on, prefixes its log lines, empty in the main thread
+static thread_local std::string logprefix;
+
+// pattern flag %* for the log prefix of the thread
+class LogPrefixFlag : public spdlog::custom_flag_formatter {
+  public:
+    void format(const spdlog::details::log_msg&, const std::tm&, spdlog::memory_buf_t& dest) override {
+        dest.append(logprefix.data(), logprefix.data() + logprefix.size());
+    }
+    std::unique_ptr<custom_flag_formatter> clone() const override { return std::make_unique<LogPrefixFlag>(); }
+};
+
 const std::string CRLF = "\r\n";
 const std::string boundary = "_NextPart_01234567.89ABCDEF";
 
@@ -156,11 +285,18 @@ static std::string formatTimedelta(long seconds) {
     }
 }
 
+// log formatter for pattern, %* is the log prefix of the thread
+static std::unique_ptr<spdlog::formatter> logFormatter(const std::string& pattern) {
+    auto formatter = std::make_unique<spdlog::pattern_formatter>();
+    formatter->add_flag<LogPrefixFlag>('*').set_pattern(pattern);
+    return formatter;
+}
+
 // own ws_expirer logging setup,
 // logs in color to console
 static void setupMinimalLogging() {
     auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-    console_sink->set_pattern("%^%l%$: %v");
+    console_sink->set_formatter(logFormatter("%^%l%$: %*%v"));
 
     spdlog::logger* log = new spdlog::logger("ws_expirer", {console_sink});
     spdlog::set_default_logger(std::shared_ptr<spdlog::logger>(log));
@@ -170,24 +306,24 @@ static void setupMinimalLogging() {
 // own ws_expirer logging setup,
 // logs in color to console
 // and into a daily rotating file with timestamps if name is provided
-static void setupLogging(const std::string pathname) {
+static void setupLogging(const std::string& pathname) {
     if (pathname.size() == 0) {
         spdlog::warn("config contains no expirerlogpath, no file logging.");
         return; // this early return keeps logging setup before in place
     }
 
     auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-    console_sink->set_pattern("%^%l%$: %v");
+    console_sink->set_formatter(logFormatter("%^%l%$: %*%v"));
 
     auto file_sink = std::make_shared<spdlog::sinks::daily_file_format_sink_mt>(pathname, 0, 1);
-    file_sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
+    file_sink->set_formatter(logFormatter("[%Y-%m-%d %H:%M:%S.%e] [%l] %*%v"));
     spdlog::logger* log = new spdlog::logger("ws_expirer", {file_sink, console_sink});
     spdlog::set_default_logger(std::shared_ptr<spdlog::logger>(log));
     spdlog::set_level(spdlog::level::trace);
 }
 
 // file rename that falls back to utils::mv in case of EXDEV
-void robust_rename(const cppfs::path src, const cppfs::path dest) {
+void robust_rename(const cppfs::path& src, const cppfs::path& dest) {
     try {
         cppfs::rename(src, dest);
     } catch (cppfs::filesystem_error& e) {
@@ -202,7 +338,7 @@ void robust_rename(const cppfs::path src, const cppfs::path dest) {
 }
 
 // construct reminder mail (does not send it)
-std::string generateReminderMail(const std::string& mail_from, std::vector<std::string>& mail_to,
+std::string generateReminderMail(const std::string& mail_from, const std::vector<std::string>& mail_to,
                                  const long expirationtime, const std::string& wsname, const std::string& fsname,
                                  const std::string& clustername) {
 
@@ -237,8 +373,72 @@ std::string generateReminderMail(const std::string& mail_from, std::vector<std::
     return mail.str();
 }
 
+// construct digest of the reminders of one mail address (does not send it),
+// lists the workspaces and has a calendar file with all of them attached
+std::string generateDigestMail(const std::string& mail_from, const std::vector<std::string>& mail_to,
+                               std::vector<reminder_t> reminders, const std::string& clustername) {
+
+    std::sort(reminders.begin(), reminders.end(), [](const reminder_t& a, const reminder_t& b) {
+        return std::tie(a.expiration, a.fs, a.id) < std::tie(b.expiration, b.fs, b.id);
+    });
+
+    std::stringstream mail;
+    std::string messageID = mail::generateMessageID("ws_expirer");
+    time_t now = time((long*)0L);
+    std::string createtimestr = mail::generateMailDateFormat(now);
+
+    std::string to_header = mail::generateToHeader(mail_to);
+
+    std::vector<mail::CalendarEvent> events;
+    for (const auto& reminder : reminders)
+        events.push_back({reminder.id, reminder.fs, reminder.expiration});
+    std::string encodedICS = mail::base64Encode(mail::generateICS(events, clustername, now));
+
+    mail << "From: " << mail_from << CRLF;
+    mail << "To: " << to_header << CRLF;
+    if (reminders.size() == 1) {
+        mail << "Subject: Workspace " << reminders[0].id << " will expire at "
+             << mail::generateMailDateFormat(reminders[0].expiration) << CRLF;
+    } else {
+        mail << "Subject: " << reminders.size() << " workspaces at HPC System " << clustername << " will expire"
+             << CRLF;
+    }
+    mail << "Message-ID: <" << messageID << ">" << CRLF;
+    mail << "Date: " << createtimestr << CRLF;
+    mail << "MIME-Version: 1.0" << CRLF;
+    mail << "Content-Type: multipart/mixed; boundary=" << boundary << CRLF;
+    mail << "" << CRLF;
+
+    mail << "--" << boundary << CRLF;
+    mail << "Content-Type: text/plain; charset=UTF-8" << CRLF;
+    mail << "Content-Transfer-Encoding: 7bit" << CRLF;
+    mail << "" << CRLF;
+    mail << "Your following workspaces at HPC System " << clustername << " will expire:" << CRLF;
+    mail << "" << CRLF;
+    for (const auto& reminder : reminders) {
+        mail << "  " << reminder.id << " on filesystem " << reminder.fs << " at "
+             << mail::generateMailDateFormat(reminder.expiration) << CRLF;
+    }
+    mail << "" << CRLF;
+
+    mail << "--" << boundary << CRLF;
+    mail << "Content-Type: text/calendar; charset=UTF-8; method=REQUEST" << CRLF;
+    mail << "Content-Transfer-Encoding: base64" << CRLF;
+    mail << "Content-Disposition: attachment; filename=workspaces.ics" << CRLF;
+    mail << "" << CRLF;
+    for (size_t i = 0; i < encodedICS.length(); i += 76) {
+        mail << encodedICS.substr(i, 76) << CRLF;
+    }
+
+    mail << "" << CRLF;
+    mail << "--" << boundary << "--" << CRLF;
+    mail << "" << CRLF;
+
+    return mail.str();
+}
+
 // construct error mail (does not send it)
-std::string generateErrorMail(const std::string& mail_from, std::vector<std::string> mail_to,
+std::string generateErrorMail(const std::string& mail_from, const std::vector<std::string>& mail_to,
                               const std::string& subject) {
     std::stringstream mail;
     std::string messageID = mail::generateMessageID("ws_expirer");
@@ -269,8 +469,8 @@ std::string generateErrorMail(const std::string& mail_from, std::vector<std::str
     return mail.str();
 }
 
-std::string generateSummaryMail(const std::string& mail_from, std::vector<std::string> mail_to,
-                                const std::string subject, const std::string& body) {
+std::string generateSummaryMail(const std::string& mail_from, const std::vector<std::string>& mail_to,
+                                const std::string& subject, const std::string& body) {
 
     std::stringstream mail;
     std::string messageID = mail::generateMessageID("ws_expirer");
@@ -302,28 +502,250 @@ std::string generateSummaryMail(const std::string& mail_from, std::vector<std::s
     return mail.str();
 }
 
+// send mail over session, or queue it if a mail spool is configured, the spool is sent at the end of the run,
+// so a slow or unreachable mail server does not delay expiration
+static bool postMail(const Config& config, mail::Session& session, const std::string& mail_from,
+                     const std::vector<std::string>& mail_to, const std::string& completeMail) {
+    if (!config.mailspool().empty())
+        return mail::Spool(config.mailspool()).enqueue(mail_from, mail_to, completeMail);
+    return session.send(mail_from, mail_to, completeMail);
+}
+
+// send the mails queued in the mail spool
+static void drainMailSpool(const Config& config) {
+    if (config.mailspool().empty())
+        return;
+    if (config.smtphost().empty()) {
+        spdlog::warn("No smtphost to send the mails in mail spool {}, please check your system config",
+                     config.mailspool());
+        return;
+    }
+    auto stats = mail::Spool(config.mailspool())
+                     .drain("smtp://" + config.smtphost(), config.mailrate(), std::time(nullptr) + spooldraintime);
+    if (stats.sent + stats.deferred + stats.failed + stats.pending > 0)
+        spdlog::info(" Mail spool: {} sent, {} deferred, {} failed, {} pending", stats.sent, stats.deferred,
+                     stats.failed, stats.pending);
+}
+
+// record a sent reminder in the DB entry, the entry is read again as it could have been changed
+// (e.g. extended) while the mail was sent, so only a reminder still due is recorded
+static void recordReminder(const Config& config, Database* db, const std::string& id, const long expiration) {
+    try {
+        auto dbentry = db->readEntry(id, false);
+        if (!dbentry)
+            return;
+        if (dbentry->getExpiration() != expiration) {
+            spdlog::info("   entry {} changed while reminding, reminder not recorded", id);
+            return;
+        }
+        auto due = utils::reminderDue(expiration, dbentry->getReminder(), config.reminderschedule(),
+                                      time((long*)0L));
+        if (due == 0 || dbentry->getReminderSent() >= due)
+            return;
+        dbentry->setReminderSent(time((long*)0L));
+        dbentry->writeEntry();
+    } catch (DatabaseException& e) {
+        spdlog::error("   failed to record reminder in db entry: {} ({})", id, e.what());
+    }
+}
+
+// send the reminders due on all filesystems, one digest per mail address, and record them in the DB entries
+static void sendReminderDigests(const Config& config, const std::vector<fs_run_t>& runs) {
+    std::map<std::string, std::vector<reminder_t>> byaddress;
+    for (const auto& run : runs) {
+        // threads of hanging filesystems may still add reminders
+        if (run.state != fs_run_t::done && run.state != fs_run_t::failed)
+            continue;
+        for (const auto& reminder : run.reminders)
+            byaddress[reminder.mailaddress].push_back(reminder);
+    }
+    if (byaddress.empty())
+        return;
+
+    std::string smtpUrl = "smtp://" + config.smtphost();
+    const std::string& mail_from = config.mailfrom();
+    mail::Session mailsession(smtpUrl);
+    std::map<std::string, std::vector<reminder_t>> sent; // sent reminders per filesystem
+    for (const auto& [address, reminders] : byaddress) {
+        std::vector<std::string> mail_to = {address};
+        std::string completeMail = generateDigestMail(mail_from, mail_to, reminders, config.clustername());
+        spdlog::info("sending reminder digest to {} for {} workspaces", address, reminders.size());
+        try {
+            if (!postMail(config, mailsession, mail_from, mail_to, completeMail)) {
+                spdlog::error("Failed to send email, please check the mailaddress in the DB Entry");
+                continue;
+            }
+        } catch (const std::exception& e) {
+            spdlog::error("Exception while sending email: {}", e.what());
+            continue;
+        }
+        for (const auto& reminder : reminders)
+            sent[reminder.fs].push_back(reminder);
+    }
+
+    // next run sends the next reminder of the schedule only
+    for (const auto& [fs, fsreminders] : sent) {
+        try {
+            std::unique_ptr<Database> db(config.openDB(fs));
+            for (const auto& reminder : fsreminders)
+                recordReminder(config, db.get(), reminder.id, reminder.expiration);
+        } catch (DatabaseException& e) {
+            spdlog::error("failed to record reminders in DB of filesystem {} ({})", fs, e.what());
+        }
+    }
+}
+
+// open DB of filesystem, wrapped in a cache that lives for this run, so entries read while
+// cleaning stray directories are not read and parsed again while expiring
+// returns nullptr and informs admins if DB is invalid, caller should skip this DB then
+static std::unique_ptr<CachingDatabase> openCachedDB(const Config& config, const std::string& fs) {
+    std::string smtpUrl = "smtp://" + config.smtphost();
+    const std::string& mail_from = config.mailfrom();
+    const std::vector<std::string>& adminmails = config.adminmail();
+
+    // check for errors, if this throws DB is invalid and we should skip this DB
+    try {
+        return std::make_unique<CachingDatabase>(std::unique_ptr<Database>(config.openDB(fs)));
+    } catch (DatabaseException& e) {
+        spdlog::error(e.what());
+        spdlog::error("skipping, to avoid data loss");
+
+        // Sending Error Mail
+        std::string subject = e.what();
+
+        if (smtpUrl == "" || mail_from == "" || adminmails.size() == 0) {
+            spdlog::warn(
+                "No smtphost or mailfrom available to contact users or admins, please check your system config");
+        } else {
+            std::string completeMail = generateErrorMail(mail_from, adminmails, subject);
+            try {
+                mail::Session mailsession(smtpUrl);
+                if (!postMail(config, mailsession, mail_from, adminmails, completeMail)) {
+                    spdlog::error("Failed to send email, please check the mailaddress in the DB Entry");
+                }
+            } catch (const std::exception& e) {
+                spdlog::error("Exception while sending email: {}", e.what());
+            }
+        }
+        return nullptr;
+    }
+}
+
+// settings of rmtree for a filesystem
+static utils::RmtreeOptions rmtreeOptions(const Config& config, const std::string& fs, Executor& executor) {
+    utils::RmtreeOptions options;
+    options.limiter = &MetadataLimiter::forFilesystem(fs);
+    options.inodeorder = config.getFsConfig(fs).deleteorder == "inode";
+    options.executor = &executor;
+    options.countbytes = countbytes;
+    return options;
+}
+
+// log result of a deletion with deadline
+static void logDeletion(const utils::RmtreeStats& stats) {
+    if (stats.complete) {
+        spdlog::info("      deleted {} files and {} directories, freed {}{} in {:.1f}s", stats.files, stats.dirs,
+                     utils::prettyBytes(stats.bytes), stats.runs > 1 ? fmt::format(" in {} runs", stats.runs) : "",
+                     stats.seconds);
+    } else if (stats.expired) {
+        spdlog::info("      deadline passed, deleted {} files and {} directories, freed {} in {} runs so far, "
+                     "continuing with {} directories in next run",
+                     stats.files, stats.dirs, utils::prettyBytes(stats.bytes), stats.runs, stats.pending);
+    } else {
+        spdlog::warn("      not deleted completely, {} errors, deleted {} files and {} directories in {} runs so far, "
+                     "continuing in next run",
+                     stats.errors, stats.files, stats.dirs, stats.runs);
+    }
+}
+
+// purge_requested
+//  deletes workspaces queued by ws_release --delete-data and ws_restore --delete-data,
+//  all queued workspaces of the filesystem in parallel
+static delete_result_t purge_requested(const Config& config, const std::string& fs, Database* db,
+                                       const std::string& single_space, const bool dryrun,
+                                       const utils::RmtreeOptions& options, time_budget_t& budget) {
+    delete_result_t result;
+
+    spdlog::info("* PURGE QUEUED WORKSPACES for filesystem: {}", fs);
+
+    std::vector<string> spaces = config.getFsConfig(fs).spaces;
+    if (single_space != "") {
+        if (!canFind(spaces, single_space))
+            return result;
+        spaces = {single_space};
+    }
+
+    // queued directories, the DB entry was removed before the marker was written
+    std::vector<string> queued;
+    for (const auto& space : spaces) {
+        auto deleted = cppfs::path(space) / config.deletedPath(fs);
+        for (const auto& marker : utils::dirEntries(deleted.string(), ".*.purge", false)) {
+            queued.push_back((deleted / marker.substr(1, marker.size() - 7)).string());
+        }
+    }
+    if (queued.empty())
+        return result;
+
+    // never purge something that can still be restored
+    auto inDB = db->matchPattern("*", "*", {}, true, false);
+    std::sort(inDB.begin(), inDB.end());
+
+    auto& limiter = *options.limiter;
+    auto usage = limiter.usage();
+    std::mutex resultmutex;
+    options.executor->parallel_for(0, queued.size(), [&](size_t i) {
+        if (budget.passed())
+            return;
+        const auto& path = queued[i];
+        auto id = cppfs::path(path).filename().string();
+        if (std::binary_search(inDB.begin(), inDB.end(), id)) {
+            spdlog::warn("    not purging {}, it has a DB entry", path);
+            return;
+        }
+        if (dryrun) {
+            spdlog::info("    would purge {}", path);
+            return;
+        }
+
+        auto stats = utils::rmtree(path, budget.deadline(config), utils::rmtreeCheckpoint(path), options);
+        if (stats.complete) {
+            std::error_code ec;
+            cppfs::remove(utils::purgeMarker(path), ec);
+            spdlog::info("    purged {}, {} files and {} directories, freed {} in {:.1f}s", path, stats.files,
+                         stats.dirs, utils::prettyBytes(stats.bytes), stats.seconds);
+        } else {
+            spdlog::info("    purging {} unfinished, {} files and {} directories, freed {} so far, "
+                         "continuing in next run",
+                         path, stats.files, stats.dirs, utils::prettyBytes(stats.bytes));
+        }
+        std::lock_guard<std::mutex> lock(resultmutex);
+        result.add(stats);
+    });
+    // deletions overlap, time spent is the elapsed time and not the sum
+    result.seconds = std::chrono::duration<double>(MetadataLimiter::clock::now() - usage.when).count();
+
+    spdlog::info(" =>  {} queued workspaces purged, {} unfinished, freed {}", result.completed, result.unfinished,
+                 utils::prettyBytes(result.bytes));
+    limiter.logRate("purge", usage);
+    return result;
+}
+
 // clean_stray_directories
 //  finds directories that are not in DB and removes them,
 //  returns numbers of valid and invalid directories
 //  this searches over filesystem and compares with DB, checks if a valid DB is available (using a magic file)
-static clean_stray_result_t clean_stray_directories(const Config& config, const std::string fs,
-                                                    const std::string single_space, const bool dryrun) {
+static clean_stray_result_t clean_stray_directories(const Config& config, const std::string& fs, Database* db,
+                                                    const std::string& single_space, const bool dryrun,
+                                                    const utils::RmtreeOptions& options, time_budget_t& budget) {
 
     clean_stray_result_t result = {0, 0, 0, 0};
 
-    // helper to store space and found dir together
-    struct dir_t {
-        std::string space;
-        std::string dir;
-    };
-
     std::vector<string> spaces = config.getFsConfig(fs).spaces;
-    std::vector<dir_t> dirs; // list of all directories in all spaces of 'fs'
+    std::vector<FoundDir> dirs; // list of all directories in all spaces of 'fs'
 
-    // Infos needed to send errormails
-    std::string mail_from = config.mailfrom();
-    std::vector<std::string> adminmails = config.adminmail();
-    std::string smtpUrl = "smtp://" + config.smtphost();
+    // scans and deletions share the metadata budget of the filesystem
+    auto& limiter = *options.limiter;
+    auto usage = limiter.usage();
 
     //////// stray directories /////////
     // move directories not having a DB entry to deleted
@@ -346,21 +768,31 @@ static clean_stray_result_t clean_stray_directories(const Config& config, const
     // also collect non-matching directories for logging
     std::vector<string> non_matching_dirs;
     // Filter out the deleted directory path configured for the filesystem
-    const std::string deletedPath = config.deletedPath(fs);
-    for (const auto& space : spaces) {
+    const std::string& deletedPath = config.deletedPath(fs);
+    // spaces are scanned in parallel, results are joined in order of the spaces
+    std::vector<std::vector<FoundDir>> spacedirs(spaces.size());
+    std::vector<std::vector<string>> spacenonmatching(spaces.size());
+    options.executor->parallel_for(0, spaces.size(), [&](size_t i) {
+        const auto& space = spaces[i];
         // NOTE: *-* for compatibility with old expirer
         // collect all directories first to separate matching and non-matching
+        limiter.acquire();
         for (const auto& entry : utils::dirEntries(space, "*", true)) {
+            limiter.acquire();
             if (cppfs::is_directory(cppfs::path(space) / entry)) {
                 if (entry.find('-') != string::npos) {
-                    dirs.push_back({space, entry});
+                    spacedirs[i].push_back({space, entry});
                 } else {
                     if (entry != deletedPath) {
-                        non_matching_dirs.push_back(entry);
+                        spacenonmatching[i].push_back(entry);
                     }
                 }
             }
         }
+    });
+    for (size_t i = 0; i < spaces.size(); i++) {
+        dirs.insert(dirs.end(), spacedirs[i].begin(), spacedirs[i].end());
+        non_matching_dirs.insert(non_matching_dirs.end(), spacenonmatching[i].begin(), spacenonmatching[i].end());
     }
     // Log non-matching directories for manual intervention
 
@@ -373,58 +805,30 @@ static clean_stray_result_t clean_stray_directories(const Config& config, const
         spdlog::warn(" These directories will be ignored and require manual intervention.");
     }
 
-    // check for errors, if this throws DB is invalid and we should skip this DB
-    std::unique_ptr<Database> db;
-    try {
-        db = std::unique_ptr<Database>(config.openDB(fs));
-    } catch (DatabaseException& e) {
-        spdlog::error(e.what());
-        spdlog::error("skipping, to avoid data loss");
-
-        // Sending Error Mail
-        std::string subject = e.what();
-
-        if (smtpUrl == "" || mail_from == "" || adminmails.size() == 0) {
-            spdlog::warn(
-                "No smtphost or mailfrom available to contact users or admins, please check your system config");
-        } else {
-            std::string completeMail = generateErrorMail(mail_from, adminmails, subject);
-            try {
-                if (!mail::sendCurl(smtpUrl, mail_from, adminmails, completeMail)) {
-                    spdlog::error("Failed to send email, please check the mailaddress in the DB Entry");
-                }
-            } catch (const std::exception& e) {
-                spdlog::error("Exception while sending email: {}", e.what());
-            }
-        }
-
-        return result;
-    }
-
     // get all workspace pathes from DB
     // this is a list of all workspace paths in the DB, used to compare with the filesystem
-    auto wsIDs = db->matchPattern("*", "*", {}, false, false);       // (1)
-    std::vector<std::pair<std::string, std::string>> workspacesInDB; // pair of (id, wspath)
-
-    workspacesInDB.reserve(wsIDs.size());
-    for (auto const& wsid : wsIDs) {
+    auto wsIDs = db->matchPattern("*", "*", {}, false, false); // (1)
+    // pair of (id, wspath), entries are read in parallel, they are cached for expire_workspaces
+    std::vector<std::pair<std::string, std::string>> workspacesInDB(wsIDs.size());
+    options.executor->parallel_for(0, wsIDs.size(), [&](size_t i) {
+        const auto& wsid = wsIDs[i];
+        workspacesInDB[i].first = wsid;
         try {
-            workspacesInDB.push_back(std::make_pair(wsid, db->readEntry(wsid, false)->getWSPath()));
+            workspacesInDB[i].second = db->readEntry(wsid, false)->getWSPath();
         } catch (const std::exception& e) {
-            workspacesInDB.push_back(std::make_pair(wsid, "")); // store empty path for failed entries, but keep the id!
+            // empty path for failed entries, but keep the id!
             spdlog::warn("    failed to read DB entry {}: {}", wsid, e.what());
             // TODO: is that something to inform admin about? this workspace is immortal!
         }
-    }
-
-    // compare filesystem with DB
-    for (auto const& founddir : dirs) { // (2)
-        if (std::none_of(workspacesInDB.begin(), workspacesInDB.end(), [&](const auto& item) {
-                // fmt::println("{} == {} || {} == {}", item.second, (cppfs::path(founddir.space) /
-                // cppfs::path(founddir.dir)).string(), item.first, cppfs::path(founddir.dir).string());
-                return item.second == (cppfs::path(founddir.space) / cppfs::path(founddir.dir)).string() ||
-                       item.first == cppfs::path(founddir.dir).string();
-            })) {
+    });
+
+    // compare filesystem with DB, by path or ID
+    auto valid = matchDirectories(dirs, workspacesInDB);
+    for (size_t i = 0; i < dirs.size(); i++) { // (2)
+        const auto& founddir = dirs[i];
+        if (budget.passed())
+            break;
+        if (!valid[i]) {
             spdlog::warn("    stray workspace {}", founddir.dir);
 
             // FIXME: a stray workspace will be moved to deleted here, and will be deleted in
@@ -462,36 +866,58 @@ static clean_stray_result_t clean_stray_directories(const Config& config, const
     // delete deleted workspaces that no longer have any DB entry
     // ws_release moves DB entry first, workspace second, should be race free
     dirs.clear();
-    // directory entries first
-    for (auto const& space : spaces) {
+    // directory entries first, spaces in parallel
+    for (auto& found : spacedirs)
+        found.clear();
+    options.executor->parallel_for(0, spaces.size(), [&](size_t i) {
+        const auto& space = spaces[i];
         // NOTE: *-* for compatibility with old expirer
+        limiter.acquire();
         for (const auto& dir : utils::dirEntries(cppfs::path(space) / config.deletedPath(fs), "*-*", true)) {
+            limiter.acquire();
             if (cppfs::is_directory(cppfs::path(space) / config.deletedPath(fs) / dir)) {
-                dirs.push_back({space, dir});
+                spacedirs[i].push_back({space, dir});
             }
         }
-    }
+        // checkpoints of unfinished deletions and purge requests, whose directory was removed otherwise
+        for (const auto& suffix : {".rmtree", ".purge"}) {
+            auto deleted = cppfs::path(space) / config.deletedPath(fs);
+            for (const auto& file : utils::dirEntries(deleted.string(), fmt::format(".*{}", suffix), false)) {
+                auto dir = deleted / file.substr(1, file.size() - 1 - strlen(suffix));
+                if (!cppfs::exists(cppfs::symlink_status(dir))) {
+                    spdlog::info("      {}remove orphaned {}", cleanermode ? "" : "would ", file);
+                    std::error_code ec;
+                    if (!dryrun)
+                        cppfs::remove(deleted / file, ec);
+                }
+            }
+        }
+    });
+    for (const auto& found : spacedirs)
+        dirs.insert(dirs.end(), found.begin(), found.end());
 
     // get all workspace names from DB, this contains the timestamp
-    wsIDs = db->matchPattern("*", "*", {}, true, false);
-    std::vector<std::string> workspacesInDeletedDB;
-    workspacesInDeletedDB.reserve(wsIDs.size());
-    for (auto const& wsid : wsIDs) {
-        workspacesInDeletedDB.push_back(wsid);
-    }
+    auto workspacesInDeletedDB = db->matchPattern("*", "*", {}, true, false);
 
     // compare filesystem with DB
-    for (auto const& founddir : dirs) {
-        if (!canFind(workspacesInDeletedDB, founddir.dir)) {
+    valid = matchDirectories(dirs, workspacesInDeletedDB);
+    for (size_t i = 0; i < dirs.size(); i++) {
+        const auto& founddir = dirs[i];
+        if (budget.passed())
+            break;
+        if (!valid[i]) {
             spdlog::warn("    stray removed workspace {}", founddir.dir);
             spdlog::info("      {}remove {}", cleanermode ? "" : "would ",
                          (cppfs::path(founddir.space) / config.deletedPath(fs) / founddir.dir).string());
             if (!dryrun) {
                 try {
-                    // timeout is now + deldirtimeout
-                    std::time_t deadline = std::time_t(std::time_t(nullptr)) + config.deldirtimeout();
+                    // timeout is now + deldirtimeout, at most until the time limit
+                    std::time_t deadline = budget.deadline(config);
 
-                    utils::rmtree(cppfs::path(founddir.space) / config.deletedPath(fs) / founddir.dir, deadline);
+                    auto path = (cppfs::path(founddir.space) / config.deletedPath(fs) / founddir.dir).string();
+                    auto stats = utils::rmtree(path, deadline, utils::rmtreeCheckpoint(path), options);
+                    logDeletion(stats);
+                    result.deletion.add(stats);
 
                 } catch (cppfs::filesystem_error& e) {
                     spdlog::error("      failed to remove: {} ({})",
@@ -508,72 +934,69 @@ static clean_stray_result_t clean_stray_directories(const Config& config, const
 
     spdlog::info(" =>   {} valid expired, {} invalid expired directories found.", result.valid_deleted,
                  result.invalid_deleted);
+    limiter.logRate("stray removal", usage);
     return result;
 }
 
 // expire workspace DB entries and moves the workspace to deleted directory
 // deletes expired workspace in second phase
-static expire_result_t expire_workspaces(const Config& config, const string fs, const bool dryrun,
-                                         morbid_db_files_t& morbid_db_files) {
+// entries are processed in parallel by the threads of the filesystem, each entry is read, decided, changed in DB,
+// moved and deleted by one task, the outcomes are merged in order of the DB listing, reminder mails are sent
+// afterwards in that order, or added to reminders for the digests if reminderdigest is set
+static expire_result_t expire_workspaces(const Config& config, const string& fs, Database* db, const bool dryrun,
+                                         morbid_db_files_t& morbid_db_files, std::vector<reminder_t>& reminders,
+                                         const utils::RmtreeOptions& options, time_budget_t& budget) {
 
     expire_result_t result = {0, 0, 0, 0, 0, 0, 0};
 
-    // Infos needed for errormails and remindermails
+    auto& limiter = *options.limiter;
+    auto usage = limiter.usage();
+
+    // Infos needed for remindermails
     std::string smtpUrl = "smtp://" + config.smtphost();
-    std::string mail_from = config.mailfrom();
-    std::vector<std::string> adminmails = config.adminmail();
+    const std::string& mail_from = config.mailfrom();
 
     // vector<string> spaces = config.getFsConfig(fs).spaces;
 
-    std::unique_ptr<Database> db;
-    // check for errors, if this throws DB is invalid and we should skip this DB
-    try {
-        db = std::unique_ptr<Database>(config.openDB(fs));
-    } catch (DatabaseException& e) {
-        spdlog::error(e.what());
-        spdlog::error("skipping, to avoid data loss");
-
-        // Sending Error Mail
-        std::string subject = e.what();
-
-        if (smtpUrl == "" || mail_from == "" || adminmails.size() == 0) {
-            spdlog::warn(
-                "No smtphost or mailfrom available to contact users or admins, please check your system config");
-        } else {
-            std::string completeMail = generateErrorMail(mail_from, adminmails, subject);
-            try {
-                if (!mail::sendCurl(smtpUrl, mail_from, adminmails, completeMail)) {
-                    spdlog::error("Failed to send email, please check the mailaddress in the DB Entry");
-                }
-            } catch (const std::exception& e) {
-                spdlog::error("Exception while sending email: {}", e.what());
-            }
-        }
-        return result;
-    }
-
     spdlog::info("* CHECKING DB FOR WORKSPACES TO BE EXPIRED for filesystem: {}", fs);
 
     spdlog::info("  (keeptime: {} days, releasekeeptime: {} days)", config.getFsConfig(fs).keeptime,
                  config.getFsConfig(fs).releasekeeptime);
 
+    // outcome of one active entry
+    struct active_t {
+        bool seen = false;
+        bool expired = false;
+        bool keep = false;
+        std::string morbid; // reason if entry is bad
+        bool remind = false;
+        std::string mailaddress;
+        long expiration = 0;
+    };
+
     // search expired active workspaces in DB
-    for (auto const& id : db->matchPattern("*", "*", {}, false, false)) {
-        result.active_seen++;
+    auto ids = db->matchPattern("*", "*", {}, false, false);
+    std::vector<active_t> active(ids.size());
+    options.executor->parallel_for(0, ids.size(), [&](size_t i) {
+        if (budget.passed())
+            return;
+        const auto& id = ids[i];
+        auto& outcome = active[i];
+        outcome.seen = true;
         std::unique_ptr<DBEntry> dbentry;
         // error logic first, we skip all loop body in case of bad entry
         try {
             dbentry = std::unique_ptr<DBEntry>(db->readEntry(id, false));
             if (!dbentry) {
                 spdlog::error("skipping db entry {}", id);
-                morbid_db_files.add(std::pair(id, fmt::format("could not read entry, filesystem: {}", fs)));
-                continue;
+                outcome.morbid = fmt::format("could not read entry, filesystem: {}", fs);
+                return;
             }
         } catch (DatabaseException& e) {
             spdlog::error(e.what());
             spdlog::error("skipping db entry {}", id);
-            morbid_db_files.add(std::pair(id, fmt::format("database exeption, filesystem: {}", fs)));
-            continue;
+            outcome.morbid = fmt::format("database exeption, filesystem: {}", fs);
+            return;
         }
 
         // entry is good
@@ -582,19 +1005,25 @@ static expire_result_t expire_workspaces(const Config& config, const string fs,
 
         if (expiration <= 0) {
             spdlog::error("bad expiration in {}, skipping", id);
-            morbid_db_files.add(std::pair(id, fmt::format("bad expiration, filesystem: {}", fs)));
-            continue;
+            outcome.morbid = fmt::format("bad expiration, filesystem: {}", fs);
+            return;
         }
 
         // do we have to expire?
         if (time((long*)0L) > expiration) {
-            auto timestamp = to_string(time((long*)0L));
+            time_t timestamp_time = time((long*)0L);
 
-            result.active_expired++;
+            outcome.expired = true;
             if (!dryrun) {
                 spdlog::info("  expiring {} (expired {})", id, utils::ctime(&expiration));
-                // db entry first
-                dbentry->expire(timestamp);
+                // db entry first, timestamp is changed in case of name collision
+                try {
+                    dbentry->expire(timestamp_time);
+                } catch (DatabaseException& e) {
+                    spdlog::error("   failed to expire db entry: {} ({})", id, e.what());
+                    return;
+                }
+                auto timestamp = to_string(timestamp_time);
 
                 // workspace second
                 auto wspath = dbentry->getWSPath();
@@ -614,58 +1043,118 @@ static expire_result_t expire_workspaces(const Config& config, const string fs,
         } else {
             spdlog::info("   keeping (until {}, {} left): {}", utils::ctime(expiration),
                          formatTimedelta(expiration - time((long*)0L)), id);
+            outcome.keep = true;
+            // one reminder per point of the schedule passed, the last one sent is recorded in the entry
+            auto due = utils::reminderDue(expiration, dbentry->getReminder(), config.reminderschedule(),
+                                          time((long*)0L));
+            if (due != 0 && dbentry->getReminderSent() < due) {
+                outcome.remind = true;
+                outcome.mailaddress = dbentry->getMailaddress();
+                outcome.expiration = expiration;
+            }
+        }
+    });
+
+    // merge outcomes and send reminder emails, over one connection to the mail server
+    mail::Session mailsession(smtpUrl);
+    std::unique_ptr<Database> recorddb; // uncached, to record sent reminders in current entries
+    for (size_t i = 0; i < ids.size(); i++) {
+        const auto& id = ids[i];
+        auto& outcome = active[i];
+        if (!outcome.seen)
+            continue;
+        result.active_seen++;
+        if (outcome.morbid != "")
+            morbid_db_files.add(std::pair(id, outcome.morbid));
+        if (outcome.expired)
+            result.active_expired++;
+        if (outcome.keep)
             result.active_keep++;
-            // Send reminder emails
-            auto reminder = dbentry->getReminder();
-            if (time((long*)0L) > (expiration - (reminder * (24 * 3600)))) {
-                if (smtpUrl == "" || mail_from == "") {
-                    spdlog::warn("No smtphost or mailfrom available to contact users, please check your system config");
-                } else {
-                    result.active_mails++;
-                    if (dryrun) {
-                        spdlog::info("    would send reminder mail to {} for entry {}", dbentry->getMailaddress(), id);
-                    } else {
-                        std::vector<std::string> mail_to;
-                        mail_to.push_back(dbentry->getMailaddress());
-                        std::string clustername = config.clustername();
-
-                        std::string completeMail =
-                            generateReminderMail(mail_from, mail_to, expiration, id, fs, clustername);
-                        spdlog::info("    sending reminder mail to {} for entry {}", mail_to, id);
-                        // fmt::print("{}", completeMail);
-                        try {
-                            if (!mail::sendCurl(smtpUrl, mail_from, mail_to, completeMail)) {
-                                spdlog::error("Failed to send email, please check the mailaddress in the DB Entry");
-                            }
-                        } catch (const std::exception& e) {
-                            spdlog::error("Exception while sending email: {}", e.what());
-                        }
+        if (!outcome.remind)
+            continue;
+
+        if (smtpUrl == "" || mail_from == "") {
+            spdlog::warn("No smtphost or mailfrom available to contact users, please check your system config");
+        } else {
+            result.active_mails++;
+            if (dryrun) {
+                spdlog::info("    would send reminder mail to {} for entry {}", outcome.mailaddress, id);
+            } else if (config.reminderdigest()) {
+                // sent with the other reminders of the address once all filesystems are done
+                reminders.push_back({fs, id, outcome.mailaddress, outcome.expiration});
+            } else {
+                std::vector<std::string> mail_to;
+                mail_to.push_back(outcome.mailaddress);
+                const std::string& clustername = config.clustername();
+
+                std::string completeMail =
+                    generateReminderMail(mail_from, mail_to, outcome.expiration, id, fs, clustername);
+                spdlog::info("    sending reminder mail to {} for entry {}", mail_to, id);
+                // fmt::print("{}", completeMail);
+                bool sent = false;
+                try {
+                    sent = postMail(config, mailsession, mail_from, mail_to, completeMail);
+                    if (!sent) {
+                        spdlog::error("Failed to send email, please check the mailaddress in the DB Entry");
+                    }
+                } catch (const std::exception& e) {
+                    spdlog::error("Exception while sending email: {}", e.what());
+                }
+                // next run sends the next reminder of the schedule only
+                if (sent) {
+                    try {
+                        if (!recorddb)
+                            recorddb.reset(config.openDB(fs));
+                        recordReminder(config, recorddb.get(), id, outcome.expiration);
+                    } catch (DatabaseException& e) {
+                        spdlog::error("   failed to record reminder in db entry: {} ({})", id, e.what());
                     }
                 }
             }
         }
     }
 
+    if (debugflag && mailsession.getSent() > 0)
+        spdlog::debug("sent {} reminder mails over {} connections", mailsession.getSent(),
+                      mailsession.getConnects());
+
     spdlog::info(" =>  {} workspaces expired, {} kept.", result.active_expired, result.active_keep);
     spdlog::info("");
     spdlog::info("* CHECKING DELETED DB FOR WORKSPACES TO BE DELETED for filesystem: {}", fs);
 
+    // outcome of one deleted entry
+    struct inactive_t {
+        bool seen = false;
+        bool deleted = false;
+        bool keep = false;
+        std::string morbid; // reason if entry is bad
+        bool removed = false;
+        utils::RmtreeStats stats; // deletion of directory, if removed
+    };
+
     // search in DB for expired/released workspaces for those over keeptime to delete them
-    for (auto const& id : db->matchPattern("*", "*", {}, true, false)) {
-        result.inactive_seen++;
+    ids = db->matchPattern("*", "*", {}, true, false);
+    std::vector<inactive_t> inactive(ids.size());
+    auto start = MetadataLimiter::clock::now();
+    options.executor->parallel_for(0, ids.size(), [&](size_t i) {
+        if (budget.passed())
+            return;
+        const auto& id = ids[i];
+        auto& outcome = inactive[i];
+        outcome.seen = true;
         std::unique_ptr<DBEntry> dbentry;
         try {
             dbentry = std::unique_ptr<DBEntry>(db->readEntry(id, true));
             if (!dbentry) {
                 spdlog::error("skipping db entry {}", id);
-                morbid_db_files.add(std::pair(id, fmt::format("could not read entry, filesystem: {}", fs)));
-                continue;
+                outcome.morbid = fmt::format("could not read entry, filesystem: {}", fs);
+                return;
             }
         } catch (DatabaseException& e) {
             spdlog::error(e.what());
             spdlog::error("skipping db entry {}", id);
-            morbid_db_files.add(std::pair(id, fmt::format("database exeption, filesystem: {}", fs)));
-            continue;
+            outcome.morbid = fmt::format("database exeption, filesystem: {}", fs);
+            return;
         }
 
         long releasetime;
@@ -689,12 +1178,12 @@ static expire_result_t expire_workspaces(const Config& config, const string fs,
                 std::count(id.begin(), id.end(), '-'))); // count from back, for usernames with "-"
         } catch (const out_of_range& e) {
             spdlog::error("skipping DB entry with unparsable name {}", id);
-            morbid_db_files.add(std::pair(id, fmt::format("unparsable name, filesystem: {}", fs)));
-            continue;
+            outcome.morbid = fmt::format("unparsable name, filesystem: {}", fs);
+            return;
         } catch (const invalid_argument& e) {
             spdlog::error("skipping DB entry with unparsable name {}", id);
-            morbid_db_files.add(std::pair(id, fmt::format("unparsable name, filesystem: {}", fs)));
-            continue;
+            outcome.morbid = fmt::format("unparsable name, filesystem: {}", fs);
+            return;
         }
 
         auto released = dbentry->getReleaseTime(); // check if it was released by user, 0 if not
@@ -727,29 +1216,41 @@ static expire_result_t expire_workspaces(const Config& config, const string fs,
         }
 
         if (should_delete) {
-            result.inactive_deleted++;
+            outcome.deleted = true;
             spdlog::info("   {}delete DB entry {}, was {} {}", cleanermode ? "" : "would ", id, reason,
                          utils::ctime(&releasetime));
 
             if (cleanermode) {
-                db->deleteEntry(id, true);
+                try {
+                    db->deleteEntry(id, true);
+                } catch (DatabaseException& e) {
+                    // directory stays with its entry, next run tries again
+                    spdlog::error(e.what());
+                    spdlog::error("could not delete DB entry {}, keeping directory", id);
+                    outcome.deleted = false;
+                    outcome.morbid = fmt::format("could not delete entry, filesystem: {}", fs);
+                    return;
+                }
             }
 
             auto wspath = cppfs::path(dbentry->getWSPath()).remove_filename() / config.getFsConfig(fs).deletedPath / id;
             spdlog::info("    {}delete directory: {}", cleanermode ? "" : "would ", wspath.string());
             if (cleanermode) {
                 try {
-                    // timeout is now + deldirtimeout;
-                    std::time_t deadline = std::time_t(std::time(nullptr)) + config.deldirtimeout();
+                    // timeout is now + deldirtimeout, at most until the time limit
+                    std::time_t deadline = budget.deadline(config);
                     spdlog::info("   deadline: {}", deadline);
 
-                    utils::rmtree(wspath.string(), deadline);
+                    outcome.stats = utils::rmtree(wspath.string(), deadline, utils::rmtreeCheckpoint(wspath.string()),
+                                                  options);
+                    outcome.removed = true;
+                    logDeletion(outcome.stats);
                 } catch (cppfs::filesystem_error& e) {
                     spdlog::error("  failed to remove: {} ({})", wspath.string(), e.what());
                 }
             }
         } else {
-            result.inactive_keep++;
+            outcome.keep = true;
             long wsdeadline;
             if (released > 1000000000L) {
                 wsdeadline = releasetime + (releasekeeptime * 24 * 3600);
@@ -761,12 +1262,164 @@ static expire_result_t expire_workspaces(const Config& config, const string fs,
                              formatTimedelta(wsdeadline - time((long*)0L)), id);
             }
         }
+    });
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        const auto& outcome = inactive[i];
+        if (!outcome.seen)
+            continue;
+        result.inactive_seen++;
+        if (outcome.morbid != "")
+            morbid_db_files.add(std::pair(ids[i], outcome.morbid));
+        if (outcome.deleted)
+            result.inactive_deleted++;
+        if (outcome.keep)
+            result.inactive_keep++;
+        if (outcome.removed)
+            result.deletion.add(outcome.stats);
     }
+    // deletions overlap, time spent is the elapsed time and not the sum
+    if (result.deletion.completed + result.deletion.unfinished > 0)
+        result.deletion.seconds = std::chrono::duration<double>(MetadataLimiter::clock::now() - start).count();
+
     spdlog::info(" =>  {} workspaces deleted, {} workspaces kept", result.inactive_deleted, result.inactive_keep);
+    limiter.logRate("expiration", usage);
 
     return result;
 }
 
+// all phases for one filesystem, purge, stray removal and expiration, with the time limit of the filesystem
+static void process_filesystem(const Config& config, fs_run_t& run, const unsigned threads,
+                               const std::string& single_space, const bool dryrun, const bool purgeonly) {
+    const auto& fs = run.fs;
+    time_budget_t budget;
+    budget.end = run.limit;
+
+    auto db = openCachedDB(config, fs);
+    if (!db) {
+        run.problem = "invalid DB, skipped";
+        return;
+    }
+
+    // own threads for deleting, a hanging filesystem can not block the deletions of others,
+    // they log with the prefix of the filesystem, also in tasks started by rmtree
+    Executor executor;
+    executor.start(threads, [prefix = logprefix] { logprefix = prefix; });
+    auto options = rmtreeOptions(config, fs, executor);
+
+    run.purge = purge_requested(config, fs, db.get(), single_space, dryrun, options, budget);
+    if (!purgeonly) {
+        run.stray = clean_stray_directories(config, fs, db.get(), single_space, dryrun, options, budget);
+        run.expire = expire_workspaces(config, fs, db.get(), dryrun, run.morbid, run.reminders, options, budget);
+    }
+    if (debugflag) {
+        spdlog::debug("DB cache for {}: {} hits, {} misses", fs, db->getHits(), db->getMisses());
+    }
+    if (budget.hit) {
+        run.problem = fmt::format("time limit of {}s reached, continuing in next run",
+                                  config.getFsConfig(fs).expirertimelimit);
+    }
+}
+
+// process filesystems with parallel threads, each filesystem is done by one thread,
+// waits until all are done, or all unfinished ones hang past their time limit.
+// returns false if threads hang, they are detached then, and can not be joined
+static bool run_filesystems(const Config& config, std::shared_ptr<fs_runner_t> runner, const unsigned parallel,
+                            const unsigned threads, const std::string& single_space, const bool dryrun,
+                            const bool purgeonly) {
+    // runner is copied into the threads, it stays valid for hanging threads after main is done
+    auto worker = [&config, runner, threads, single_space, dryrun, purgeonly] {
+        std::unique_lock<std::mutex> lock(runner->mutex);
+        while (runner->next < runner->runs.size()) {
+            fs_run_t run = runner->runs[runner->next];
+            size_t index = runner->next++;
+            run.state = fs_run_t::running;
+            int timelimit = config.getFsConfig(run.fs).expirertimelimit;
+            run.limit = timelimit > 0 ? std::time(nullptr) + timelimit : 0;
+            runner->runs[index] = run;
+            lock.unlock();
+
+            logprefix = fmt::format("[{}] ", run.fs);
+            try {
+                process_filesystem(config, run, threads, single_space, dryrun, purgeonly);
+                run.state = fs_run_t::done;
+            } catch (const std::exception& e) {
+                spdlog::error("processing filesystem failed: {}", e.what());
+                run.problem = fmt::format("failed: {}", e.what());
+                run.state = fs_run_t::failed;
+            } catch (...) {
+                spdlog::error("processing filesystem failed");
+                run.problem = "failed";
+                run.state = fs_run_t::failed;
+            }
+            logprefix.clear();
+
+            lock.lock();
+            // given up by main, which reads the results already
+            if (runner->runs[index].state == fs_run_t::hung)
+                break;
+            runner->runs[index] = std::move(run);
+            runner->changed.notify_all();
+        }
+        runner->alive--;
+        runner->changed.notify_all();
+    };
+
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(runner->mutex);
+        runner->alive = std::min<size_t>(parallel, runner->runs.size());
+        for (unsigned i = 0; i < runner->alive; i++)
+            workers.emplace_back(worker);
+    }
+
+    bool hanging = false;
+    {
+        std::unique_lock<std::mutex> lock(runner->mutex);
+        while (true) {
+            auto now = std::time(nullptr);
+            size_t finished = 0, active = 0, overdue = 0, pending = 0;
+            for (const auto& run : runner->runs) {
+                if (run.state == fs_run_t::done || run.state == fs_run_t::failed)
+                    finished++;
+                else if (run.state == fs_run_t::pending)
+                    pending++;
+                else if (run.limit != 0 && now > run.limit + hunggrace)
+                    overdue++;
+                else
+                    active++;
+            }
+            if (finished == runner->runs.size())
+                break;
+            // pending filesystems are only started by threads not stuck in an overdue one
+            if (active == 0 && (pending == 0 || runner->alive <= overdue)) {
+                hanging = true;
+                for (auto& run : runner->runs) {
+                    if (run.state == fs_run_t::running) {
+                        run.state = fs_run_t::hung;
+                        run.problem = "hanging, still running after time limit, given up";
+                        spdlog::error("filesystem {} hangs, giving up", run.fs);
+                    } else if (run.state == fs_run_t::pending) {
+                        run.problem = "not started, all threads hang";
+                    }
+                }
+                // no thread may start or finish a run anymore
+                runner->next = runner->runs.size();
+                break;
+            }
+            runner->changed.wait_for(lock, std::chrono::seconds(10));
+        }
+    }
+
+    for (auto& thread : workers) {
+        if (hanging)
+            thread.detach();
+        else
+            thread.join();
+    }
+    return !hanging;
+}
+
 int main(int argc, char** argv) {
 
     // options and flags
@@ -775,6 +1428,9 @@ int main(int argc, char** argv) {
     std::string configfile;
     bool dryrun = true;
     bool summarymail = false;
+    bool purgeonly = false;
+    unsigned int thread_count = 0; // 0 = default (hardware_concurrency)
+    unsigned int parallel = 0;     // 0 = all filesystems at once
 
     morbid_db_files_t morbid_db_files = {0, std::vector<std::pair<std::string, std::string>>()};
 
@@ -799,7 +1455,11 @@ int main(int argc, char** argv) {
         ("filesystems,F", po::value<string>(&filesystem), "filesystems/workspaces to delete from, comma separated")
         ("space,s", po::value<string>(&single_space), "path of a single space that should be deleted")
         ("cleaner,c", "no dry-run mode")
+        ("purge,p", "only delete workspaces queued by --delete-data of ws_release and ws_restore")
+        ("no-ratelimit", "ignore metadatarate and metadataconcurrency of the filesystems, e.g. for nightly runs")
         ("summary-mail,M", "send summary mail to admin after run")
+        ("threads,t", po::value<unsigned int>(&thread_count)->default_value(0), "threads for expiring and deleting per filesystem (default: WS_THREADS env var, threads from config or hardware_concurrency)")
+        ("parallel-filesystems,P", po::value<unsigned int>(&parallel)->default_value(0), "filesystems processed in parallel (default: all)")
         ("config", po::value<string>(&configfile), "path to configfile");
     // clang-format on
 
@@ -849,6 +1509,11 @@ int main(int argc, char** argv) {
 
     if (opts.count("summary-mail")) {
         summarymail = true;
+        countbytes = true;
+    }
+
+    if (opts.count("purge")) {
+        purgeonly = true;
     }
 
     if (opts.count("forcedeletereleased")) {
@@ -866,7 +1531,8 @@ int main(int argc, char** argv) {
         }
     }
 
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
@@ -874,6 +1540,13 @@ int main(int argc, char** argv) {
 
     spdlog::info("deldirtimeout = {} seconds", config.deldirtimeout());
 
+    // limits protect the metadata servers while users are working, they can be lifted for runs at night
+    if (opts.count("no-ratelimit")) {
+        spdlog::info("metadata rate limits disabled");
+    } else {
+        MetadataLimiter::configure(config);
+    }
+
     // now we can add file logging
     setupLogging(config.expirerlogpath());
 
@@ -902,39 +1575,85 @@ int main(int argc, char** argv) {
         spdlog::info("ws_expirer {} - SIMULATING CLEANING - DRYRUN", utils::getVersion());
     }
 
-    // go through filesystem and
+    // filesystems are processed in parallel, each by one thread doing
+    // - purge workspaces queued for deletion by ws_release and ws_restore, --purge does only this
     // - delete stray directories first (directories with no DB entry)
     // - delete deleted ones not in DB
-    // this searches over filesystem and checks DB
+    //   this searches over filesystem and checks DB
+    // - expire workspaces beyond expiration age and
+    // - delete expired ones which are beyond keep date
+    // the DB of a filesystem is opened once and shared by all phases
+    auto runner = std::make_shared<fs_runner_t>();
+    for (auto const& fs : fslist) {
+        runner->runs.emplace_back();
+        runner->runs.back().fs = fs;
+    }
+    // deletion is bound by metadata latency, not by cores, so use at least 4 threads
+    unsigned threads = Executor::threadCount(thread_count, config.threads(), 4);
+    if (parallel == 0 || parallel > fslist.size())
+        parallel = fslist.size();
+    spdlog::info("processing {} filesystems with {} parallel threads, {} deletion threads each", fslist.size(),
+                 parallel, threads);
+    auto runstart = std::chrono::steady_clock::now();
+    bool finished = run_filesystems(config, runner, parallel, threads, single_space, dryrun, purgeonly);
+    double runseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runstart).count();
+    // copy, hung threads still hold the runner and must not change what is read here
+    std::vector<fs_run_t> runs;
+    {
+        std::lock_guard<std::mutex> lock(runner->mutex);
+        runs = runner->runs;
+    }
+
+    // filesystems not processed completely
+    std::vector<std::string> problems;
+    bool failed = !finished;
+    for (const auto& run : runs) {
+        if (run.problem != "")
+            problems.push_back(fmt::format("  {:<15} {}", run.fs, run.problem));
+        if (run.state == fs_run_t::failed)
+            failed = true;
+    }
+
+    if (purgeonly) {
+        delete_result_t total_purge;
+        for (const auto& run : runs)
+            total_purge += run.purge;
+        spdlog::info(" Purge summary: {} completed, {} unfinished, {} files, {} directories", total_purge.completed,
+                     total_purge.unfinished, total_purge.files, total_purge.dirs);
+        for (const auto& line : problems)
+            spdlog::warn("{}", line);
+        drainMailSpool(config);
+        spdlog::info("==== WS_EXPIRER {}RUN END {} =====", dryrun ? "DRY" : "", utils::ctime(std::time(nullptr)));
+        if (!finished) {
+            spdlog::default_logger()->flush();
+            std::_Exit(1);
+        }
+        return failed ? 1 : 0;
+    }
+
+    sendReminderDigests(config, runs);
+
     std::vector<std::pair<std::string, clean_stray_result_t>> stray_stats;
     clean_stray_result_t total_stray = {0, 0, 0, 0};
-    clean_stray_result_t fs_stray;
-    for (auto const& fs : fslist) {
-        fs_stray = clean_stray_directories(config, fs, single_space, dryrun);
-        stray_stats.emplace_back(fs, fs_stray);
-        total_stray += fs_stray;
+    std::vector<std::pair<std::string, expire_result_t>> expire_stats;
+    expire_result_t total_expire = {0, 0, 0, 0, 0, 0, 0};
+    for (const auto& run : runs) {
+        stray_stats.emplace_back(run.fs, run.stray);
+        total_stray += run.stray;
+        expire_stats.emplace_back(run.fs, run.expire);
+        total_expire += run.expire;
+        morbid_db_files += run.morbid;
     }
     spdlog::info(" Stray removal summary: {} valid, {} invalid, {} valid deleted, {} invalid deleted", total_stray.valid_ws,
                  total_stray.invalid_ws, total_stray.valid_deleted, total_stray.invalid_deleted);
     spdlog::info(" End of stray removal");
     spdlog::info("");
 
-    // go through database and
-    // - expire workspaces beyond expiration age and
-    // - delete expired ones which are beyond keep date
-    std::vector<std::pair<std::string, expire_result_t>> expire_stats;
-    expire_result_t total_expire = {0, 0, 0, 0, 0, 0, 0};
-    expire_result_t fs_expire;
-    for (auto const& fs : fslist) {
-        fs_expire = expire_workspaces(config, fs, dryrun, morbid_db_files);
-        expire_stats.emplace_back(fs, fs_expire);
-        total_expire += fs_expire;
-    }
     spdlog::info(" Expiration summary: {} active seen, {} active keep, {} active expired, {} reminders sent, {} "
-                 "inactive seen, {} inactive keep, {} inactive deleted",
+                 "inactive seen, {} inactive keep, {} inactive deleted, {} freed",
                  total_expire.active_seen, total_expire.active_keep, total_expire.active_expired,
                  total_expire.active_mails, total_expire.inactive_seen, total_expire.inactive_keep,
-                 total_expire.inactive_deleted);
+                 total_expire.inactive_deleted, utils::prettyBytes(total_expire.deletion.bytes));
     spdlog::info(" End of expiration");
 
     // Build summary string for logging and mail body
@@ -974,6 +1693,39 @@ int main(int argc, char** argv) {
                        total_expire.active_seen, total_expire.active_keep, total_expire.active_expired,
                        total_expire.active_mails, "", total_expire.inactive_seen, total_expire.inactive_keep,
                        total_expire.inactive_deleted));
+    append("");
+    append("Deletion Summary");
+    append("");
+    append(fmt::format("  {:<15} {:>9} {:>10} {:>11} {:>9} {:>10} {:>7} {:>9}", "Filesystem", "Completed",
+                       "Unfinished", "Files", "Dirs", "Freed", "Time[s]", "Unlinks/s"));
+    append(fmt::format("  {:->89}", ""));
+    delete_result_t total_deletion;
+    for (const auto& run : runs) {
+        delete_result_t fs_deletion = run.purge;
+        fs_deletion += run.stray.deletion;
+        fs_deletion += run.expire.deletion;
+        total_deletion += fs_deletion;
+        append(fmt::format("  {:<15} {:>9} {:>10} {:>11} {:>9} {:>10} {:>7.1f} {:>9.0f}", run.fs,
+                           fs_deletion.completed, fs_deletion.unfinished, fs_deletion.files, fs_deletion.dirs,
+                           utils::prettyBytes(fs_deletion.bytes), fs_deletion.seconds, fs_deletion.rate()));
+    }
+    // filesystems are deleted in parallel, time spent is the elapsed time and not the sum
+    total_deletion.seconds = std::min(total_deletion.seconds, runseconds);
+    append(fmt::format("  {:->89}", ""));
+    append(fmt::format("  {:<15} {:>9} {:>10} {:>11} {:>9} {:>10} {:>7.1f} {:>9.0f}", "total", total_deletion.completed,
+                       total_deletion.unfinished, total_deletion.files, total_deletion.dirs,
+                       utils::prettyBytes(total_deletion.bytes), total_deletion.seconds, total_deletion.rate()));
+    if (total_deletion.unfinished > 0)
+        append(fmt::format("  {} directories were not deleted completely, next run continues.",
+                           total_deletion.unfinished));
+    if (!countbytes && total_deletion.files > 0)
+        append("  Freed does not include files of known type, they are stated only with --summary-mail.");
+    if (!problems.empty()) {
+        append("");
+        append(" Filesystems not processed completely");
+        for (const auto& line : problems)
+            append(line);
+    }
     if (morbid_db_files.count != 0) {
         append("");
         append(" Morbid DB Files");
@@ -988,11 +1740,12 @@ int main(int argc, char** argv) {
 
     if (summarymail) {
         std::string smtpUrl = "smtp://" + config.smtphost();
-        std::string mail_from = config.mailfrom();
-        std::vector<std::string> adminmails = config.adminmail();
+        const std::string& mail_from = config.mailfrom();
+        const std::vector<std::string>& adminmails = config.adminmail();
         std::string completeMail = generateSummaryMail(mail_from, adminmails, runinfo, summary);
         try {
-            if (!mail::sendCurl(smtpUrl, mail_from, adminmails, completeMail)) {
+            mail::Session mailsession(smtpUrl);
+            if (!postMail(config, mailsession, mail_from, adminmails, completeMail)) {
                 spdlog::error("Failed to send email, please check the mailaddress in the DB Entry");
             }
         } catch (const std::exception& e) {
@@ -1000,8 +1753,16 @@ int main(int argc, char** argv) {
         }
     }
 
+    drainMailSpool(config);
+
+    // hanging threads can not be joined and still use the config, leave without destructors
+    if (!finished) {
+        spdlog::default_logger()->flush();
+        std::_Exit(1);
+    }
+
     // Cleanup curl
     mail::cleanupCurl();
 
-    return 0;
+    return failed ? 1 : 0;
 }
@@ -43,6 +43,7 @@
 #include "fmt/base.h"
 #include "fmt/ostream.h"
 #include "fmt/ranges.h" // IWYU pragma: keep
+#include "nsscache.h"
 #include "user.h"
 
 #include "caps.h"
@@ -152,14 +153,21 @@ int main(int argc, char** argv) {
         }
     }
 
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
+    // owners of group workspaces are checked against NSS, cache that
+    user::NSSCache::instance().configure(config.nsscachettl(), config.nssenumeratethreshold());
+
     // check if user is in debugusers list
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -168,9 +176,9 @@ int main(int argc, char** argv) {
     }
 
     // root and admins can choose usernames
-    string username = user::getUsername(); // used for rights checks
-    string userpattern;                    // used for pattern matching in DB
-    if (user::isRoot() || config.isAdmin(user::getUsername())) {
+    const string& username = identity.username; // used for rights checks
+    string userpattern;                          // used for pattern matching in DB
+    if (identity.root || identity.admin) {
         if (user != "") {
             userpattern = user;
         } else {
@@ -181,7 +189,7 @@ int main(int argc, char** argv) {
     }
 
     // list of groups of this process
-    auto grouplist = user::getGrouplist();
+    const auto& grouplist = identity.groups;
 
     // where to list from?
     vector<string> fslist;
@@ -6,7 +6,7 @@
  *  - tool to list workspaces
  *    changes to workspace++:
  *      - c++ implementation (not python anymore)
- *      - runs in parallel using a thread pool
+ *      - runs in parallel using the executor of ws_common
  *        helps to hide network latency of parallel filesystems
  *      - fast YAML reader with rapidyaml
  *
@@ -38,23 +38,21 @@
 #include <memory>
 #include <mutex>
 
-// Include bshoshany thread-pool
-#define BS_THREAD_POOL_NATIVE_EXTENSIONS
-#include "BS_thread_pool.hpp"
-
 #include "config.h"
 #include <boost/program_options.hpp>
 
 #include "build_info.h"
 #include "db.h"
+#include "executor.h"
 #include "fmt/base.h"
-#include "fmt/color.h"
 #include "fmt/format.h" // IWYU pragma: keep
 #include "fmt/ostream.h"
 #include "fmt/ranges.h" // IWYU pragma: keep
+#include "nsscache.h"
 #include "user.h"
 
 #include "caps.h"
+#include "listing.h"
 #include "utils.h"
 #include "ws.h"
 
@@ -73,187 +71,9 @@ bool traceflag = false;
 int debuglevel = 0;
 unsigned int thread_count = 0; // 0 = default (hardware_concurrency)
 
-// ThreadPool for database processing
-// Mutex for synchronizing output from multiple threads
-static mutex print_entry_mtx;
-
-// Helper to get masked ID for display, respecting admin/root privileges
-static string getMaskedID(const DBEntry* entry) {
-    if (entry->getConfig()->isAdmin(user::getUsername())) {
-        return entry->getId();
-    } else {
-        return utils::getID(user::getUsername(), entry->getId());
-    }
-}
-
 // helper for fmt::
 template <> struct fmt::formatter<po::options_description> : ostream_formatter {};
 
-// print entry in traditional format, one below each other, multiline
-void print_entry(const DBEntry* entry, const Config config, const bool verbose, const bool terse,
-                 const bool permissions, const bool listexpired) {
-    lock_guard<mutex> lock(print_entry_mtx);
-
-    fmt::println("Id: {}", getMaskedID(entry));
-
-    fmt::println("    workspace directory  : {}", entry->getWSPath());
-    long remaining;
-    auto fs = entry->getFilesystem();
-    auto fsconfig = config.getFsConfig(fs);
-
-    if (!listexpired) {
-        remaining = entry->getRemaining();
-        fmt::println("    remaining time       : {} days, {} hours", remaining / (24 * 3600),
-                     (remaining % (24 * 3600)) / 3600);
-    } else {
-        if (entry->getReleaseTime() != 0) {
-            fmt::println("    remaining time       : {}", "released");
-            remaining = (entry->getReleaseTime() + (fsconfig.releasekeeptime * 86400)) - time(0L);
-        } else {
-            fmt::println("    remaining time       : {}", "expired");
-            remaining = (entry->getExpired() + (fsconfig.keeptime * 86400)) - time(0L);
-            if (remaining == 0) { // compatability with v1 --> get expiration from the name if expired is not defined
-                std::string id = entry->getId();
-                remaining = (std::stol(utils::splitString(id, '-').at(std::count(id.begin(), id.end(), '-'))) +
-                             (fsconfig.keeptime * 86400)) -
-                            time(0L);
-            }
-        }
-
-        if (remaining <= 0) {
-            fmt::println("    until deletion       : 0 days, 0 hours");
-        } else {
-            fmt::println("    until deletion       : {} days, {} hours", remaining / (24 * 3600),
-                         (remaining % (24 * 3600)) / 3600);
-        }
-    }
-
-    if (!terse) {
-        if (entry->getComment() != "")
-            fmt::println("    comment              : {}", entry->getComment());
-        if (entry->getCreation() > 0)
-            fmt::println("    creation time        : {}", utils::ctime(entry->getCreation()));
-        fmt::println("    expiration time      : {}", utils::ctime(entry->getExpiration()));
-        if (entry->getExpired() > 0)
-            fmt::println("    expired time         : {}", utils::ctime(entry->getExpired()));
-        if (entry->getReleaseTime() > 0)
-            fmt::println("    release time         : {}", utils::ctime(entry->getReleaseTime()));
-        if (entry->getGroup() != "")
-            fmt::println("    group                : {}", entry->getGroup());
-        fmt::println("    filesystem name      : {}", entry->getFilesystem());
-    }
-    fmt::println("    available extensions : {}", entry->getExtension());
-    if (verbose) {
-        long rd = (entry->getExpiration() - (entry->getReminder() * 24 * 3600));
-        fmt::println("    reminder             : {}", utils::ctime(&rd));
-        if (entry->getMailaddress() != "")
-            fmt::println("    mailaddress          : {}", entry->getMailaddress());
-    }
-
-    if (permissions) {
-        auto perm = cppfs::status(entry->getWSPath()).permissions();
-        fmt::println("    permissions          : {}", utils::permstring(perm));
-    }
-}
-
-void print_entry_tableformat(const DBEntry* entry, const Config config, [[maybe_unused]] const bool verbose,
-                             const bool terse, [[maybe_unused]] const bool permissions, const bool listexpired) {
-    static bool headerprinted = false;
-    static bool color_checked = false;
-    static bool color_output = true;
-    static mutex mtx; // protect static variables
-
-    long remaining;
-    auto fs = entry->getFilesystem();
-    auto fsconfig = config.getFsConfig(fs);
-
-    if (!listexpired) {
-        remaining = entry->getRemaining();
-    } else {
-        if (entry->getReleaseTime() != 0) {
-            remaining = (entry->getReleaseTime() + (fsconfig.releasekeeptime * 86400)) - time(0L);
-        } else {
-            remaining = (entry->getExpired() + (fsconfig.keeptime * 86400)) - time(0L);
-            if (remaining == 0) { // compatability with v1 --> get expiration from the name if expired is not defined
-                std::string id = entry->getId();
-                remaining = (std::stol(utils::splitString(id, '-').at(std::count(id.begin(), id.end(), '-'))) +
-                             (fsconfig.keeptime * 86400)) -
-                            time(0L);
-            }
-        }
-    }
-
-    const string ID = getMaskedID(entry);
-
-    // Check color support (thread-safe with mutex)
-    {
-        lock_guard<mutex> lock(mtx);
-        if (!color_checked) {
-            color_checked = true;
-            const char* no_color = std::getenv("NO_COLOR");
-            if (no_color != nullptr && no_color[0] != '\0')
-                color_output = false;
-            if (!isatty(STDOUT_FILENO))
-                color_output = false;
-        }
-    }
-
-#pragma GCC diagnostic push                            // save the actual diag context
-#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" // disable maybe warnings
-    fmt::color remaincolor;
-
-    if (color_output) {
-        if (remaining / (24 * 3600) < 3)
-            remaincolor = fmt::color::red;
-        else if (remaining / (24 * 3600) < 7)
-            remaincolor = fmt::color::orange;
-        else
-            remaincolor = fmt::color::green;
-    }
-
-    bool must_print_header = false;
-    {
-        lock_guard<mutex> lock(mtx);
-        if (!headerprinted) {
-            headerprinted = true;
-            must_print_header = true;
-        }
-    }
-    if (must_print_header) {
-        if (terse) {
-            fmt::println("{:<30} {:<50} {:<9}", "ID", "PATH", "REMAINING");
-            fmt::println("{:=<30} {:=<50} {:=<9}", "", "", "");
-        } else {
-            fmt::println("{:<30} {:<50} {:<25} {:10} {:<9}", "ID", "PATH", "EXPIRATION", "EXTENSIONS", "REMAINING");
-            fmt::println("{:=<30} {:=<50} {:=<25} {:=<10} {:=<9}", "", "", "", "", "");
-        }
-    }
-
-    if (terse) {
-        if (color_output)
-            fmt::println("{:<30}{} {:<50}{} {:<9}", ID, ID.length() > 30 ? fmt::format("{:31}", "\n") : "",
-                         entry->getWSPath(), entry->getWSPath().length() > 50 ? fmt::format("{:82}", "\n") : "",
-                         fmt::styled(remaining / (24 * 3600), fg(remaincolor)));
-        else
-            fmt::println("{:<30}{} {:<50}{} {:<9}", ID, ID.length() > 30 ? fmt::format("{:31}", "\n") : "",
-                         entry->getWSPath(), entry->getWSPath().length() > 50 ? fmt::format("{:82}", "\n") : "",
-                         remaining / (24 * 3600));
-    } else {
-        if (color_output)
-            fmt::println("{:<30}{} {:<50}{} {:<25} {:<10} {:<9}", ID,
-                         ID.length() > 30 ? fmt::format("{:31}", "\n") : "", entry->getWSPath(),
-                         entry->getWSPath().length() > 50 ? fmt::format("{:82}", "\n") : "",
-                         utils::ctime(entry->getExpiration()), entry->getExtension(),
-                         fmt::styled(remaining / (24 * 3600), fg(remaincolor)));
-        else
-            fmt::println("{:<30}{} {:<50}{} {:<25} {:<10} {:<9}", ID,
-                         ID.length() > 30 ? fmt::format("{:31}", "\n") : "", entry->getWSPath(),
-                         entry->getWSPath().length() > 50 ? fmt::format("{:82}", "\n") : "",
-                         utils::ctime(entry->getExpiration()), entry->getExtension(), remaining / (24 * 3600));
-    }
-#pragma GCC diagnostic pop
-}
-
 int main(int argc, char** argv) {
 
     // options and flags
@@ -306,7 +126,7 @@ int main(int argc, char** argv) {
         ("pattern,p", po::value<string>(&pattern), "pattern matching name (glob syntax)")
         ("permissions,P", "list permissions of workspace directory")
         ("verbose,v", "verbose listing")
-        ("threads,n", po::value<unsigned int>(&thread_count)->default_value(0), "number of threads to use (default: hardware_concurrency, override with WS_THREADS env var)");
+        ("threads,n", po::value<unsigned int>(&thread_count)->default_value(0), "number of threads to use (default: WS_THREADS env var, threads from config or hardware_concurrency)");
     // clang-format on
 
     po::options_description secret_options("Secret");
@@ -349,38 +169,8 @@ int main(int argc, char** argv) {
     debugflag = opts.count("debug");
     traceflag = opts.count("trace");
 
-    // thread count: CLI option overrides WS_THREADS env variable, which overrides default
-    if (thread_count == 0) {
-        const char* env_threads = std::getenv("WS_THREADS");
-        if (env_threads != nullptr && std::string(env_threads) != "") {
-            try {
-                thread_count = std::stoul(env_threads);
-                if (thread_count == 0)
-                    thread_count = 1;
-                if (debugflag) {
-                    spdlog::debug("Using WS_THREADS={} from environment", thread_count);
-                }
-            } catch (...) {
-                spdlog::warn("Invalid WS_THREADS value '{}', using default", env_threads);
-                thread_count = std::thread::hardware_concurrency();
-                if (thread_count == 0)
-                    thread_count = 1;
-            }
-        } else {
-            thread_count = std::thread::hardware_concurrency();
-            if (thread_count == 0)
-                thread_count = 1; // fallback if hardware_concurrency fails
-        }
-    }
-
     // handle options exiting here
 
-    // Initialize thread pool with custom thread count
-    if (debugflag) {
-        spdlog::debug("Creating thread pool with {} threads", thread_count);
-    }
-    BS::thread_pool global_pool(thread_count);
-
     if (opts.count("help")) {
         fmt::print(stderr, "Usage: {} [options] [pattern]\n", argv[0]);
         fmt::println(stderr, "{}", cmd_options);
@@ -404,14 +194,21 @@ int main(int argc, char** argv) {
         }
     }
 
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
+    // owners of group workspaces are checked against NSS, cache that
+    user::NSSCache::instance().configure(config.nsscachettl(), config.nssenumeratethreshold());
+
     // check if user is in debugusers list
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -419,10 +216,13 @@ int main(int argc, char** argv) {
         }
     }
 
+    // threads for reading DB entries: option, WS_THREADS or config
+    Executor::instance().start(Executor::threadCount(thread_count, config.threads()));
+
     // root and admins can choose usernames
-    string username = user::getUsername(); // used for rights checks
-    string userpattern;                    // used for pattern matching in DB
-    if (user::isRoot() || config.isAdmin(user::getUsername())) {
+    const string& username = identity.username; // used for rights checks
+    string userpattern;                          // used for pattern matching in DB
+    if (identity.root || identity.admin) {
         if (user != "") {
             userpattern = user;
         } else {
@@ -433,7 +233,7 @@ int main(int argc, char** argv) {
     }
 
     // list of groups of this process
-    auto grouplist = user::getGrouplist();
+    const auto& grouplist = identity.groups;
 
     // list of fileystems or list of workspaces
     if (listfilesystems) { // -l
@@ -448,7 +248,7 @@ int main(int argc, char** argv) {
         fmt::println("{:>10}{:>12}{:>12}{:>10}{:>17}{:>12}{:>12}{:>12}{:>10}", "name", "maxduration", "extensions",
                      "keeptime", "releasekeeptime", "allocatable", "extendable", "restorable", "comment");
         for (auto fs : config.validFilesystems(username, grouplist, ws::LIST)) {
-            auto fsc = config.getFsConfig(fs);
+            const auto& fsc = config.getFsConfig(fs);
             bool allocateable = config.hasAccess(username, grouplist, fs, ws::CREATE) && fsc.allocatable;
             bool extendable = config.hasAccess(username, grouplist, fs, ws::EXTEND) && fsc.extendable;
             bool restorable = config.hasAccess(username, grouplist, fs, ws::RESTORE) && fsc.restorable;
@@ -505,40 +305,37 @@ int main(int argc, char** argv) {
                 auto db = std::unique_ptr<Database>(config.openDB(fs));
                 auto matchlist = db->matchPattern(pattern, userpattern, grouplist, listexpired, listgroups);
 
-                // Use bshoshany's parallel loop for database processing
-                global_pool
-                    .submit_loop(0, matchlist.size(),
-                                 [db = db.get(), config, &matchlist, &entrylist, &mtx, listexpired, sort, shortlisting,
-                                  tableformat, permissions, terselisting, verbose](size_t i) {
-                                     try {
-                                         auto entry = db->readEntry(matchlist[i], listexpired);
-                                         // if entry is valid
-                                         if (entry) {
-                                             if (sort) {
-                                                 lock_guard<mutex> lock(mtx);
-                                                 // Store for sorting
-                                                 entrylist.push_back(std::move(entry));
-                                             } else {
-                                                 // Don't hold mtx - let print functions manage their own locks
-                                                 if (shortlisting) {
-                                                     lock_guard<mutex> out_lock(print_entry_mtx);
-                                                     fmt::println("{}", getMaskedID(entry.get()));
-                                                 } else {
-                                                     if (!tableformat)
-                                                         print_entry(entry.get(), config, verbose, terselisting,
-                                                                     permissions, listexpired);
-                                                     else
-                                                         print_entry_tableformat(entry.get(), config, verbose,
-                                                                                 terselisting, permissions,
-                                                                                 listexpired);
-                                                 }
-                                             }
-                                         }
-                                     } catch (DatabaseException& e) {
-                                         spdlog::error(e.what());
-                                     }
-                                 })
-                    .wait();
+                // read and print entries in parallel
+                Executor::instance().parallel_for(
+                    0, matchlist.size(),
+                    [db = db.get(), &config, &identity, &matchlist, &entrylist, &mtx, listexpired, sort, shortlisting,
+                     tableformat, permissions, terselisting, verbose](size_t i) {
+                        try {
+                            auto entry = db->readEntry(matchlist[i], listexpired);
+                            // if entry is valid
+                            if (entry) {
+                                if (sort) {
+                                    lock_guard<mutex> lock(mtx);
+                                    // Store for sorting
+                                    entrylist.push_back(std::move(entry));
+                                } else {
+                                    // Don't hold mtx - let print functions manage their own locks
+                                    if (shortlisting) {
+                                        print_entry_short(entry.get(), identity);
+                                    } else {
+                                        if (!tableformat)
+                                            print_entry(entry.get(), config, identity, verbose, terselisting,
+                                                        permissions, listexpired);
+                                        else
+                                            print_entry_tableformat(entry.get(), config, identity, verbose,
+                                                                    terselisting, permissions, listexpired);
+                                    }
+                                }
+                            }
+                        } catch (DatabaseException& e) {
+                            spdlog::error(e.what());
+                        }
+                    });
 
                 // Keep the database alive until all entries are processed
                 dblist.push_back(std::move(db));
@@ -569,12 +366,13 @@ int main(int argc, char** argv) {
 
             for (const auto& entry : entrylist) {
                 if (shortlisting) {
-                    fmt::println("{}", getMaskedID(entry.get()));
+                    print_entry_short(entry.get(), identity);
                 } else {
                     if (!tableformat)
-                        print_entry(entry.get(), config, verbose, terselisting, permissions, listexpired);
+                        print_entry(entry.get(), config, identity, verbose, terselisting, permissions, listexpired);
                     else
-                        print_entry_tableformat(entry.get(), config, verbose, terselisting, permissions, listexpired);
+                        print_entry_tableformat(entry.get(), config, identity, verbose, terselisting, permissions,
+                                                listexpired);
                 }
             }
         }
@@ -139,14 +139,18 @@ int main(int argc, char** argv) {
         }
     }
 
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
     // check if user is in debugusers list
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -161,8 +165,8 @@ int main(int argc, char** argv) {
     }
 
     // get user and groups
-    string username = user::getUsername(); // used for rights checks
-    auto grouplist = user::getGrouplist();
+    const string& username = identity.username; // used for rights checks
+    const auto& grouplist = identity.groups;
 
     for (auto const& fs : config.validFilesystems(username, grouplist, ws::LIST)) {
         std::vector<string> keeplist, createlist;
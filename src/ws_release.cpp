@@ -156,12 +156,13 @@ void commandline(po::variables_map& opt, string& name, string& filesystem, strin
  *
  *  return true if ok and false if not
  */
-bool validateFs(const Config& config, const po::variables_map& opt, const std::string username) {
+bool validateFs(const Config& config, const po::variables_map& opt, const user::Identity& identity,
+                const std::string& username) {
     if (traceflag)
         spdlog::trace("validateFsAndGroup(username={})", username);
 
     // auto groupnames=getgroupnames(username); // FIXME:  use getGrouplist ?
-    auto groupnames = user::getGrouplist();
+    const auto& groupnames = identity.groups;
 
     // if the user specifies a filesystem, he must be allowed to use it
     if (opt.count("filesystem")) {
@@ -179,15 +180,15 @@ bool validateFs(const Config& config, const po::variables_map& opt, const std::s
  *  release the workspace
  *  file accesses and config access are hidden in DB and config handling
  */
-bool release(const Config& config, const po::variables_map& opt, string filesystem, const string name,
-             string user_option, const bool deletedata) {
+bool release(const Config& config, const user::Identity& identity, const po::variables_map& opt, string filesystem,
+             const string& name, string user_option, const bool deletedata) {
     if (traceflag)
         spdlog::trace("release({}, {}, {}, {})", filesystem, name, user_option, deletedata);
 
-    std::string username = user::getUsername(); // current user
+    const std::string& username = identity.username; // current user
 
     // get valid filesystems to bail out if there is none
-    auto valid_filesystems = config.validFilesystems(user::getUsername(), user::getGrouplist(), ws::RELEASE);
+    auto valid_filesystems = config.validFilesystems(username, identity.groups, ws::RELEASE);
 
     if (valid_filesystems.size() == 0) {
         spdlog::error("no valid filesystems in configuration, can not release");
@@ -195,7 +196,7 @@ bool release(const Config& config, const po::variables_map& opt, string filesyst
     }
 
     // validate filesystem and group given on command line
-    if (!validateFs(config, opt, user_option)) {
+    if (!validateFs(config, opt, identity, user_option)) {
         spdlog::error("aborting, no valid filesystem given.");
         return false;
     }
@@ -206,9 +207,8 @@ bool release(const Config& config, const po::variables_map& opt, string filesyst
     if (opt.count("filesystem")) {
         searchlist.push_back(opt["filesystem"].as<string>());
     } else {
-        searchlist =
-            config.validFilesystems(user::getUsername(), user::getGrouplist(),
-                                    ws::RELEASE); // FIXME: getUsername or user_option? getGrouplist uses current uid
+        searchlist = config.validFilesystems(username, identity.groups,
+                                             ws::RELEASE); // FIXME: username or user_option? groups of current uid
     }
 
     //
@@ -300,30 +300,31 @@ bool release(const Config& config, const po::variables_map& opt, string filesyst
         // new name is still identical to DB, but does not collide
         string timestamp = fmt::format("{}", timestamp_time);
 
-        auto wsconfig = dbentry->getConfig()->getFsConfig(dbentry->getFilesystem());
+        const auto& wsconfig = dbentry->getConfig()->getFsConfig(dbentry->getFilesystem());
         cppfs::path target = cppfs::path(dbentry->getWSPath()).parent_path() / cppfs::path(wsconfig.deletedPath) /
                              cppfs::path(fmt::format("{}-{}", dbentry->getId(), timestamp));
 
-        caps.raise_cap({CAP_DAC_OVERRIDE}, utils::SrcPos(__FILE__, __LINE__, __func__));
-
         try {
+            CapScope scope(caps, {CAP_DAC_OVERRIDE}, dbentry->getConfig()->dbuid(),
+                           utils::SrcPos(__FILE__, __LINE__, __func__));
             if (debugflag)
                 spdlog::debug("rename({}, {})", dbentry->getWSPath(), target.string());
             cppfs::rename(dbentry->getWSPath(), target);
         } catch (const std::filesystem::filesystem_error& e) {
             if (e.code() == std::errc::cross_device_link) {
                 spdlog::info("cross device rename, falling back to 'mv'");
-                int ret = utils::mv(dbentry->getWSPath().c_str(), target.c_str());
-                caps.lower_cap({CAP_DAC_OVERRIDE}, dbentry->getConfig()->dbuid(),
-                               utils::SrcPos(__FILE__, __LINE__, __func__));
+                int ret;
+                {
+                    CapScope scope(caps, {CAP_DAC_OVERRIDE}, dbentry->getConfig()->dbuid(),
+                                   utils::SrcPos(__FILE__, __LINE__, __func__));
+                    ret = utils::mv(dbentry->getWSPath().c_str(), target.c_str());
+                }
                 if (ret != 0) {
                     spdlog::error("workspace directory could not be moved to deleted path via 'mv': {}",
                                   strerror(errno));
                     return false;
                 }
             } else {
-                caps.lower_cap({CAP_DAC_OVERRIDE}, dbentry->getConfig()->dbuid(),
-                               utils::SrcPos(__FILE__, __LINE__, __func__));
                 if (debugflag)
                     spdlog::error("{}", e.what());
                 spdlog::error("workspace directory could not be moved to deleted path!");
@@ -331,9 +332,7 @@ bool release(const Config& config, const po::variables_map& opt, string filesyst
             }
         }
 
-        caps.lower_cap({CAP_DAC_OVERRIDE}, dbentry->getConfig()->dbuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
-
-        syslog(LOG_INFO, "release for user <%s> from <%s> to <%s> done.", user::getUsername().c_str(),
+        syslog(LOG_INFO, "release for user <%s> from <%s> to <%s> done.", username.c_str(),
                dbentry->getWSPath().c_str(), target.c_str());
 
         spdlog::info("workspace {} released.", name);
@@ -352,39 +351,24 @@ bool release(const Config& config, const po::variables_map& opt, string filesyst
             spdlog::info("you have 5 seconds to interrupt with CTRL-C to prevent deletion");
             sleep(5);
 
-            caps.raise_cap({CAP_FOWNER}, utils::SrcPos(__FILE__, __LINE__, __func__));
-            if (caps.isSetuid()) {
-                // get process owner to be allowed to delete files
-                if (seteuid(getuid())) {
-                    spdlog::error("can not setuid, bad installation?");
-                }
-            }
-
-            // remove the directory
-            std::error_code ec;
-            if (debugflag) {
-                spdlog::debug("rmtree({})", target.string());
-            }
-            utils::rmtree(target); // #66
+            // remove DB entry first, so the directory can not be restored any more
+            dbentry->remove();
 
-            if (caps.isSetuid()) {
-                // get root so we can drop again
-                if (seteuid(0)) {
-                    spdlog::error("can not setuid, bad installation?");
-                }
+            // deleting can take long, ws_expirer deletes directories queued here in parallel
+            bool queued;
+            {
+                CapScope scope(caps, {CAP_DAC_OVERRIDE}, dbentry->getConfig()->dbuid(),
+                               utils::SrcPos(__FILE__, __LINE__, __func__));
+                queued = utils::requestPurge(target.string());
             }
 
-            caps.lower_cap({CAP_FOWNER}, dbentry->getConfig()->dbuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
-
-            // call again with different user
-            utils::rmtree(target); // #66
+            syslog(LOG_INFO, "delete-data for user <%s> from <%s> queued.", username.c_str(), target.c_str());
 
-            syslog(LOG_INFO, "delete-data for user <%s> from <%s>.", user::getUsername().c_str(), target.c_str());
-
-            // remove DB entry
-            dbentry->remove();
-
-            spdlog::info("workspace {} and data deleted, can not be restored.", name);
+            if (queued) {
+                spdlog::info("workspace {} queued for deletion, can not be restored.", name);
+            } else {
+                spdlog::info("workspace {} can not be restored, data will be deleted with next expirer run.", name);
+            }
 
         } // if delete-data
 
@@ -433,14 +417,18 @@ int main(int argc, char** argv) {
     }
 
     // read the config
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
     // check if user is in debugusers list
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -451,7 +439,7 @@ int main(int argc, char** argv) {
     openlog("ws_release", 0, LOG_USER); // SYSLOG
 
     // release workspace
-    if (!release(config, opt, filesystem, name, user_option, deletedata)) {
+    if (!release(config, identity, opt, filesystem, name, user_option, deletedata)) {
         return -1;
     }
 }
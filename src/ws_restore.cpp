@@ -182,7 +182,7 @@ void commandline(po::variables_map& opt, string& name, string& target, string& f
 /*
  * check that either username matches the name of the workspace, or we are root
  */
-bool check_name(const string name, const string real_username) {
+bool check_name(const string& name, const string& real_username) {
     // as username and id can contain -, splitting is not good here
     //  name has shape:    username-id-timestamp
     //                             ^ search for this
@@ -195,10 +195,10 @@ bool check_name(const string name, const string real_username) {
     }
 }
 
-void restore(const string name, const string target, const string username, const Config& config,
-             const string filesystem, const bool deletedata) {
+void restore(const string& name, const string& target, const string& username, const Config& config,
+             const user::Identity& identity, const string& filesystem, const bool deletedata) {
     // list of groups of this process
-    auto grouplist = user::getGrouplist();
+    const auto& grouplist = identity.groups;
 
     // split the name in username, name and timestamp
     auto pos = name.find("-");
@@ -220,28 +220,29 @@ void restore(const string name, const string target, const string username, cons
 
     vector<pair<string, string>> hits;
 
-    // FIXME dbuid would be sufficient
-    caps.raise_cap({CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, utils::SrcPos(__FILE__, __LINE__, __func__));
+    {
+        // FIXME dbuid would be sufficient
+        CapScope scope(caps, {CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, config.dbuid(),
+                       utils::SrcPos(__FILE__, __LINE__, __func__));
 
-    // iterate over filesystems
-    for (auto const& fs : fslist) {
-        if (debugflag)
-            spdlog::debug("loop over fslist {} in {}", fs, fslist);
+        // iterate over filesystems
+        for (auto const& fs : fslist) {
+            if (debugflag)
+                spdlog::debug("loop over fslist {} in {}", fs, fslist);
 
-        std::unique_ptr<Database> db;
-        try {
-            db = std::unique_ptr<Database>(config.openDB(fs));
-        } catch (DatabaseException& e) {
-            spdlog::error(e.what());
-            continue;
-        }
+            std::unique_ptr<Database> db;
+            try {
+                db = std::unique_ptr<Database>(config.openDB(fs));
+            } catch (DatabaseException& e) {
+                spdlog::error(e.what());
+                continue;
+            }
 
-        for (auto const& id : db->matchPattern(id_noowner, username, grouplist, true, false)) {
-            hits.push_back({fs, id});
+            for (auto const& id : db->matchPattern(id_noowner, username, grouplist, true, false)) {
+                hits.push_back({fs, id});
+            }
         }
     }
-    caps.lower_cap({CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, config.dbuid(),
-                   utils::SrcPos(__FILE__, __LINE__, __func__));
 
     // exit in case not unique (unlikely due to labels with seconds precision!)
     if (hits.size() > 1) {
@@ -294,38 +295,6 @@ void restore(const string name, const string target, const string username, cons
         spdlog::info("you have 5 seconds to interrupt with CTRL-C to prevent deletion");
         sleep(5);
 
-        caps.raise_cap({CAP_FOWNER}, utils::SrcPos(__FILE__, __LINE__, __func__));
-        if (caps.isSetuid()) {
-            // get process owner to be allowed to delete files
-            if (seteuid(getuid())) {
-                spdlog::error("can not setuid, bad installation?");
-            }
-        }
-
-        // remove the directory
-        std::error_code ec;
-        if (debugflag) {
-            spdlog::debug("remove_all({})", cppfs::path(wssourcename).string());
-        }
-
-        utils::rmtree(wssourcename);
-
-        /*
-        cppfs::remove_all(cppfs::path(wssourcename), ec); // we ignore return wert as we expect an error return anyhow
-
-        if (ec.value() != 0) {
-            spdlog::error("unexpected error {}", ec.message());
-        }
-        */
-
-        if (caps.isSetuid()) {
-            // get root so we can drop again
-            if (seteuid(0)) {
-                spdlog::error("can not setuid, bad installation?");
-            }
-        }
-        caps.lower_cap({CAP_FOWNER}, source_entry->getConfig()->dbuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
-
         // FIXME: move this to deleteEntry?
         if (caps.isSetuid()) {
             // get db user to be able to unlink db entry from root_squash filesystems
@@ -335,14 +304,27 @@ void restore(const string name, const string target, const string username, cons
             }
         }
 
-        // remove DB entry
+        // remove DB entry first, so the directory can not be restored any more
         try {
             source_db->deleteEntry(name, true);
-            syslog(LOG_INFO, "delete for user <%s> from <%s> done, removed DB entry <%s>.", username.c_str(),
-                   wssourcename.c_str(), name.c_str());
-            spdlog::info("delete successful, database entry removed.");
         } catch (DatabaseException const& ex) {
             spdlog::error("error in DB entry removal, {}", ex.what());
+            return;
+        }
+
+        // deleting can take long, ws_expirer deletes directories queued here in parallel
+        bool queued;
+        {
+            CapScope scope(caps, {CAP_DAC_OVERRIDE}, config.dbuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+            queued = utils::requestPurge(wssourcename);
+        }
+
+        syslog(LOG_INFO, "delete for user <%s> from <%s> queued, removed DB entry <%s>.", username.c_str(),
+               wssourcename.c_str(), name.c_str());
+        if (queued) {
+            spdlog::info("database entry removed, data queued for deletion.");
+        } else {
+            spdlog::info("database entry removed, data will be deleted with next expirer run.");
         }
     } else { // don't delete data
 
@@ -388,7 +370,9 @@ void restore(const string name, const string target, const string username, cons
 
         string targetpathname = targetpath + "/" + cppfs::path(wssourcename).filename().string();
 
-        caps.raise_cap({CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, utils::SrcPos(__FILE__, __LINE__, __func__));
+        // privileges for move and DB update, lowered at end of this block
+        CapScope scope(caps, {CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, config.dbuid(),
+                       utils::SrcPos(__FILE__, __LINE__, __func__));
 
         // do the move
         int ret = rename(wssourcename.c_str(), targetpathname.c_str());
@@ -435,8 +419,6 @@ void restore(const string name, const string target, const string username, cons
                 exit(-1);
             }
         }
-        caps.lower_cap({CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, config.dbuid(),
-                       utils::SrcPos(__FILE__, __LINE__, __func__));
     }
 }
 
@@ -472,14 +454,18 @@ int main(int argc, char** argv) {
     }
 
     // read the config
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
     // check if user is in debugusers list
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -488,7 +474,7 @@ int main(int argc, char** argv) {
     }
 
     // read user config
-    string user_conf_filename = user::getUserhome() + "/.ws_user.conf";
+    string user_conf_filename = identity.home + "/.ws_user.conf";
     if (!cppfs::is_symlink(user_conf_filename)) {
         if (cppfs::is_regular_file(user_conf_filename)) {
             user_conf = utils::getFileContents(user_conf_filename.c_str());
@@ -501,21 +487,21 @@ int main(int argc, char** argv) {
 
     // root and admins can choose usernames
     string userpattern; // used for pattern matching in DB
-    if (user::isRoot() || config.isAdmin(user::getUsername())) {
+    if (identity.root || identity.admin) {
         if (username != "") {
             userpattern = username;
         } else {
             userpattern = "*";
         }
     } else {
-        userpattern = user::getUsername();
+        userpattern = identity.username;
     }
 
     openlog("ws_restore", 0, LOG_USER); // SYSLOG
 
     if (listflag) {
         // list of groups of this process
-        auto grouplist = user::getGrouplist();
+        const auto& grouplist = identity.groups;
 
         // where to list from?
         vector<string> fslist;
@@ -530,9 +516,10 @@ int main(int argc, char** argv) {
             fslist = validfs;
         }
 
-        // FIXME here db user would be sufficient, raise_cap could offer a setuid interface
+        // FIXME here db user would be sufficient, CapScope could offer a setuid interface
         // that does not require root here
-        caps.raise_cap({CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, utils::SrcPos(__FILE__, __LINE__, __func__));
+        CapScope scope(caps, {CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, config.dbuid(),
+                       utils::SrcPos(__FILE__, __LINE__, __func__));
 
         // if not pattern, show all entries
         if (name == "")
@@ -574,12 +561,10 @@ int main(int argc, char** argv) {
                 spdlog::error("DB access error ({})", e.what());
             }
         } // loop over fs
-        caps.lower_cap({CAP_DAC_OVERRIDE, CAP_DAC_READ_SEARCH}, config.dbuid(),
-                       utils::SrcPos(__FILE__, __LINE__, __func__));
     } else { // no listflag
 
         // construct db-entry username  name
-        string real_username = user::getUsername();
+        const string& real_username = identity.username;
         if (username == "") {
             username = real_username;
         } else if (real_username != username) {
@@ -592,12 +577,12 @@ int main(int argc, char** argv) {
         if (check_name(name, real_username)) {
             if (cppfs::path(argv[0]).filename() == "ws_restore") {
                 if (utils::new_ruh()) {
-                    restore(name, target, username, config, filesystem, opt.count("delete-data"));
+                    restore(name, target, username, config, identity, filesystem, opt.count("delete-data"));
                 } else {
                     syslog(LOG_INFO, "user <%s> failed ruh test.", username.c_str());
                 }
             } else { // hack to allow test, human test can be skipped if executable has non-standard name
-                restore(name, target, username, config, filesystem, opt.count("delete-data"));
+                restore(name, target, username, config, identity, filesystem, opt.count("delete-data"));
             }
         }
     }
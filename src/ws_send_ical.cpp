@@ -44,6 +44,7 @@
 #include "caps.h"
 #include "config.h"
 #include "mail.h"
+#include "nsscache.h"
 #include "user.h"
 #include "utils.h"
 #include "ws.h"
@@ -168,97 +169,15 @@ void commandline(po::variables_map& opt, string& filesystem, string& mailaddress
     }
 }
 
-// Generate the Date Format used for ics attachments from time_t
-std::string generateICSDateFormat(const time_t time) {
-    char timeString[std::size("yyyymmddThhmmssZ")];
-    struct tm tm_buf;
-    localtime_r(&time, &tm_buf);
-    std::strftime(std::data(timeString), std::size(timeString), "%Y%m%dT%H%M00Z", &tm_buf);
-    std::string s(timeString);
-    return s;
-}
-
-// Encode ics input for Base64
-std::string base64Encode(const std::string& input) {
-    const std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    std::string result;
-    unsigned int val = 0;
-    int valb = -6;
-    for (unsigned char c : input) {
-        val = (val << 8) + c;
-        valb += 8;
-        while (valb >= 0) {
-            result.push_back(chars[(val >> valb) & 0x3F]);
-            valb -= 6;
-        }
-    }
-    if (valb > -6)
-        result.push_back(chars[((val << 8) >> (valb + 8)) & 0x3F]);
-    while (result.size() % 4)
-        result.push_back('=');
-    return result;
-}
-
 // Generate the ICS File
-std::string generateICS(const std::unique_ptr<DBEntry>& entry, const std::string clustername, time_t createtime) {
-    std::string wsname = entry->getId();
-    time_t expirationtime = entry->getExpiration();
-    std::string resource = entry->getFilesystem();
-    time_t starttime = expirationtime - 7200;
-
-    std::string starttimestr = generateICSDateFormat(starttime);
-    std::string expirationtimestr = generateICSDateFormat(expirationtime);
-    std::string createtimestr = generateICSDateFormat(createtime);
-
-    std::size_t entryhash = std::hash<std::string>{}(entry->getId());
-
-    std::stringstream ics;
-
-    // HEADER
-    ics << "BEGIN:VCALENDAR" << CRLF;
-    ics << "VERSION:2.0" << CRLF;
-    ics << "PRODID:-//HLRS Cluster Team//Workspace V2.1//EN" << CRLF; // ???
-    ics << "METHOD:REQUEST" << CRLF;
-    ics << "BEGIN:VTIMEZONE" << CRLF;
-    ics << "TZID:Europe/Berlin" << CRLF;
-    ics << "BEGIN:DAYLIGHT" << CRLF;
-    ics << "TZOFFSETFROM:+0100" << CRLF;
-    ics << "TZOFFSETTO:+0200" << CRLF;
-    ics << "TZNAME:CEST" << CRLF;
-    ics << "DTSTART:19700329T020000" << CRLF;
-    ics << "RRULE:FREQ=YEARLY;BYDAY=-1SU;BYMONTH=3" << CRLF;
-    ics << "END:DAYLIGHT" << CRLF;
-    ics << "BEGIN:STANDARD" << CRLF;
-    ics << "TZOFFSETFROM:+0200" << CRLF;
-    ics << "TZOFFSETTO:+0100" << CRLF;
-    ics << "TZNAME:CET" << CRLF;
-    ics << "DTSTART:19701025T030000" << CRLF;
-    ics << "RRULE:FREQ=YEARLY;BYDAY=-1SU;BYMONTH=10" << CRLF;
-    ics << "END:STANDARD" << CRLF;
-    ics << "END:VTIMEZONE" << CRLF;
-
-    // EVENT
-    ics << "BEGIN:VEVENT\r\n";
-    ics << "CREATED:" << createtimestr << CRLF;
-    ics << "DTSTAMP:" << createtimestr << CRLF;
-    ics << "UID:587a1aa6-" << entryhash << CRLF;
-    ics << "DESCRIPTION:Workspace " << wsname << " will be deleted on host " << clustername << CRLF;
-    ics << "LOCATION:" << clustername << ":" << resource << CRLF;
-    ics << "SUMMARY:Workspace " << wsname << " expires" << CRLF;
-    ics << "DTSTART;TZID=Europe/Berlin:" << starttimestr << CRLF;
-    ics << "DTEND;TZID=Europe/Berlin:" << expirationtimestr << CRLF;
-    ics << "LAST_MODIFIED:" << createtimestr << CRLF;
-    ics << "CLASS:PRIVATE" << CRLF;
-    ics << "END:VEVENT" << CRLF;
-
-    ics << "END:VCALENDAR" << CRLF;
-
-    return ics.str();
+std::string generateICS(const std::unique_ptr<DBEntry>& entry, const std::string& clustername, time_t createtime) {
+    return mail::generateICS({{entry->getId(), entry->getFilesystem(), entry->getExpiration()}}, clustername,
+                             createtime);
 }
 
 // Generate the Mail
-std::string generateMail(const std::unique_ptr<DBEntry>& entry, std::string ics, const std::string mail_from,
-                         std::vector<std::string> mail_to, const std::string clustername, time_t now) {
+std::string generateMail(const std::unique_ptr<DBEntry>& entry, const std::string& ics, const std::string& mail_from,
+                         const std::vector<std::string>& mail_to, const std::string& clustername, time_t now) {
     std::string wsname = entry->getId();
     std::string resource = entry->getFilesystem();
 
@@ -269,7 +188,7 @@ std::string generateMail(const std::unique_ptr<DBEntry>& entry, std::string ics,
 
     std::string messageID = mail::generateMessageID("ws_send_ical");
     std::string boundary = "_NextPart_01234567.89ABCDEF";
-    std::string encodedICS = base64Encode(ics);
+    std::string encodedICS = mail::base64Encode(ics);
 
     mail << "From: " << mail_from << CRLF;
     mail << "To: " << to_header << CRLF;
@@ -353,14 +272,21 @@ int main(int argc, char** argv) {
         }
     }
 
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
+    // owners of group workspaces are checked against NSS, cache that
+    user::NSSCache::instance().configure(config.nsscachettl(), config.nssenumeratethreshold());
+
     // check if user is in debugusers list
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -370,17 +296,17 @@ int main(int argc, char** argv) {
 
     // root and admins can choose usernames
     string userpattern; // used for pattern matching in DB
-    if (user::isRoot() || config.isAdmin(user::getUsername())) {
+    if (identity.root || identity.admin) {
         if (username != "") {
             userpattern = username;
         } else {
             userpattern = "*";
         }
     } else {
-        userpattern = user::getUsername();
+        userpattern = identity.username;
     }
 
-    auto grouplist = user::getGrouplist();
+    const auto& grouplist = identity.groups;
     bool listgroups = false; // don't allow notifications for Group Workspaces yet
 
     // Only search in valid Filesystems
@@ -439,13 +365,13 @@ int main(int argc, char** argv) {
                      name);
         exit(1);
     } else {
-        std::string mail_from = config.mailfrom();
+        const std::string& mail_from = config.mailfrom();
         if (mail_from == "") {
             spdlog::warn("no mail_from in global config, please inform system administrator!");
             exit(-2);
         }
         std::string smtpUrl = "smtp://" + config.smtphost();
-        std::string clustername = config.clustername();
+        const std::string& clustername = config.clustername();
         std::vector<std::string> mail_to;
         mail_to.push_back(mailaddress);
 
@@ -463,7 +389,8 @@ int main(int argc, char** argv) {
             spdlog::debug("Generated email content:");
             spdlog::debug("{}", completeMail);
         }
-        if (mail::sendCurl(smtpUrl, mail_from, mail_to, completeMail)) {
+        mail::Session mailsession(smtpUrl);
+        if (mailsession.send(mail_from, mail_to, completeMail)) {
             spdlog::info("Success: Calendar invitation sent to {}", mailaddress);
         } else {
             spdlog::error("Failed to send calendar invitation to {}", mailaddress);
@@ -3,7 +3,7 @@
  *
  *  ws_stat
  *
- *  - tool to get statistics about workspaces (bshoshany/thread-pool version)
+ *  - tool to get statistics about workspaces
  *  - within a workspace directory, parallel processing with a lock free work stealing queue
  *
  *  relies on statx(), not available in RH7 and older.
@@ -33,32 +33,25 @@
 
 #include <atomic>
 #include <chrono>
-#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <filesystem>
 #include <memory>
-#include <optional>
-#include <thread>
 #include <utility>
 #include <vector>
 
-// Include bshoshany thread-pool
-#define BS_THREAD_POOL_NATIVE_EXTENSIONS
-#include "BS_thread_pool.hpp"
-
-// Include work-stealing queue for paths
-#include "PathWorkStealingQueue.hpp"
-
 #include "config.h"
 #include <boost/program_options.hpp>
 
 #include "build_info.h"
 #include "db.h"
+#include "executor.h"
 #include "fmt/format.h"  // IWYU pragma: keep
 #include "fmt/ostream.h" // IWYU pragma: keep
 #include "fmt/ranges.h"  // IWYU pragma: keep
 
+#include "nsscache.h"
+#include "ratelimit.h"
 #include "user.h"
 #include "utils.h"
 
@@ -125,8 +118,14 @@ std::pair<uint64_t, uint64_t> getfilesize(const cppfs::path& path) {
 std::mutex output_mutex;
 
 // Collect only files and subdirectories at current level (no recursion)
-void collect_level(const cppfs::path& path, StatResult& result, std::vector<cppfs::path>& subdirs) {
-    if (!cppfs::is_directory(path)) {
+// a concurrency slot of the limiter is held while reading the level
+void collect_level(const cppfs::path& path, StatResult& result, std::vector<cppfs::path>& subdirs,
+                   MetadataLimiter& limiter) {
+    MetadataLimiter::Slot slot(limiter);
+    limiter.acquire();
+
+    std::error_code ec;
+    if (!cppfs::is_directory(path, ec)) {
         return;
     }
 
@@ -138,6 +137,7 @@ void collect_level(const cppfs::path& path, StatResult& result, std::vector<cppf
                 result.directories++;
                 subdirs.push_back(entry.path());
             } else if (entry.is_regular_file()) {
+                limiter.acquire();
                 try {
                     auto [bytes, blocks] = getfilesize(entry.path());
                     result.files++;
@@ -153,144 +153,56 @@ void collect_level(const cppfs::path& path, StatResult& result, std::vector<cppf
     }
 }
 
-// Worker thread using per-queue work-stealing
-void worker_thread(size_t worker_id, std::vector<StatResult>& local_results,
-                   std::vector<PathWorkStealingQueue<cppfs::path>>& worker_queues, std::atomic<int64_t>& work_counter) {
-    StatResult& local = local_results[worker_id];
-
-    while (true) {
-        // Try to pop from own queue
-        std::optional<cppfs::path> work = worker_queues[worker_id].pop();
-
-        // If own queue empty, try to steal from others in batches (fair round-robin)
-        if (!work.has_value()) {
-            static thread_local std::vector<cppfs::path> stolen_batch;
-            if (stolen_batch.capacity() < 16) {
-                stolen_batch.reserve(16);
-            }
-
-            for (size_t i = 1; i < worker_queues.size(); i++) {
-                size_t victim = (worker_id + i) % worker_queues.size();
-                stolen_batch.clear();
-                if (worker_queues[victim].steal(stolen_batch, 16) > 0) {
-                    work = std::move(stolen_batch.back());
-                    stolen_batch.pop_back();
-
-                    // Push remaining stolen items to own queue for future pop() calls
-                    for (auto& p : stolen_batch) {
-                        worker_queues[worker_id].push(std::move(p));
-                    }
-                    break;
-                }
-            }
-        }
-
-        // Termination check: own queue empty, no work to steal, counter is 0
-        if (!work.has_value() && work_counter.load(std::memory_order_acquire) == 0) {
-            break;
-        }
+// totals of a workspace, added to by all directory tasks
+struct SharedStatResult {
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint64_t> softlinks{0};
+    std::atomic<uint64_t> directories{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> blocks{0};
 
-        if (!work.has_value()) {
-            std::this_thread::yield();
-            continue;
-        }
-
-        // Use RAII guard to ensure the work_counter is decremented even if an exception occurs
-        struct WorkGuard {
-            std::atomic<int64_t>& cnt;
-            explicit WorkGuard(std::atomic<int64_t>& c) : cnt(c) {}
-            ~WorkGuard() { cnt.fetch_sub(1, std::memory_order_acq_rel); }
-        } guard(work_counter);
+    void add(const StatResult& other) {
+        files += other.files;
+        softlinks += other.softlinks;
+        directories += other.directories;
+        bytes += other.bytes;
+        blocks += other.blocks;
+    }
+};
 
-        // Process this directory level
-        try {
-            if (cppfs::exists(*work) && cppfs::is_directory(*work)) {
-                for (const auto& entry : cppfs::directory_iterator(*work)) {
-                    if (entry.is_symlink()) {
-                        local.softlinks++;
-                    } else if (entry.is_directory()) {
-                        local.directories++;
-                        try {
-                            cppfs::path p = entry.path();
-                            work_counter.fetch_add(1, std::memory_order_acq_rel);
-                            worker_queues[worker_id].push(std::move(p));
-                        } catch (const std::exception& e) {
-                            spdlog::warn("Cannot process subdirectory in {}: {}", work->string(), e.what());
-                        }
-                    } else if (entry.is_regular_file()) {
-                        try {
-                            auto [bytes, blocks] = getfilesize(entry.path());
-                            local.files++;
-                            local.bytes += bytes;
-                            local.blocks += blocks;
-                        } catch (const std::exception& e) {
-                            spdlog::warn("Cannot stat file {}: {} - skipping", entry.path().string(), e.what());
-                        }
-                    }
-                }
-            }
-        } catch (const std::exception& e) {
-            spdlog::warn("Error reading directory {}: {} - skipping", work->string(), e.what());
-        }
+// one directory level, subdirectories become new tasks of the same group
+void stat_directory(Executor::TaskGroup& group, const cppfs::path& path, SharedStatResult& total,
+                    MetadataLimiter& limiter) {
+    StatResult local{};
+    std::vector<cppfs::path> subdirs;
+    collect_level(path, local, subdirs, limiter);
+    total.add(local);
+    for (auto& subdir : subdirs) {
+        group.run([&group, &total, &limiter, subdir = std::move(subdir)] {
+            stat_directory(group, subdir, total, limiter);
+        });
     }
 }
 
-// Work-stealing based directory traversal
-StatResult stat_workspace(const std::string& wspath, unsigned int override_workers = 0) {
+// directory traversal with tasks of the executor, can be called from within a task,
+// metadata operations are limited by the limiter of the filesystem
+StatResult stat_workspace(const std::string& wspath, MetadataLimiter& limiter) {
     if (!cppfs::is_directory(wspath)) {
         spdlog::error("workspace <{}> does not exist!", wspath);
         return StatResult{};
     }
 
-    StatResult result{};
-    std::vector<cppfs::path> subdirs;
-
-    try {
-        collect_level(wspath, result, subdirs);
-    } catch (const std::exception& e) {
-        spdlog::error("Cannot read workspace root {}: {}", wspath, e.what());
-        return result;
-    }
-
-    if (subdirs.empty()) {
-        return result;
-    }
-
-    size_t worker_count = (override_workers > 0) ? override_workers : thread_count;
-    if (debugflag) {
-        spdlog::debug("Using {} workers for directory traversal (thread_count={})", worker_count, thread_count);
-    }
-
-    // Create one queue per worker
-    std::vector<PathWorkStealingQueue<cppfs::path>> worker_queues(worker_count);
-
-    // Round-robin distribute initial work
-    for (size_t i = 0; i < subdirs.size(); i++) {
-        worker_queues[i % worker_count].push(std::move(subdirs[i]));
-    }
-
-    // Work counter for termination detection
-    std::atomic<int64_t> work_counter(static_cast<int64_t>(subdirs.size()));
-
-    std::vector<StatResult> local_results(worker_count);
-    std::vector<std::thread> workers;
-
-    // Spawn workers with their own queues
-    for (size_t i = 0; i < worker_count; i++) {
-        workers.emplace_back(worker_thread, i, std::ref(local_results), std::ref(worker_queues),
-                             std::ref(work_counter));
-    }
-
-    // Wait for all workers to complete
-    for (auto& w : workers) {
-        w.join();
-    }
-
-    // Aggregate results
-    for (const auto& lr : local_results) {
-        result += lr;
-    }
+    SharedStatResult total;
+    Executor::TaskGroup group;
+    stat_directory(group, wspath, total, limiter);
+    group.wait();
 
+    StatResult result{};
+    result.files = total.files;
+    result.softlinks = total.softlinks;
+    result.directories = total.directories;
+    result.bytes = total.bytes;
+    result.blocks = total.blocks;
     return result;
 }
 
@@ -338,7 +250,7 @@ int main(int argc, char** argv) {
         ("remaining,R", "sort by remaining time")
         ("reverted,r", "revert sort")
         ("verbose,v", "verbose listing")
-        ("threads,t", po::value<unsigned int>(&thread_count)->default_value(0), "threads for parallel operation (default: hardware_concurrency)");
+        ("threads,t", po::value<unsigned int>(&thread_count)->default_value(0), "threads for parallel operation (default: WS_THREADS env var, threads from config or hardware_concurrency)");
     // clang-format on
 
     po::options_description secret_options("Secret");
@@ -373,38 +285,6 @@ int main(int argc, char** argv) {
     debugflag = opts.count("debug");
     traceflag = opts.count("trace");
 
-    // thread count: CLI option overrides WS_THREADS env variable, which overrides default
-    if (thread_count == 0) {
-        const char* env_threads = std::getenv("WS_THREADS");
-        if (env_threads != nullptr && std::string(env_threads) != "") {
-            try {
-                thread_count = std::stoul(env_threads);
-                if (thread_count == 0)
-                    thread_count = 1;
-                if (debugflag) {
-                    spdlog::debug("Using WS_THREADS={} from environment", thread_count);
-                }
-            } catch (...) {
-                spdlog::warn("Invalid WS_THREADS value '{}', using default", env_threads);
-                thread_count = std::thread::hardware_concurrency();
-                if (thread_count == 0)
-                    thread_count = 1;
-            }
-        } else {
-            thread_count = std::thread::hardware_concurrency();
-            if (thread_count == 0)
-                thread_count = 1; // fallback if hardware_concurrency fails
-        }
-    }
-
-    // Apply minimum thread count for effective parallelism
-    if (thread_count < 4) {
-        if (debugflag) {
-            spdlog::debug("thread count {} too low, increasing to 4", thread_count);
-        }
-        thread_count = 4;
-    }
-
     // handle options exiting here
 
     if (opts.count("help")) {
@@ -430,14 +310,21 @@ int main(int argc, char** argv) {
         }
     }
 
-    auto config = Config(configfilestoread);
+    // compiled config cache is only used for the default config files
+    auto config = configfile == "" ? Config(configfilestoread, ws::configcachefile) : Config(configfilestoread);
     if (!config.isValid()) {
         spdlog::error("No valid config file found!");
         exit(-2);
     }
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
+    // owners of group workspaces are checked against NSS, cache that
+    user::NSSCache::instance().configure(config.nsscachettl(), config.nssenumeratethreshold());
+
     // check if user is in debugusers list
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -445,10 +332,14 @@ int main(int argc, char** argv) {
         }
     }
 
+    // directory traversal is bound by metadata latency, not by cores, so use at least 4 threads
+    Executor::instance().start(Executor::threadCount(thread_count, config.threads(), 4));
+    MetadataLimiter::configure(config);
+
     // root and admins can choose usernames
-    string username = user::getUsername(); // used for rights checks
-    string userpattern;                    // used for pattern matching in DB
-    if (user::isRoot() || config.isAdmin(user::getUsername())) {
+    const string& username = identity.username; // used for rights checks
+    string userpattern;                          // used for pattern matching in DB
+    if (identity.root || identity.admin) {
         if (user != "") {
             userpattern = user;
         } else {
@@ -459,7 +350,7 @@ int main(int argc, char** argv) {
     }
 
     // list of groups of this process
-    auto grouplist = user::getGrouplist();
+    const auto& grouplist = identity.groups;
 
     // if not pattern, show all entries
     if (pattern == "")
@@ -538,59 +429,44 @@ int main(int argc, char** argv) {
         spdlog::warn("Failed to set locale to en_US.UTF-8, falling back to default locale");
     }
 
-    // Calculate sqrt for nested parallelism: sqrt(thread_count) per level
-    // This ensures total threads ~= thread_count when processing multiple workspaces
-    unsigned int n = static_cast<unsigned int>(std::sqrt(thread_count));
-    if (n < 2)
-        n = 2; // minimum for effective parallelism
-    if (n > thread_count)
-        n = thread_count;
-
-    // Create thread pool for workspace-level parallelism
-    BS::thread_pool workspace_pool(n);
-    if (debugflag) {
-        spdlog::debug("Creating workspace_pool with {} threads (sqrt of total {})", n, thread_count);
-    }
-
     // Process workspaces
     if (!sort && entrylist.size() > 1) {
         if (debugflag) {
             spdlog::debug("Parallel workspace processing with {} workspaces", entrylist.size());
         }
-        workspace_pool
-            .submit_loop(0, entrylist.size(),
-                         [&entrylist, &username, n](size_t i) {
-                             auto begin = std::chrono::steady_clock::now();
-                             auto result = stat_workspace(entrylist[i]->getWSPath(), n);
-                             auto end = std::chrono::steady_clock::now();
-                             auto secs = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
-
-                             // Use mutex to prevent interleaved output from parallel threads
-                             std::lock_guard<std::mutex> lock(output_mutex);
-                             syslog(LOG_INFO, "stat for user <%s> for workspace <%s> (%ld msec, %ld files)",
-                                    username.c_str(), entrylist[i]->getId().c_str(), secs, result.files);
-                             fmt::println("Id: {}", entrylist[i]->getId());
-                             fmt::println("    workspace directory : {} ", entrylist[i]->getWSPath());
-                             fmt::println("    files               : {}\n"
-                                          "    softlinks           : {}\n"
-                                          "    directories         : {}\n"
-                                          "    bytes               : {:L} ({})\n"
-                                          "    blocks              : {:L}",
-                                          result.files, result.softlinks, result.directories, result.bytes,
-                                          utils::prettyBytes(result.bytes), result.blocks);
-                             if (verbose) {
-                                 fmt::println("\n    time[msec]          : {}", secs);
-                                 if (secs > 0) {
-                                     fmt::println("    KFiles/sec          : {}", (double)result.files / secs);
-                                 }
-                             }
-                         })
-            .wait();
+        // workspaces and their directories share the threads of the executor
+        Executor::instance().parallel_for(0, entrylist.size(), [&entrylist, &username](size_t i) {
+            auto begin = std::chrono::steady_clock::now();
+            auto result = stat_workspace(entrylist[i]->getWSPath(),
+                                         MetadataLimiter::forFilesystem(entrylist[i]->getFilesystem()));
+            auto end = std::chrono::steady_clock::now();
+            auto secs = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+
+            // Use mutex to prevent interleaved output from parallel threads
+            std::lock_guard<std::mutex> lock(output_mutex);
+            syslog(LOG_INFO, "stat for user <%s> for workspace <%s> (%ld msec, %ld files)", username.c_str(),
+                   entrylist[i]->getId().c_str(), secs, result.files);
+            fmt::println("Id: {}", entrylist[i]->getId());
+            fmt::println("    workspace directory : {} ", entrylist[i]->getWSPath());
+            fmt::println("    files               : {}\n"
+                         "    softlinks           : {}\n"
+                         "    directories         : {}\n"
+                         "    bytes               : {:L} ({})\n"
+                         "    blocks              : {:L}",
+                         result.files, result.softlinks, result.directories, result.bytes,
+                         utils::prettyBytes(result.bytes), result.blocks);
+            if (verbose) {
+                fmt::println("\n    time[msec]          : {}", secs);
+                if (secs > 0) {
+                    fmt::println("    KFiles/sec          : {}", (double)result.files / secs);
+                }
+            }
+        });
     } else {
         // Serial processing when sorted or for small lists
         for (auto& entry : entrylist) {
             auto begin = std::chrono::steady_clock::now();
-            auto result = stat_workspace(entry->getWSPath(), thread_count);
+            auto result = stat_workspace(entry->getWSPath(), MetadataLimiter::forFilesystem(entry->getFilesystem()));
             auto end = std::chrono::steady_clock::now();
             auto secs = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
 
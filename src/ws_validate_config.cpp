@@ -131,8 +131,11 @@ int main(int argc, char** argv) {
 
     spdlog::info("validating config from {}", configfile);
 
+    // user and groups of caller, resolved once
+    const auto identity = user::getIdentity(config.admins());
+
     // check if user is in debugusers list, disable debug/trace mode if not
-    if (!config.isDebugUser(user::getUsername())) {
+    if (!config.isDebugUser(identity.username)) {
         if (debugflag || traceflag) {
             spdlog::warn("debug mode disabled, not in debugusers list");
             debugflag = false;
@@ -234,7 +237,7 @@ int main(int argc, char** argv) {
     }
 
     for (auto name : wsnames) {
-        auto ws = config.getFsConfig(name);
+        const auto& ws = config.getFsConfig(name);
 
         std::string wsname = ws.name;
         if (wsname != "") {
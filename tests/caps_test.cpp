@@ -1,6 +1,9 @@
 #define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
 #include <catch2/catch_test_macros.hpp>
 
+#include <stdexcept>
+#include <thread>
+
 #include "../src/caps.h"
 
 #ifdef WS_CAPA
@@ -26,3 +29,94 @@ TEST_CASE("Caps", "[capabilities]") {
                        utils::SrcPos(__FILE__, __LINE__, __func__));
     }
 }
+
+// returns early from inside a scope
+static int earlyReturn(Cap& caps, bool leave) {
+    CapScope scope(caps, {CAP_DAC_OVERRIDE}, getuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+    if (leave)
+        return caps.scopeDepth();
+    return -1;
+}
+
+TEST_CASE("CapScope", "[capabilities]") {
+
+    Cap caps{};
+
+    SECTION("privileges are lowered after normal exit") {
+        {
+            CapScope scope(caps, {CAP_DAC_OVERRIDE, CAP_FOWNER}, getuid(),
+                           utils::SrcPos(__FILE__, __LINE__, __func__));
+            REQUIRE(caps.scopeDepth() == 1);
+            REQUIRE(caps.isRaised(CAP_DAC_OVERRIDE));
+            REQUIRE(caps.isRaised(CAP_FOWNER));
+            REQUIRE(!caps.isRaised(CAP_CHOWN));
+        }
+        REQUIRE(caps.scopeDepth() == 0);
+        REQUIRE(!caps.isRaised(CAP_DAC_OVERRIDE));
+        REQUIRE(!caps.isRaised(CAP_FOWNER));
+        REQUIRE(geteuid() == getuid());
+    }
+
+    SECTION("privileges are lowered after early return") {
+        REQUIRE(earlyReturn(caps, true) == 1);
+        REQUIRE(caps.scopeDepth() == 0);
+        REQUIRE(!caps.isRaised(CAP_DAC_OVERRIDE));
+    }
+
+    SECTION("privileges are lowered after exception") {
+        REQUIRE_THROWS_AS(
+            [&] {
+                CapScope scope(caps, {CAP_CHOWN}, getuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+                REQUIRE(caps.isRaised(CAP_CHOWN));
+                throw std::runtime_error("fail inside scope");
+            }(),
+            std::runtime_error);
+        REQUIRE(caps.scopeDepth() == 0);
+        REQUIRE(!caps.isRaised(CAP_CHOWN));
+        REQUIRE(geteuid() == getuid());
+    }
+
+    SECTION("nested scopes coalesce raise and lower") {
+        auto before = caps.getTransitions();
+        {
+            CapScope outer(caps, {CAP_DAC_OVERRIDE, CAP_FOWNER}, getuid(),
+                           utils::SrcPos(__FILE__, __LINE__, __func__));
+            auto raised = caps.getTransitions();
+            for (int i = 0; i < 1000; i++) {
+                CapScope inner(caps, {CAP_DAC_OVERRIDE}, getuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+                REQUIRE(caps.scopeDepth() == 2);
+            }
+            // already raised by outer scope, inner scopes did not change anything
+            REQUIRE(caps.getTransitions() == raised);
+            REQUIRE(caps.isRaised(CAP_DAC_OVERRIDE));
+            REQUIRE(caps.scopeDepth() == 1);
+        }
+        REQUIRE(!caps.isRaised(CAP_DAC_OVERRIDE));
+        if (!caps.isSetuid())
+            REQUIRE(caps.getTransitions() - before == 2); // one raise, one lower
+    }
+
+    SECTION("nested scope with additional capability lowers only that one") {
+        CapScope outer(caps, {CAP_DAC_OVERRIDE}, getuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+        {
+            CapScope inner(caps, {CAP_DAC_OVERRIDE, CAP_CHOWN}, getuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+            REQUIRE(caps.isRaised(CAP_CHOWN));
+        }
+        REQUIRE(!caps.isRaised(CAP_CHOWN));
+        REQUIRE(caps.isRaised(CAP_DAC_OVERRIDE));
+    }
+
+    SECTION("scopes are per thread") {
+        CapScope outer(caps, {CAP_DAC_OVERRIDE}, getuid(), utils::SrcPos(__FILE__, __LINE__, __func__));
+        int depth = -1;
+        bool raised = true;
+        std::thread other([&] {
+            depth = caps.scopeDepth();
+            raised = caps.isRaised(CAP_DAC_OVERRIDE);
+        });
+        other.join();
+        REQUIRE(depth == 0);
+        REQUIRE(!raised);
+        REQUIRE(caps.scopeDepth() == 1);
+    }
+}
@@ -2,6 +2,7 @@
 #include <catch2/catch_test_macros.hpp>
 #include <string>
 
+#include <chrono>
 #include <filesystem>
 #include <iostream>
 
@@ -15,6 +16,7 @@ namespace fs = std::filesystem;
 
 #include "../src/caps.h"
 #include "../src/config.h"
+#include "../src/utils.h"
 
 bool debugflag = false;
 bool traceflag = false;
@@ -136,6 +138,8 @@ workspaces:
 
         REQUIRE(config.clustername() == "old_ws_conf");
         REQUIRE(config.dbuid() == 2);
+        REQUIRE(config.reminderschedule().empty());
+        REQUIRE(config.reminderdigest() == false);
 
         auto filesystem = config.getFsConfig("ws2");
         REQUIRE(filesystem.name == "ws2");
@@ -332,6 +336,10 @@ dbgid: 9999                     # mandatory
 admins: [root]                  # list of admin users, for ws_list
 adminmail: [root@localhost.com] # mail addresses for admins, used by ws_expirer to alert about bad situations
 deldir_timeout: 3600            # maximum time in secs to delete a single workspace.
+mailspool: /var/spool/ws        # optional, ws_expirer queues mails here and sends them at the end of its run
+mailrate: 120                   # optional, max mails per minute sent from the spool
+reminderschedule: [7, 3, 1]     # optional, days before expiration for further reminders
+reminderdigest: yes             # optional, one reminder mail per user for all expiring workspaces
 workspaces:                     # now the list of the workspaces
   lustre:                       # name of workspace as shown with ws_list -l
     keeptime: 1                 # mandatory, time in days to keep workspaces after they expired
@@ -350,6 +358,10 @@ workspaces:                     # now the list of the workspaces
     allocatable: yes             # do not allow new allocations in this workspace if no
     extendable: no              # do not allow extensions in this workspace if no
     restorable: no              # do not allow restores from this workspace if no
+    metadatarate: 5000          # max metadata operations per second of deletion and traversal
+    metadataconcurrency: 8      # max threads doing metadata operations at the same time
+    deleteorder: inode          # unlink in inode order
+    expirertimelimit: 3600      # ws_expirer stops working on this filesystem after an hour
   nfs:                          # second workspace, minimum example
     comment: "what?"
     keeptime: 2                 # mandatory, time in days to keep workspaces after they expired
@@ -372,6 +384,10 @@ workspaces:                     # now the list of the workspaces
         REQUIRE(config.dbgid() == 9999);
         REQUIRE(config.admins() == vector<string>{"root"});
         REQUIRE(config.adminmail() == vector<string>{"root@localhost.com"});
+        REQUIRE(config.mailspool() == "/var/spool/ws");
+        REQUIRE(config.mailrate() == 120);
+        REQUIRE(config.reminderschedule() == vector<int>{7, 3, 1});
+        REQUIRE(config.reminderdigest() == true);
 
         auto filesystem1 = config.getFsConfig("lustre");
         auto filesystem2 = config.getFsConfig("nfs");
@@ -391,11 +407,176 @@ workspaces:                     # now the list of the workspaces
         REQUIRE(filesystem1.allocatable == true);
         REQUIRE(filesystem1.extendable == false);
         REQUIRE(filesystem1.restorable == false);
+        REQUIRE(filesystem1.metadatarate == 5000);
+        REQUIRE(filesystem1.metadataconcurrency == 8);
+        REQUIRE(filesystem1.deleteorder == "inode");
+        REQUIRE(filesystem1.expirertimelimit == 3600);
 
         REQUIRE(filesystem2.comment == "what?");
+        REQUIRE(filesystem2.metadatarate == 0);
+        REQUIRE(filesystem2.metadataconcurrency == 0);
+        REQUIRE(filesystem2.deleteorder == "directory");
+        REQUIRE(filesystem2.expirertimelimit == 0);
 
         config.validate();
 
         REQUIRE(config.isValid());
     }
 }
+
+TEST_CASE("config cache", "[config]") {
+    auto tmpbase = fs::temp_directory_path();
+    auto id = getpid();
+    auto basedirname = tmpbase / fs::path(fmt::format("wstest{}-cache", id));
+    auto cachefile = basedirname / "cache" / "config.cache";
+
+    fs::create_directories(basedirname / "ws.d");
+
+    utils::writeFile(basedirname / "ws.d" / "10-global.conf", R"yaml(
+admins: [root]
+clustername: cached_conf
+adminmail: [root]
+dbgid: 2
+dbuid: 2
+maxextensions: 1
+smtphost: mailhost
+mailspool: /var/spool/ws
+reminderschedule: [3, 1]
+reminderdigest: true
+default: ws1
+)yaml");
+    utils::writeFile(basedirname / "ws.d" / "20-fs.conf", R"yaml(
+workspaces:
+    ws1:
+        database: /tmp
+        deleted: .removed
+        spaces: [/tmp]
+        user_acl: [+a,"-y:list"]
+        keeptime: 3
+        metadatarate: 100
+)yaml");
+
+    auto pathes = std::vector<fs::path>{basedirname / "ws.d", basedirname / "ws.conf"};
+
+    // first read parses files and writes cache
+    auto config1 = Config(pathes, cachefile);
+    REQUIRE(config1.isValid());
+    REQUIRE(!config1.isFromCache());
+    if (geteuid() != 0) {
+        // only root writes and trusts caches
+        REQUIRE(!fs::exists(cachefile));
+        fs::remove_all(basedirname);
+        return;
+    }
+    REQUIRE(fs::exists(cachefile));
+
+    // second read uses cache, with same content
+    auto config2 = Config(pathes, cachefile);
+    REQUIRE(config2.isValid());
+    REQUIRE(config2.isFromCache());
+    REQUIRE(config2.clustername() == "cached_conf");
+    REQUIRE(config2.maxextensions() == 1);
+    REQUIRE(config2.mailspool() == "/var/spool/ws");
+    REQUIRE(config2.reminderschedule() == vector<int>{3, 1});
+    REQUIRE(config2.reminderdigest() == true);
+    REQUIRE(config2.admins() == vector<string>{"root"});
+    REQUIRE(config2.getFsConfig("ws1").keeptime == 3);
+    REQUIRE(config2.getFsConfig("ws1").metadatarate == 100);
+    REQUIRE(config2.getFsConfig("ws1").spaces == vector<string>{"/tmp"});
+    REQUIRE(config2.hasAccess("a", {}, "ws1", ws::LIST) == true);
+    REQUIRE(config2.hasAccess("b", {}, "ws1", ws::LIST) == false);
+    REQUIRE(config2.hasAccess("y", {}, "ws1", ws::LIST) == false);
+    REQUIRE(config2.hasAccess("y", {}, "ws1", ws::CREATE) == true);
+
+    // changing a file makes the cache stale
+    utils::writeFile(basedirname / "ws.d" / "20-fs.conf", R"yaml(
+workspaces:
+    ws1:
+        database: /tmp
+        deleted: .removed
+        spaces: [/tmp]
+        keeptime: 4
+)yaml");
+    auto config3 = Config(pathes, cachefile);
+    REQUIRE(!config3.isFromCache());
+    REQUIRE(config3.getFsConfig("ws1").keeptime == 4);
+    REQUIRE(Config(pathes, cachefile).isFromCache());
+
+    // adding a file makes the cache stale
+    utils::writeFile(basedirname / "ws.d" / "30-fs.conf", R"yaml(
+workspaces:
+    ws2:
+        database: /tmp
+        deleted: .removed
+        spaces: [/tmp]
+)yaml");
+    auto config4 = Config(pathes, cachefile);
+    REQUIRE(!config4.isFromCache());
+    REQUIRE(config4.Filesystems() == vector<string>{"ws1", "ws2"});
+
+    // caches others could have written are ignored
+    REQUIRE(Config(pathes, cachefile).isFromCache());
+    REQUIRE(chown(cachefile.c_str(), 1000, 1000) == 0);
+    REQUIRE(!Config(pathes, cachefile).isFromCache());
+    REQUIRE(Config(pathes, cachefile).isFromCache());
+    fs::permissions(cachefile.parent_path(), fs::perms::group_write, fs::perm_options::add);
+    REQUIRE(!Config(pathes, cachefile).isFromCache());
+    fs::permissions(cachefile.parent_path(), fs::perms::group_write, fs::perm_options::remove);
+    REQUIRE(Config(pathes, cachefile).isFromCache());
+
+    // a corrupt cache is ignored
+    utils::writeFile(cachefile, "WSCONFC\ngarbage");
+    auto config5 = Config(pathes, cachefile);
+    REQUIRE(!config5.isFromCache());
+    REQUIRE(config5.isValid());
+
+    fs::remove_all(basedirname);
+}
+
+TEST_CASE("ACL check benchmark", "[config][.benchmark]") {
+    // 50 filesystems with 200 group ACL entries each, user is member of 200 groups
+    std::string yaml = R"(
+admins: [root]
+dbuid: 2
+dbgid: 2
+adminmail: [root]
+clustername: test
+default: fs0
+workspaces:
+)";
+    for (int f = 0; f < 50; f++) {
+        std::string acl;
+        for (int g = 0; g < 200; g++) {
+            // every 4th filesystem grants only to odd groups
+            if (f % 4 == 0 && g % 2 == 0)
+                continue;
+            acl += fmt::format("{}\"+g{}:list,create\"", acl.empty() ? "" : ",", g + 100 * f);
+        }
+        yaml += fmt::format("    fs{}:\n        database: /tmp\n        spaces: [/tmp]\n        deleted: .del\n"
+                            "        group_acl: [{}]\n",
+                            f, acl);
+    }
+    auto config = Config(yaml);
+    REQUIRE(config.validate());
+
+    std::vector<string> groups;
+    for (int g = 0; g < 200; g++) {
+        groups.push_back(fmt::format("g{}", g));
+    }
+
+    // groups g0..g199 match the ACLs of fs0 and fs1 (offset 100 * f)
+    auto validfs = config.validFilesystems("u", groups, ws::LIST);
+    REQUIRE(validfs == vector<string>{"fs0", "fs1"});
+    REQUIRE(config.validFilesystems("u", groups, ws::EXTEND).empty());
+
+    const int rounds = 100;
+    auto start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (int i = 0; i < rounds; i++) {
+        found += config.validFilesystems("u", groups, ws::CREATE).size();
+    }
+    auto usec =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    REQUIRE(found == 2 * rounds);
+    fmt::println("validFilesystems with 50 filesystems x 200 groups: {} us per call", usec / rounds);
+}
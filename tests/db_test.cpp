@@ -1,15 +1,23 @@
 #define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 
+#include <dlfcn.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace fs = std::filesystem;
 
 #include "fmt/core.h"
 #include "fmt/ostream.h"
 
 #include "../src/caps.h"
+#include "../src/dbcache.h"
+#include "../src/dbinmemory.h"
 #include "../src/dbv1.h"
 #include "../src/user.h"
 
@@ -19,6 +27,43 @@ bool debugflag = false;
 bool traceflag = false;
 int debuglevel = 0;
 
+// count metadata syscalls issued by DB mutations, by interposing the libc wrappers
+namespace syscount {
+bool active = false;
+int renameat2, rename, chmod, chown, fchmod, fchown, stat, unlink, sleep;
+void reset() { renameat2 = rename = chmod = chown = fchmod = fchown = stat = unlink = sleep = 0; }
+} // namespace syscount
+
+#define WS_INTERPOSE(name, ret, params, args)                                                                          \
+    using name##_fn = ret(*) params;                                                                                   \
+    if (syscount::active)                                                                                              \
+        syscount::name++;                                                                                              \
+    static auto real = reinterpret_cast<name##_fn>(dlsym(RTLD_NEXT, #name));                                           \
+    return real args;
+
+extern "C" {
+int renameat2(int olddirfd, const char* oldpath, int newdirfd, const char* newpath, unsigned int flags) __THROW {
+    WS_INTERPOSE(renameat2, int, (int, const char*, int, const char*, unsigned int),
+                 (olddirfd, oldpath, newdirfd, newpath, flags))
+}
+int rename(const char* oldpath, const char* newpath) __THROW {
+    WS_INTERPOSE(rename, int, (const char*, const char*), (oldpath, newpath))
+}
+int chmod(const char* path, mode_t mode) __THROW { WS_INTERPOSE(chmod, int, (const char*, mode_t), (path, mode)) }
+int chown(const char* path, uid_t owner, gid_t group) __THROW {
+    WS_INTERPOSE(chown, int, (const char*, uid_t, gid_t), (path, owner, group))
+}
+int fchmod(int fd, mode_t mode) __THROW { WS_INTERPOSE(fchmod, int, (int, mode_t), (fd, mode)) }
+int fchown(int fd, uid_t owner, gid_t group) __THROW {
+    WS_INTERPOSE(fchown, int, (int, uid_t, gid_t), (fd, owner, group))
+}
+int stat(const char* path, struct stat* buf) __THROW {
+    WS_INTERPOSE(stat, int, (const char*, struct stat*), (path, buf))
+}
+int unlink(const char* path) __THROW { WS_INTERPOSE(unlink, int, (const char*), (path)) }
+unsigned int sleep(unsigned int seconds) { WS_INTERPOSE(sleep, unsigned int, (unsigned int), (seconds)) }
+}
+
 TEST_CASE("Database Test", "[db]") {
 
     // create a stub/mockup  of everything
@@ -215,6 +260,13 @@ comment: ""
         // read again from file
         std::unique_ptr<DBEntry> entry2(db1->readEntry("user1-TEST1", false));
         REQUIRE(entry->getMailaddress() == "mail@box.com");
+
+        // time of last reminder is written
+        REQUIRE(entry2->getReminderSent() == 0);
+        entry2->setReminderSent(1734000000);
+        REQUIRE_NOTHROW(entry2->writeEntry());
+        std::unique_ptr<DBEntry> entry3(db1->readEntry("user1-TEST1", false));
+        REQUIRE(entry3->getReminderSent() == 1734000000);
     }
 }
 
@@ -326,3 +378,261 @@ workspaces:
         REQUIRE((permissions & perms::mask) == (perms::owner_all | perms::group_all | perms::set_gid));
     }
 }
+
+TEST_CASE("release metadata operations", "[db]") {
+
+    auto tmpbase = fs::temp_directory_path();
+    auto id = getpid();
+    auto basedirname = tmpbase / fs::path(fmt::format("wstest{}-release", id));
+
+    auto ws1dbname = basedirname / fs::path("ws1-db");
+
+    fs::create_directories(ws1dbname / fs::path(".removed"));
+
+    utils::writeFile(ws1dbname / ".ws_db_magic", "ws1");
+
+    std::ofstream wsconf(basedirname / "ws.conf");
+    fmt::println(wsconf,
+                 R"yaml(
+admins: [root]
+clustername: release_conf
+adminmail: [root]
+dbgid: 2
+dbuid: 2
+duration: 10
+maxextensions: 1
+smtphost: mailhost
+default: ws1
+workspaces:
+    ws1:
+        database: {}
+        deleted: .removed
+        spaces: [/tmp]
+)yaml",
+                 ws1dbname.string());
+    wsconf.close();
+
+    auto config = Config(std::vector<fs::path>{basedirname / "ws.conf"});
+    std::unique_ptr<Database> db1(config.openDB("ws1"));
+
+    db1->createEntry("user1-rel1", "/a/path", time(NULL), time(NULL) + 3601, 1, 7, false, "", "", "release me");
+    db1->createEntry("user1-rel2", "/a/path2", time(NULL), time(NULL) + 3601, 1, 7, false, "", "", "release me");
+
+    SECTION("release without collision") {
+        std::unique_ptr<DBEntry> entry(db1->readEntry("user1-rel1", false));
+        time_t timestamp = 1000;
+
+        syscount::reset();
+        syscount::active = true;
+        REQUIRE_NOTHROW(entry->release(timestamp));
+        syscount::active = false;
+
+        REQUIRE(timestamp == 1000);
+        REQUIRE(syscount::renameat2 == 1);
+        REQUIRE(syscount::rename == 0);
+        REQUIRE(syscount::chmod == 0);
+        REQUIRE(syscount::chown == 0);
+        REQUIRE(syscount::fchmod == 1);
+        REQUIRE(syscount::stat == 0);
+        REQUIRE(syscount::unlink == 1);
+        REQUIRE(syscount::sleep == 0);
+
+        REQUIRE(!fs::exists(ws1dbname / "user1-rel1"));
+        REQUIRE(fs::exists(ws1dbname / ".removed" / "user1-rel1-1000"));
+        REQUIRE((fs::status(ws1dbname / ".removed" / "user1-rel1-1000").permissions() & fs::perms::mask) ==
+                (fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read | fs::perms::others_read));
+
+        std::unique_ptr<DBEntry> released(db1->readEntry("user1-rel1-1000", true));
+        REQUIRE(released->getComment() == "release me");
+        REQUIRE(released->getReleaseTime() > 0);
+    }
+
+    SECTION("release with name collision") {
+        utils::writeFile(ws1dbname / ".removed" / "user1-rel2-2000", "workspace: /other\n");
+        std::unique_ptr<DBEntry> entry(db1->readEntry("user1-rel2", false));
+        time_t timestamp = 2000;
+
+        syscount::reset();
+        syscount::active = true;
+        REQUIRE_NOTHROW(entry->release(timestamp));
+        syscount::active = false;
+
+        REQUIRE(timestamp == 2001);
+        REQUIRE(syscount::renameat2 == 2);
+        REQUIRE(syscount::sleep == 0);
+
+        REQUIRE(!fs::exists(ws1dbname / "user1-rel2"));
+        REQUIRE(fs::exists(ws1dbname / ".removed" / "user1-rel2-2001"));
+        // existing entry is untouched
+        REQUIRE(utils::getFileContents((ws1dbname / ".removed" / "user1-rel2-2000").c_str()) == "workspace: /other\n");
+    }
+
+    // no temp files left behind
+    for (auto const& f : fs::directory_iterator(ws1dbname / ".removed")) {
+        REQUIRE(f.path().filename().string().rfind(".ws_tmp_", 0) != 0);
+    }
+
+    fs::remove_all(basedirname);
+}
+
+TEST_CASE("in-memory database", "[db]") {
+
+    auto tmpbase = fs::temp_directory_path();
+    auto id = getpid();
+    auto basedirname = tmpbase / fs::path(fmt::format("wstest{}-mem", id));
+
+    fs::create_directories(basedirname);
+
+    std::ofstream wsconf(basedirname / "ws.conf");
+    fmt::println(wsconf,
+                 R"yaml(
+admins: [root]
+clustername: mem_conf
+adminmail: [root]
+dbgid: 2
+dbuid: 2
+duration: 10
+maxextensions: 1
+smtphost: mailhost
+default: mem
+workspaces:
+    mem:
+        database: ":memory:"
+        deleted: .removed
+        spaces: [/does/not/exist]
+)yaml");
+    wsconf.close();
+
+    auto config = Config(std::vector<fs::path>{basedirname / "ws.conf"});
+    fs::remove_all(basedirname);
+
+    std::unique_ptr<Database> db(config.openDB("mem"));
+    REQUIRE(dynamic_cast<InMemoryDatabase*>(db.get()) != nullptr);
+
+    db->createEntry("user1-TEST1", "/a/path", 1, 1734701876, 0, 1, false, "", "", "");
+    db->createEntry("user2-TEST1", "/a/path11", 1, 1734701876, 0, 3, true, "group1", "", "");
+    db->createEntry("user2-TEST2", "/a/path12", 1, 1734701876, 0, 3, false, "", "", "");
+
+    SECTION("list entries") {
+        REQUIRE(db->matchPattern("TEST*", "user1", vector<string>{}, false, false) == vector<string>{"user1-TEST1"});
+        auto result = db->matchPattern("*", "user2", vector<string>{}, false, false);
+        std::sort(result.begin(), result.end());
+        REQUIRE(result == vector<string>{"user2-TEST1", "user2-TEST2"});
+        REQUIRE(db->matchPattern("*Pest*", "user1", vector<string>{}, false, false) == vector<string>{});
+        REQUIRE(db->matchPattern("*", "user1", vector<string>{"group1"}, false, true) ==
+                vector<string>{"user2-TEST1"});
+    }
+
+    SECTION("read and modify entry") {
+        REQUIRE_THROWS(db->readEntry("user-TEST", false));
+
+        std::unique_ptr<DBEntry> entry(db->readEntry("user1-TEST1", false));
+        REQUIRE(entry->getWSPath() == "/a/path");
+        REQUIRE(entry->getFilesystem() == "mem");
+        if (getuid() != 0) {
+            REQUIRE_NOTHROW(entry->useExtension(entry->getExpiration() + 1, "mail@box.com", 5, "nice workspace"));
+            REQUIRE(entry->getExtension() == 0);
+            REQUIRE_THROWS(entry->useExtension(entry->getExpiration() + 2, "mail@box.com", 5, "nice workspace"));
+        }
+
+        std::unique_ptr<DBEntry> entry2(db->readEntry("user1-TEST1", false));
+        REQUIRE(entry2->getMailaddress() == "mail@box.com");
+    }
+
+    SECTION("release and expire") {
+        std::unique_ptr<DBEntry> entry(db->readEntry("user2-TEST2", false));
+        time_t timestamp = 1000;
+        entry->release(timestamp);
+        REQUIRE(timestamp == 1000);
+        REQUIRE(entry->getReleaseTime() > 0);
+        REQUIRE_THROWS(db->readEntry("user2-TEST2", false));
+        REQUIRE(db->matchPattern("*", "user2", vector<string>{}, true, false) == vector<string>{"user2-TEST2-1000"});
+
+        // name collision increments timestamp
+        db->createEntry("user2-TEST2", "/a/path12", 1, 1734701876, 0, 3, false, "", "", "");
+        std::unique_ptr<DBEntry> entry2(db->readEntry("user2-TEST2", false));
+        timestamp = 1000;
+        entry2->expire(timestamp);
+        REQUIRE(timestamp == 1001);
+        std::unique_ptr<DBEntry> expired(db->readEntry("user2-TEST2-1001", true));
+        REQUIRE(expired->getExpired() > 0);
+
+        entry2->remove();
+        REQUIRE_THROWS(db->readEntry("user2-TEST2-1001", true));
+        db->deleteEntry("user2-TEST2-1000", true);
+        REQUIRE(db->matchPattern("*", "user2", vector<string>{}, true, false) == vector<string>{});
+    }
+
+    SECTION("many entries") {
+        auto memdb = dynamic_cast<InMemoryDatabase*>(db.get());
+        for (int i = 0; i < 100000; i++) {
+            db->createEntry(fmt::format("user{}-ws{}", i % 100, i), "/a/path", 1, 1734701876, 0, 3, false, "", "",
+                            "");
+        }
+        REQUIRE(memdb->size(false) == 100003);
+        REQUIRE(db->matchPattern("*", "user7", vector<string>{}, false, false).size() == 1000);
+    }
+}
+
+TEST_CASE("caching database", "[db]") {
+
+    auto tmpbase = fs::temp_directory_path();
+    auto id = getpid();
+    auto basedirname = tmpbase / fs::path(fmt::format("wstest{}-cache", id));
+
+    fs::create_directories(basedirname);
+
+    std::ofstream wsconf(basedirname / "ws.conf");
+    fmt::println(wsconf,
+                 R"yaml(
+admins: [root]
+clustername: cache_conf
+adminmail: [root]
+dbgid: 2
+dbuid: 2
+duration: 10
+maxextensions: 1
+smtphost: mailhost
+default: mem
+workspaces:
+    mem:
+        database: ":memory:"
+        deleted: .removed
+        spaces: [/does/not/exist]
+)yaml");
+    wsconf.close();
+
+    auto config = Config(std::vector<fs::path>{basedirname / "ws.conf"});
+    fs::remove_all(basedirname);
+
+    auto backend = new InMemoryDatabase(&config, "mem");
+    CachingDatabase db{std::unique_ptr<Database>(backend)};
+
+    db.createEntry("user1-TEST1", "/a/path1", 1, 1734701876, 0, 1, false, "", "", "");
+    db.createEntry("user1-TEST2", "/a/path2", 1, 1734701876, 0, 1, false, "", "", "");
+
+    // second read is served from cache
+    REQUIRE(db.readEntry("user1-TEST1", false)->getWSPath() == "/a/path1");
+    REQUIRE(db.readEntry("user1-TEST1", false)->getWSPath() == "/a/path1");
+    REQUIRE(db.getMisses() == 1);
+    REQUIRE(db.getHits() == 1);
+
+    // listing is cached, changes of backend are not seen
+    REQUIRE(db.matchPattern("*", "user1", vector<string>{}, false, false).size() == 2);
+    backend->createEntry("user1-TEST3", "/a/path3", 1, 1734701876, 0, 1, false, "", "", "");
+    REQUIRE(db.matchPattern("*", "user1", vector<string>{}, false, false).size() == 2);
+
+    // modification through cache invalidates entry
+    std::unique_ptr<DBEntry> entry(db.readEntry("user1-TEST1", false));
+    entry->setExpiration(1734701877);
+    entry->writeEntry();
+    REQUIRE(db.readEntry("user1-TEST1", false)->getExpiration() == 1734701877);
+    REQUIRE(db.getMisses() == 2);
+
+    // release through cache invalidates listings
+    time_t timestamp = 1000;
+    db.readEntry("user1-TEST2", false)->release(timestamp);
+    REQUIRE_THROWS(db.readEntry("user1-TEST2", false));
+    REQUIRE(db.matchPattern("*", "user1", vector<string>{}, false, false).size() == 2);
+    REQUIRE(db.matchPattern("*", "user1", vector<string>{}, true, false) == vector<string>{"user1-TEST2-1000"});
+}
@@ -20,6 +20,7 @@ workspace: /a/path
 expiration: 1734701876
 extensions: 3
 reminder: 0
+remindersent: 1734000000
 mailaddress: ""
 comment: ""
 )yaml"});
@@ -29,5 +30,6 @@ comment: ""
         REQUIRE(entry.getExpiration() == 1734701876);
         REQUIRE(entry.getExtension() == 3);
         REQUIRE(entry.getMailaddress() == "");
+        REQUIRE(entry.getReminderSent() == 1734000000);
     }
 }
@@ -0,0 +1,147 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../src/executor.h"
+
+bool debugflag = false;
+bool traceflag = false;
+int debuglevel = 0;
+
+// binary tree of tasks, every task spawns two children until depth is reached
+static void spawnTree(Executor::TaskGroup& group, int depth, std::atomic<long>& count) {
+    count++;
+    if (depth == 0)
+        return;
+    for (int i = 0; i < 2; i++)
+        group.run([&group, depth, &count] { spawnTree(group, depth - 1, count); });
+}
+
+TEST_CASE("executor", "[executor]") {
+    auto& executor = Executor::instance();
+
+    SECTION("parallel_for visits every index once") {
+        for (unsigned threads : {1u, 2u, 8u}) {
+            executor.start(threads);
+            REQUIRE(executor.getThreads() == threads);
+            std::vector<std::atomic<int>> visits(10000);
+            for (auto& v : visits)
+                v = 0;
+            executor.parallel_for(0, visits.size(), [&visits](size_t i) { visits[i]++; });
+            for (const auto& v : visits)
+                REQUIRE(v == 1);
+        }
+    }
+
+    SECTION("empty range") {
+        executor.start(4);
+        bool called = false;
+        executor.parallel_for(5, 5, [&called](size_t) { called = true; });
+        REQUIRE(!called);
+    }
+
+    SECTION("tasks spawning tasks") {
+        executor.start(4);
+        std::atomic<long> count{0};
+        Executor::TaskGroup group;
+        spawnTree(group, 12, count);
+        group.wait();
+        REQUIRE(count == (1 << 13) - 1);
+    }
+
+    SECTION("nested parallelism does not use more threads than configured") {
+        executor.start(4);
+        std::mutex mtx;
+        std::set<std::thread::id> ids;
+        std::atomic<long> sum{0};
+        executor.parallel_for(0, 16, [&](size_t i) {
+            executor.parallel_for(0, 1000, [&](size_t j) {
+                sum += i * 1000 + j;
+                std::lock_guard<std::mutex> lock(mtx);
+                ids.insert(std::this_thread::get_id());
+            });
+        });
+        REQUIRE(sum == 16000L * 15999 / 2);
+        REQUIRE(ids.size() <= 4);
+    }
+
+    SECTION("failing task does not stop others") {
+        executor.start(2);
+        std::atomic<int> done{0};
+        REQUIRE_THROWS_AS(executor.parallel_for(0, 100,
+                                                [&done](size_t i) {
+                                                    if (i == 50)
+                                                        throw std::runtime_error("task failure");
+                                                    done++;
+                                                }),
+                          std::runtime_error);
+        // rest of the failing chunk is skipped
+        REQUIRE(done >= 50);
+        REQUIRE(done < 100);
+    }
+
+    SECTION("exception of a nested task reaches the outer waiter") {
+        executor.start(4);
+        Executor::TaskGroup group;
+        group.run([] { Executor::instance().parallel_for(0, 10, [](size_t) { throw std::logic_error("inner"); }); });
+        REQUIRE_THROWS_AS(group.wait(), std::logic_error);
+        // error is reported once
+        REQUIRE_NOTHROW(group.wait());
+    }
+
+    SECTION("init is called in every worker thread") {
+        static thread_local int tag = 0;
+        executor.start(4, [] { tag = 7; });
+        tag = 7; // calling thread
+        std::atomic<int> tagged{0};
+        executor.parallel_for(0, 1000, [&tagged](size_t) {
+            if (tag == 7)
+                tagged++;
+        });
+        REQUIRE(tagged == 1000);
+        tag = 0;
+    }
+
+    SECTION("waiting thread sleeps while others work") {
+        executor.start(2);
+        Executor::TaskGroup group;
+        group.run([] { std::this_thread::sleep_for(std::chrono::milliseconds(300)); });
+        // let the worker take the task
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto cputime = [] {
+            timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+        };
+        double before = cputime();
+        group.wait();
+        REQUIRE(cputime() - before < 100.0);
+    }
+
+    executor.start(1);
+}
+
+TEST_CASE("thread count", "[executor]") {
+    unsetenv("WS_THREADS");
+    REQUIRE(Executor::threadCount(3, 5) == 3);
+    REQUIRE(Executor::threadCount(0, 5) == 5);
+    REQUIRE(Executor::threadCount(0, 0) >= 1);
+    REQUIRE(Executor::threadCount(2, 0, 4) == 4);
+
+    setenv("WS_THREADS", "7", 1);
+    REQUIRE(Executor::threadCount(3, 5) == 3);
+    REQUIRE(Executor::threadCount(0, 5) == 7);
+
+    setenv("WS_THREADS", "none", 1);
+    REQUIRE(Executor::threadCount(0, 5) == 5);
+    unsetenv("WS_THREADS");
+}
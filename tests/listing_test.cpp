@@ -0,0 +1,140 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fmt/core.h"
+
+#include "../src/caps.h"
+#include "../src/config.h"
+#include "../src/dbinmemory.h"
+#include "../src/listing.h"
+#include "../src/user.h"
+
+bool debugflag = false;
+bool traceflag = false;
+int debuglevel = 0;
+
+// init caps here, when euid!=uid
+Cap caps{};
+
+// count heap allocations while counting is enabled
+static std::atomic<bool> countallocs{false};
+static std::atomic<long> allocs{0};
+
+void* operator new(std::size_t size) {
+    if (countallocs)
+        allocs++;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// run f with stdout going to /dev/null, returns number of allocations done by f
+template <typename F> static long countAllocations(F f) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    allocs = 0;
+    countallocs = true;
+    f();
+    countallocs = false;
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return allocs;
+}
+
+TEST_CASE("ws_list print path", "[listing]") {
+    Config config(std::string(R"yaml(
+admins: [root]
+clustername: list_conf
+adminmail: [root]
+dbgid: 2
+dbuid: 2
+duration: 10
+maxextensions: 1
+smtphost: mailhost
+default: mem
+workspaces:
+    mem:
+        database: ":memory:"
+        deleted: .removed
+        keeptime: 7
+        spaces: [/does/not/exist]
+)yaml"));
+    REQUIRE(config.isValid());
+
+    std::unique_ptr<Database> db(config.openDB("mem"));
+    const auto identity = user::getIdentity(config.admins());
+    const auto& username = identity.username;
+    auto now = time(nullptr);
+
+    // strings longer than small string buffers, and longer than the table columns
+    std::vector<std::unique_ptr<DBEntry>> entries;
+    for (int i = 0; i < 100; i++) {
+        auto id = fmt::format("{}-a_rather_long_workspace_name_{}", username, i);
+        db->createEntry(id, fmt::format("/does/not/exist/a/long/path/to/the/workspace/directory/{}", id), now,
+                        now + 86400 * i, 3, 1, false, "somegroup", "someone@some.where.example.com",
+                        "a comment that does not fit into a small string");
+        entries.push_back(db->readEntry(id, false));
+    }
+
+    // first call initializes statics and stdio buffers
+    auto warmup = countAllocations([&] {
+        print_entry(entries[0].get(), config, identity, true, false, true, false);
+        print_entry(entries[0].get(), config, identity, true, false, true, true);
+        print_entry_tableformat(entries[0].get(), config, identity, true, false, true, false);
+        print_entry_tableformat(entries[0].get(), config, identity, true, true, true, false);
+        print_entry_short(entries[0].get(), identity);
+    });
+    fmt::println("print path: {} allocations for first entry", warmup);
+
+    SECTION("multiline format") {
+        REQUIRE(countAllocations([&] {
+                    for (const auto& entry : entries) {
+                        print_entry(entry.get(), config, identity, true, false, true, false);
+                        print_entry(entry.get(), config, identity, true, false, true, true);
+                    }
+                }) == 0);
+    }
+
+    SECTION("table format") {
+        REQUIRE(countAllocations([&] {
+                    for (const auto& entry : entries) {
+                        print_entry_tableformat(entry.get(), config, identity, true, false, true, false);
+                        print_entry_tableformat(entry.get(), config, identity, true, true, true, true);
+                    }
+                }) == 0);
+    }
+
+    SECTION("short format") {
+        REQUIRE(countAllocations([&] {
+                    for (const auto& entry : entries)
+                        print_entry_short(entry.get(), identity);
+                }) == 0);
+    }
+
+    SECTION("masked id") {
+        auto masked = getMaskedID(entries[1].get(), identity);
+        if (identity.admin)
+            REQUIRE(masked == entries[1]->getId());
+        else
+            REQUIRE(masked == "a_rather_long_workspace_name_1");
+    }
+}
@@ -0,0 +1,413 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fmt/core.h"
+
+#include "../src/mail.h"
+#include "../src/mailspool.h"
+
+namespace fs = std::filesystem;
+
+bool debugflag = false;
+bool traceflag = false;
+int debuglevel = 0;
+
+// minimal SMTP server on a local port, accepts everything and keeps the mails,
+// serves one connection at a time
+class SmtpSink {
+  private:
+    int listenfd = -1;
+    int port = 0;
+    int closeafter; // mails per connection, 0 is unlimited
+    bool abrupt;    // close without reply when next mail starts instead of after the last one
+    std::atomic<bool> stop{false};
+    std::thread thread;
+    std::mutex mutex;
+    int connections = 0;
+    std::vector<std::string> mails;
+
+    // next line without CRLF, false if connection is closed or sink stops
+    bool readLine(int fd, std::string& buffer, std::string& line) {
+        for (;;) {
+            auto pos = buffer.find("\r\n");
+            if (pos != std::string::npos) {
+                line = buffer.substr(0, pos);
+                buffer.erase(0, pos + 2);
+                return true;
+            }
+            struct pollfd pfd = {fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, 100);
+            if (stop)
+                return false;
+            if (ready <= 0)
+                continue;
+            char chunk[4096];
+            auto len = recv(fd, chunk, sizeof(chunk), 0);
+            if (len <= 0)
+                return false;
+            buffer.append(chunk, len);
+        }
+    }
+
+    void reply(int fd, const std::string& text) { (void)!write(fd, text.data(), text.size()); }
+
+    void serveConnection(int fd) {
+        std::string buffer, line;
+        int count = 0;
+        reply(fd, "220 localhost ESMTP sink\r\n");
+        while (readLine(fd, buffer, line)) {
+            auto command = line.substr(0, 4);
+            if (command == "EHLO" || command == "HELO") {
+                reply(fd, "250 localhost\r\n");
+            } else if (command == "MAIL") {
+                if (abrupt && closeafter > 0 && count == closeafter)
+                    return;
+                reply(fd, "250 OK\r\n");
+            } else if (command == "RCPT" && reject) {
+                reply(fd, "550 no such user\r\n");
+            } else if (command == "RCPT" || command == "RSET" || command == "NOOP") {
+                reply(fd, "250 OK\r\n");
+            } else if (command == "DATA") {
+                reply(fd, "354 go ahead\r\n");
+                std::string mail;
+                while (readLine(fd, buffer, line) && line != ".")
+                    mail += line + "\n";
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    mails.push_back(mail);
+                }
+                if (dropdata)
+                    return;
+                reply(fd, "250 queued\r\n");
+                if (++count == closeafter && !abrupt)
+                    return;
+            } else if (command == "QUIT") {
+                reply(fd, "221 bye\r\n");
+                return;
+            } else {
+                reply(fd, "502 not implemented\r\n");
+            }
+        }
+    }
+
+    void serve() {
+        while (!stop) {
+            struct pollfd pfd = {listenfd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0)
+                continue;
+            int fd = accept(listenfd, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                connections++;
+            }
+            serveConnection(fd);
+            close(fd);
+        }
+    }
+
+  public:
+    std::atomic<bool> reject{false};   // refuse all recipients
+    std::atomic<bool> dropdata{false}; // close after the mail data without reply
+
+    explicit SmtpSink(int closeafter_ = 0, bool abrupt_ = false) : closeafter(closeafter_), abrupt(abrupt_) {
+        listenfd = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(listenfd >= 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        REQUIRE(bind(listenfd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0);
+        REQUIRE(listen(listenfd, 8) == 0);
+        socklen_t len = sizeof(addr);
+        REQUIRE(getsockname(listenfd, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0);
+        port = ntohs(addr.sin_port);
+        thread = std::thread([this] { serve(); });
+    }
+
+    ~SmtpSink() {
+        stop = true;
+        thread.join();
+        close(listenfd);
+    }
+
+    std::string url() const { return fmt::format("smtp://127.0.0.1:{}", port); }
+
+    int getConnections() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return connections;
+    }
+
+    std::vector<std::string> getMails() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return mails;
+    }
+};
+
+static std::string testMail(int i) {
+    return fmt::format("From: from@example.com\r\nTo: to@example.com\r\nSubject: mail {}\r\n\r\nbody {}\r\n", i, i);
+}
+
+TEST_CASE("mail session", "[mail]") {
+    mail::initCurl();
+    const std::vector<std::string> mail_to = {"to@example.com"};
+
+    SECTION("mails share one connection") {
+        SmtpSink sink;
+        {
+            mail::Session session(sink.url());
+            for (int i = 0; i < 20; i++)
+                REQUIRE(session.send("from@example.com", mail_to, testMail(i)));
+            REQUIRE(session.getSent() == 20);
+            REQUIRE(session.getConnects() == 1);
+        }
+        auto mails = sink.getMails();
+        REQUIRE(mails.size() == 20);
+        REQUIRE(mails[0].find("Subject: mail 0") != std::string::npos);
+        REQUIRE(mails[19].find("body 19") != std::string::npos);
+        REQUIRE(sink.getConnections() == 1);
+    }
+
+    SECTION("reconnects after server closed the connection") {
+        SmtpSink sink(3);
+        {
+            mail::Session session(sink.url());
+            for (int i = 0; i < 10; i++)
+                REQUIRE(session.send("from@example.com", mail_to, testMail(i)));
+            REQUIRE(session.getSent() == 10);
+        }
+        REQUIRE(sink.getMails().size() == 10);
+        REQUIRE(sink.getConnections() == 4);
+    }
+
+    SECTION("retries when connection is lost during a mail") {
+        SmtpSink sink(2, true);
+        {
+            mail::Session session(sink.url());
+            for (int i = 0; i < 5; i++)
+                REQUIRE(session.send("from@example.com", mail_to, testMail(i)));
+            REQUIRE(session.getConnects() == 3);
+        }
+        auto mails = sink.getMails();
+        REQUIRE(mails.size() == 5);
+        REQUIRE(mails[2].find("Subject: mail 2") != std::string::npos);
+        REQUIRE(sink.getConnections() == 3);
+    }
+
+    SECTION("no retry when connection is lost after the mail data") {
+        SmtpSink sink;
+        sink.dropdata = true;
+        {
+            mail::Session session(sink.url());
+            REQUIRE(!session.send("from@example.com", mail_to, testMail(0)));
+            REQUIRE(session.getConnects() == 1);
+        }
+        // server got it once, sending again might duplicate it
+        REQUIRE(sink.getMails().size() == 1);
+        REQUIRE(sink.getConnections() == 1);
+    }
+
+    SECTION("single mail and unreachable server") {
+        std::string url;
+        {
+            SmtpSink sink;
+            url = sink.url();
+            REQUIRE(mail::sendCurl(url, "from@example.com", mail_to, testMail(0)));
+            REQUIRE(sink.getMails().size() == 1);
+        }
+        // sink is gone, nobody listens on the port
+        mail::Session session(url);
+        REQUIRE(!session.send("from@example.com", mail_to, testMail(1)));
+        REQUIRE(session.getSent() == 0);
+    }
+
+    mail::cleanupCurl();
+}
+
+// fresh directory for one test
+static fs::path makeTempDir() {
+    std::string tmpl = (fs::temp_directory_path() / "_wsMS.XXXXXX").string();
+    REQUIRE(mkdtemp(tmpl.data()) != nullptr);
+    return tmpl;
+}
+
+TEST_CASE("mail spool", "[mail]") {
+    mail::initCurl();
+    const std::vector<std::string> mail_to = {"to@example.com"};
+    auto dir = makeTempDir();
+    mail::Spool spool((dir / "spool").string());
+
+    SECTION("queued mails are sent in order and removed") {
+        for (int i = 0; i < 5; i++)
+            REQUIRE(spool.enqueue("from@example.com", mail_to, testMail(i)));
+        auto names = spool.queued();
+        REQUIRE(names.size() == 5);
+        REQUIRE(fs::is_empty(dir / "spool" / "tmp"));
+
+        mail::SpooledMail mail;
+        REQUIRE(mail::Spool::read((dir / "spool" / "new" / names[0]).string(), mail));
+        REQUIRE(mail.mail_from == "from@example.com");
+        REQUIRE(mail.mail_to == mail_to);
+        REQUIRE(mail.completeMail == testMail(0));
+        REQUIRE(mail.attempts == 0);
+
+        SmtpSink sink;
+        auto stats = spool.drain(sink.url(), 0, 0);
+        REQUIRE(stats.sent == 5);
+        REQUIRE(stats.deferred + stats.failed + stats.pending == 0);
+        REQUIRE(spool.queued().empty());
+        auto mails = sink.getMails();
+        REQUIRE(mails.size() == 5);
+        for (int i = 0; i < 5; i++)
+            REQUIRE(mails[i].find(fmt::format("Subject: mail {}", i)) != std::string::npos);
+        REQUIRE(sink.getConnections() == 1);
+    }
+
+    SECTION("mails stay in spool while server is unreachable") {
+        std::string url;
+        {
+            SmtpSink sink;
+            url = sink.url();
+        }
+        for (int i = 0; i < 3; i++)
+            REQUIRE(spool.enqueue("from@example.com", mail_to, testMail(i)));
+        auto stats = spool.drain(url, 0, 0);
+        REQUIRE(stats.sent == 0);
+        REQUIRE(stats.pending == 3);
+        auto names = spool.queued();
+        REQUIRE(names.size() == 3);
+        // outage is not an attempt of the mail
+        mail::SpooledMail mail;
+        REQUIRE(mail::Spool::read((dir / "spool" / "new" / names[0]).string(), mail));
+        REQUIRE(mail.attempts == 0);
+    }
+
+    SECTION("refused mails are retried with backoff and given up") {
+        REQUIRE(spool.enqueue("from@example.com", mail_to, testMail(0)));
+        SmtpSink sink;
+        sink.reject = true;
+        auto stats = spool.drain(sink.url(), 0, 0);
+        REQUIRE(stats.deferred == 1);
+        auto names = spool.queued();
+        REQUIRE(names.size() == 1);
+        mail::SpooledMail mail;
+        auto path = (dir / "spool" / "new" / names[0]).string();
+        REQUIRE(mail::Spool::read(path, mail));
+        REQUIRE(mail.attempts == 1);
+        REQUIRE(mail.next >= time(nullptr) + mail::Spool::backoff(1) - 1);
+
+        // not due yet
+        stats = spool.drain(sink.url(), 0, 0);
+        REQUIRE(stats.deferred == 1);
+        REQUIRE(sink.getConnections() == 1);
+
+        // last attempt
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << fmt::format("ws_mailspool 1\nqueued 1\nattempts {}\nnext 0\n", mail::Spool::maxattempts - 1)
+                << "from from@example.com\nto to@example.com\n\n"
+                << testMail(0);
+        }
+        stats = spool.drain(sink.url(), 0, 0);
+        REQUIRE(stats.failed == 1);
+        REQUIRE(spool.queued().empty());
+        REQUIRE(fs::exists(dir / "spool" / "failed" / names[0]));
+    }
+
+    SECTION("mails lost after the mail data are not sent again") {
+        REQUIRE(spool.enqueue("from@example.com", mail_to, testMail(0)));
+        auto names = spool.queued();
+        SmtpSink sink;
+        sink.dropdata = true;
+        auto stats = spool.drain(sink.url(), 0, 0);
+        REQUIRE(stats.failed == 1);
+        REQUIRE(stats.deferred == 0);
+        REQUIRE(spool.queued().empty());
+        REQUIRE(fs::exists(dir / "spool" / "failed" / names[0]));
+        REQUIRE(sink.getMails().size() == 1);
+    }
+
+    SECTION("rate and deadline limit sending") {
+        for (int i = 0; i < 4; i++)
+            REQUIRE(spool.enqueue("from@example.com", mail_to, testMail(i)));
+        SmtpSink sink;
+        auto start = std::chrono::steady_clock::now();
+        // 600 mails per minute, one every 100ms
+        auto stats = spool.drain(sink.url(), 600, 0);
+        REQUIRE(stats.sent == 4);
+        REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(300));
+
+        REQUIRE(spool.enqueue("from@example.com", mail_to, testMail(4)));
+        stats = spool.drain(sink.url(), 0, time(nullptr) - 1);
+        REQUIRE(stats.pending == 1);
+        REQUIRE(spool.queued().size() == 1);
+    }
+
+    SECTION("one sender at a time") {
+        REQUIRE(spool.enqueue("from@example.com", mail_to, testMail(0)));
+        int fd = open((dir / "spool" / "lock").c_str(), O_RDWR | O_CREAT, 0600);
+        REQUIRE(flock(fd, LOCK_EX) == 0);
+        SmtpSink sink;
+        auto stats = spool.drain(sink.url(), 0, 0);
+        close(fd);
+        REQUIRE(stats.pending == 1);
+        REQUIRE(sink.getMails().empty());
+    }
+
+    SECTION("backoff grows and is capped") {
+        REQUIRE(mail::Spool::backoff(1) == 300);
+        REQUIRE(mail::Spool::backoff(2) == 600);
+        REQUIRE(mail::Spool::backoff(3) == 1200);
+        REQUIRE(mail::Spool::backoff(20) == 6 * 3600);
+    }
+
+    fs::remove_all(dir);
+    mail::cleanupCurl();
+}
+
+TEST_CASE("calendar file", "[mail]") {
+    SECTION("one event per workspace") {
+        auto ics = mail::generateICS({{"user-a", "ws1", 2000000000}, {"user-b", "ws2", 2000086400}}, "cluster",
+                                     1900000000);
+        REQUIRE(ics.find("BEGIN:VCALENDAR\r\n") == 0);
+        REQUIRE(ics.rfind("END:VCALENDAR\r\n") == ics.size() - 15);
+        size_t events = 0;
+        for (auto pos = ics.find("BEGIN:VEVENT"); pos != std::string::npos; pos = ics.find("BEGIN:VEVENT", pos + 1))
+            events++;
+        REQUIRE(events == 2);
+        REQUIRE(ics.find("SUMMARY:Workspace user-a expires\r\n") != std::string::npos);
+        REQUIRE(ics.find("LOCATION:cluster:ws2\r\n") != std::string::npos);
+        // different workspaces, different events
+        REQUIRE(ics.find("UID:587a1aa6-" + std::to_string(std::hash<std::string>{}("user-a"))) !=
+                ics.find("UID:587a1aa6-" + std::to_string(std::hash<std::string>{}("user-b"))));
+    }
+
+    SECTION("base64") {
+        REQUIRE(mail::base64Encode("") == "");
+        REQUIRE(mail::base64Encode("f") == "Zg==");
+        REQUIRE(mail::base64Encode("fo") == "Zm8=");
+        REQUIRE(mail::base64Encode("foo") == "Zm9v");
+        REQUIRE(mail::base64Encode("foobar") == "Zm9vYmFy");
+    }
+}
@@ -0,0 +1,327 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <grp.h>
+#include <pwd.h>
+#include <sys/types.h>
+
+#include "fmt/core.h"
+
+#include "../src/caps.h"
+#include "../src/nsscache.h"
+#include "../src/user.h"
+#include "../src/utils.h"
+
+Cap caps{};
+
+bool debugflag = false;
+bool traceflag = false;
+int debuglevel = 0;
+
+// fake NSS dataset, replaces the libc functions used by user::getUserGids and NSSCache
+// users u0..u1999, 50 primary groups, 1000 secondary groups, every user is member of 5 secondary groups
+namespace fakenss {
+const int nusers = 2000;
+const int ngroups = 1000;
+const gid_t primarybase = 20000;
+const gid_t groupbase = 30000;
+
+// latency of a single lookup, like a round trip to a directory server
+std::chrono::microseconds latency{0};
+
+std::atomic<long> getpwnam_calls{0};
+std::atomic<long> getgrouplist_calls{0};
+
+struct Dataset {
+    std::vector<std::string> usernames;
+    std::vector<struct passwd> passwds;
+    std::vector<std::string> groupnames;
+    std::vector<std::vector<char*>> groupmembers;
+    std::vector<struct group> groups;
+
+    Dataset() {
+        usernames.reserve(nusers);
+        for (int u = 0; u < nusers; u++)
+            usernames.push_back(fmt::format("u{}", u));
+        groupnames.reserve(ngroups);
+        for (int g = 0; g < ngroups; g++)
+            groupnames.push_back(fmt::format("g{}", g));
+
+        groupmembers.resize(ngroups);
+        for (int u = 0; u < nusers; u++) {
+            passwd pw{};
+            pw.pw_name = usernames[u].data();
+            pw.pw_uid = 10000 + u;
+            pw.pw_gid = primarybase + u % 50;
+            passwds.push_back(pw);
+            for (int k = 0; k < 5; k++)
+                groupmembers[(u * 7 + k * 101) % ngroups].push_back(usernames[u].data());
+        }
+        for (int g = 0; g < ngroups; g++) {
+            groupmembers[g].push_back(nullptr);
+            group gr{};
+            gr.gr_name = groupnames[g].data();
+            gr.gr_gid = groupbase + g;
+            gr.gr_mem = groupmembers[g].data();
+            groups.push_back(gr);
+        }
+    }
+
+    // expected result of getUserGids
+    std::vector<gid_t> gids(int u) const {
+        std::vector<gid_t> result{static_cast<gid_t>(primarybase + u % 50)};
+        for (int k = 0; k < 5; k++)
+            result.push_back(groupbase + (u * 7 + k * 101) % ngroups);
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    int find(const char* name) const {
+        if (name[0] != 'u')
+            return -1;
+        char* end;
+        long u = strtol(name + 1, &end, 10);
+        return (*end == 0 && u >= 0 && u < nusers && usernames[u] == name) ? u : -1;
+    }
+};
+
+const Dataset& data() {
+    static Dataset dataset;
+    return dataset;
+}
+
+size_t pwpos = 0;
+size_t grpos = 0;
+
+void wait() {
+    if (latency.count() > 0)
+        std::this_thread::sleep_for(latency);
+}
+} // namespace fakenss
+
+extern "C" {
+struct passwd* getpwnam(const char* name) {
+    fakenss::getpwnam_calls++;
+    fakenss::wait();
+    int u = fakenss::data().find(name);
+    return u < 0 ? nullptr : const_cast<struct passwd*>(&fakenss::data().passwds[u]);
+}
+int getpwnam_r(const char* name, struct passwd* pwd, char* buf, size_t buflen, struct passwd** result) {
+    fakenss::getpwnam_calls++;
+    fakenss::wait();
+    int u = fakenss::data().find(name);
+    *result = nullptr;
+    if (u < 0)
+        return 0;
+    // strings point into the static dataset, buffer is not needed
+    (void)buf;
+    (void)buflen;
+    *pwd = fakenss::data().passwds[u];
+    *result = pwd;
+    return 0;
+}
+int getgrouplist(const char* user, gid_t group, gid_t* groups, int* ngroups) {
+    fakenss::getgrouplist_calls++;
+    fakenss::wait();
+    int u = fakenss::data().find(user);
+    std::vector<gid_t> result{group};
+    if (u >= 0) {
+        for (auto gid : fakenss::data().gids(u))
+            if (gid != group)
+                result.push_back(gid);
+    }
+    bool fits = static_cast<int>(result.size()) <= *ngroups;
+    if (fits)
+        std::copy(result.begin(), result.end(), groups);
+    *ngroups = result.size();
+    return fits ? *ngroups : -1;
+}
+void setpwent(void) { fakenss::pwpos = 0; }
+struct passwd* getpwent(void) {
+    auto& pws = fakenss::data().passwds;
+    return fakenss::pwpos < pws.size() ? const_cast<struct passwd*>(&pws[fakenss::pwpos++]) : nullptr;
+}
+void endpwent(void) {}
+void setgrent(void) { fakenss::grpos = 0; }
+struct group* getgrent(void) {
+    auto& grs = fakenss::data().groups;
+    return fakenss::grpos < grs.size() ? const_cast<struct group*>(&grs[fakenss::grpos++]) : nullptr;
+}
+void endgrent(void) {}
+}
+
+static void resetCounters() {
+    fakenss::getpwnam_calls = 0;
+    fakenss::getgrouplist_calls = 0;
+}
+
+// nsswitch.conf with given passwd and group sources
+static std::string nsswitch(const std::string& sources) {
+    auto path = fmt::format("/tmp/wstest{}-nsswitch.conf", getpid());
+    std::ofstream(path) << "# test\npasswd: " << sources << "\ngroup: " << sources << "\nhosts: files dns\n";
+    return path;
+}
+
+TEST_CASE("NSS cache", "[nsscache]") {
+    auto& cache = user::NSSCache::instance();
+    cache.clear();
+    resetCounters();
+    fakenss::latency = std::chrono::microseconds(0);
+    const auto files = nsswitch("files");
+
+    SECTION("fake dataset") {
+        REQUIRE(user::getUserGids("u42") == fakenss::data().gids(42));
+        REQUIRE(user::getUserGids("nosuchuser").empty());
+    }
+
+    SECTION("enumeration after threshold gives same results as single lookups") {
+        cache.configure(600, 100, files);
+        auto lookups = cache.getLookups();
+        auto enumerations = cache.getEnumerations();
+        for (int u = 0; u < fakenss::nusers; u++) {
+            REQUIRE(cache.getUserGids(fmt::format("u{}", u)) == fakenss::data().gids(u));
+        }
+        REQUIRE(cache.getLookups() - lookups == 100);
+        REQUIRE(cache.getEnumerations() - enumerations == 1);
+        REQUIRE(fakenss::getpwnam_calls == 100);
+    }
+
+    SECTION("users missing in enumeration are looked up one by one") {
+        cache.configure(600, 1, files);
+        REQUIRE(cache.getUserGids("u1") == fakenss::data().gids(1));
+        REQUIRE(cache.getUserGids("u2") == fakenss::data().gids(2));
+        REQUIRE(fakenss::getpwnam_calls == 1);
+        REQUIRE(cache.getUserGids("nosuchuser").empty());
+        REQUIRE(fakenss::getpwnam_calls == 2);
+    }
+
+    SECTION("threshold 0 never enumerates, but caches single lookups") {
+        cache.configure(600, 0, files);
+        auto enumerations = cache.getEnumerations();
+        for (int round = 0; round < 2; round++)
+            for (int u = 0; u < 300; u++)
+                cache.getUserGids(fmt::format("u{}", u));
+        REQUIRE(cache.getEnumerations() == enumerations);
+        REQUIRE(fakenss::getpwnam_calls == 300);
+    }
+
+    SECTION("ttl 0 disables caching") {
+        cache.configure(0, 100, files);
+        auto enumerations = cache.getEnumerations();
+        for (int round = 0; round < 2; round++)
+            for (int u = 0; u < 300; u++)
+                cache.getUserGids(fmt::format("u{}", u));
+        REQUIRE(cache.getEnumerations() == enumerations);
+        REQUIRE(fakenss::getpwnam_calls == 600);
+    }
+
+    SECTION("group intersection uses cache") {
+        cache.configure(600, 100, files);
+        utils::HasGroupIntersection intersection("u0");
+        auto base = fakenss::data().gids(0);
+        int common = 0;
+        for (int u = 0; u < fakenss::nusers; u++) {
+            auto other = fakenss::data().gids(u);
+            bool expected = std::find_first_of(base.begin(), base.end(), other.begin(), other.end()) != base.end();
+            REQUIRE(intersection.hasCommonGroups(fmt::format("u{}", u)) == expected);
+            common += expected;
+        }
+        REQUIRE(common > 0);
+        REQUIRE(common < fakenss::nusers);
+        REQUIRE(fakenss::getpwnam_calls == 100);
+    }
+
+    SECTION("enumeration only for sources returning everything") {
+        REQUIRE(user::NSSCache::enumerable("passwd: files\ngroup: files systemd\n"));
+        REQUIRE(user::NSSCache::enumerable("passwd:  files [NOTFOUND=return] # sss\ngroup: files\n"));
+        REQUIRE(!user::NSSCache::enumerable("passwd: files sss\ngroup: files sss\n"));
+        REQUIRE(!user::NSSCache::enumerable("passwd: files\ngroup: ldap\n"));
+        REQUIRE(!user::NSSCache::enumerable("passwd: compat\ngroup: compat\n"));
+        // glibc default without passwd and group lines has further sources
+        REQUIRE(!user::NSSCache::enumerable("hosts: files\n"));
+
+        cache.configure(600, 10, nsswitch("files sss"));
+        auto enumerations = cache.getEnumerations();
+        for (int u = 0; u < 100; u++)
+            REQUIRE(cache.getUserGids(fmt::format("u{}", u)) == fakenss::data().gids(u));
+        REQUIRE(cache.getEnumerations() == enumerations);
+        REQUIRE(fakenss::getgrouplist_calls == 100);
+    }
+
+    SECTION("lookups of threads do not wait for each other") {
+        cache.configure(600, 0, files);
+        fakenss::latency = std::chrono::microseconds(2000);
+        const int threads = 8, peruser = 25;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        std::atomic<int> wrong{0};
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([t, &cache, &wrong] {
+                for (int u = t * peruser; u < (t + 1) * peruser; u++)
+                    if (cache.getUserGids(fmt::format("u{}", u)) != fakenss::data().gids(u))
+                        wrong++;
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+                        .count();
+        fakenss::latency = std::chrono::microseconds(0);
+        REQUIRE(wrong == 0);
+        REQUIRE(fakenss::getpwnam_calls == threads * peruser);
+        // two lookups per user, serialized this takes 800ms
+        REQUIRE(msec < 400);
+    }
+
+    std::remove(files.c_str());
+}
+
+TEST_CASE("NSS cache benchmark", "[nsscache][.benchmark]") {
+    auto& cache = user::NSSCache::instance();
+    std::vector<std::string> names;
+    for (int u = 0; u < fakenss::nusers; u++)
+        names.push_back(fmt::format("u{}", u));
+
+    // every single lookup costs a bit, enumeration is streamed
+    fakenss::latency = std::chrono::microseconds(20);
+
+    resetCounters();
+    auto start = std::chrono::steady_clock::now();
+    size_t sum = 0;
+    for (const auto& name : names)
+        sum += user::getUserGids(name).size();
+    auto uncached =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    auto uncachedcalls = fakenss::getpwnam_calls + fakenss::getgrouplist_calls;
+
+    cache.clear();
+    const auto files = nsswitch("files");
+    cache.configure(600, 200, files);
+    resetCounters();
+    start = std::chrono::steady_clock::now();
+    size_t cachedsum = 0;
+    for (const auto& name : names)
+        cachedsum += cache.getUserGids(name).size();
+    auto cached =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    auto cachedcalls = fakenss::getpwnam_calls + fakenss::getgrouplist_calls;
+
+    fakenss::latency = std::chrono::microseconds(0);
+
+    REQUIRE(sum == cachedsum);
+    REQUIRE(cachedcalls < uncachedcalls / 5);
+    fmt::println("group lookup of {} users: {} us and {} NSS calls uncached, {} us and {} NSS calls cached",
+                 names.size(), uncached, uncachedcalls, cached, cachedcalls);
+    std::remove(files.c_str());
+}
@@ -0,0 +1,108 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../src/caps.h"
+#include "../src/config.h"
+#include "../src/executor.h"
+#include "../src/ratelimit.h"
+
+Cap caps{};
+
+bool debugflag = false;
+bool traceflag = false;
+int debuglevel = 0;
+
+using namespace std::chrono;
+
+TEST_CASE("metadata limiter", "[ratelimit]") {
+
+    SECTION("unlimited limiter does not wait") {
+        MetadataLimiter limiter;
+        auto before = limiter.usage();
+        auto begin = steady_clock::now();
+        for (int i = 0; i < 100000; i++)
+            limiter.acquire();
+        REQUIRE(steady_clock::now() - begin < seconds(1));
+        auto after = limiter.usage();
+        REQUIRE(after.ops - before.ops == 100000);
+        REQUIRE(after.throttled == before.throttled);
+    }
+
+    SECTION("rate is enforced across threads") {
+        MetadataLimiter limiter;
+        limiter.setLimits(1000, 0);
+        auto begin = steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+            threads.emplace_back([&limiter] {
+                for (int i = 0; i < 100; i++)
+                    limiter.acquire();
+            });
+        for (auto& thread : threads)
+            thread.join();
+        // 400 operations at 1000/s, minus a burst of 100
+        REQUIRE(steady_clock::now() - begin >= milliseconds(250));
+        REQUIRE(limiter.usage().ops == 400);
+        REQUIRE(limiter.usage().throttled > milliseconds(0));
+    }
+
+    SECTION("large requests are granted and paid afterwards") {
+        MetadataLimiter limiter;
+        limiter.setLimits(100, 0);
+        auto begin = steady_clock::now();
+        limiter.acquire(20);
+        REQUIRE(steady_clock::now() - begin >= milliseconds(90));
+    }
+
+    SECTION("concurrency is limited") {
+        MetadataLimiter limiter;
+        limiter.setLimits(0, 2);
+        std::atomic<int> active{0};
+        std::atomic<int> maxactive{0};
+        Executor::instance().start(8);
+        Executor::instance().parallel_for(0, 64, [&](size_t) {
+            MetadataLimiter::Slot slot(limiter);
+            int now = ++active;
+            int seen = maxactive;
+            while (now > seen && !maxactive.compare_exchange_weak(seen, now)) {
+            }
+            std::this_thread::sleep_for(milliseconds(1));
+            active--;
+        });
+        Executor::instance().start(1);
+        REQUIRE(maxactive <= 2);
+        REQUIRE(maxactive >= 1);
+    }
+
+    SECTION("limits are read from the filesystem config") {
+        Config config(std::string(R"(
+admins: [root]
+clustername: ratelimit
+dbuid: 1
+dbgid: 1
+default: fast
+workspaces:
+  slow:
+    spaces: [/tmp]
+    database: /tmp
+    deleted: .removed
+    metadatarate: 2000
+    metadataconcurrency: 4
+  fast:
+    spaces: [/tmp]
+    database: /tmp
+    deleted: .removed
+)"));
+        REQUIRE(config.validate());
+        MetadataLimiter::configure(config);
+        REQUIRE(MetadataLimiter::forFilesystem("slow").getRate() == 2000);
+        REQUIRE(MetadataLimiter::forFilesystem("slow").getConcurrency() == 4);
+        REQUIRE(MetadataLimiter::forFilesystem("fast").getRate() == 0);
+        REQUIRE(&MetadataLimiter::forFilesystem("slow") == &MetadataLimiter::forFilesystem("slow"));
+    }
+}
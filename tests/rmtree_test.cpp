@@ -0,0 +1,356 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fmt/core.h"
+
+#include "../src/caps.h"
+#include "../src/executor.h"
+#include "../src/ratelimit.h"
+#include "../src/utils.h"
+
+namespace fs = std::filesystem;
+
+Cap caps{};
+
+bool debugflag = false;
+bool traceflag = false;
+int debuglevel = 0;
+
+// fresh directory for one test
+static fs::path makeTempDir() {
+    std::string tmpl = (fs::temp_directory_path() / "_wsRT.XXXXXX").string();
+    REQUIRE(mkdtemp(tmpl.data()) != nullptr);
+    return tmpl;
+}
+
+// width^depth directories with files files each
+static long makeTree(const fs::path& dir, int width, int depth, int files) {
+    long count = 0;
+    fs::create_directories(dir);
+    for (int f = 0; f < files; f++) {
+        std::ofstream(dir / fmt::format("f{}", f)) << "x";
+        count++;
+    }
+    if (depth > 0)
+        for (int w = 0; w < width; w++)
+            count += makeTree(dir / fmt::format("d{}", w), width, depth - 1, files) + 1;
+    return count;
+}
+
+TEST_CASE("rmtree", "[rmtree]") {
+    auto base = makeTempDir();
+
+    SECTION("deletes wide and deep trees with any number of threads") {
+        for (unsigned threads : {1u, 2u, 8u}) {
+            Executor::instance().start(threads);
+            auto top = base / "tree";
+            REQUIRE(makeTree(top, 4, 4, 5) > 1000);
+            // deep chain, directories are removed bottom up
+            fs::path deep = top;
+            for (int i = 0; i < 100; i++)
+                deep /= "deep";
+            fs::create_directories(deep);
+            std::ofstream(deep / "leaf") << "x";
+
+            utils::rmtree(top.string());
+            REQUIRE(!fs::exists(top));
+        }
+    }
+
+    SECTION("deletes flat directories larger than one batch") {
+        for (unsigned threads : {1u, 8u}) {
+            Executor::instance().start(threads);
+            auto top = base / "flat";
+            REQUIRE(makeTree(top, 0, 0, 20000) == 20000);
+            // many subdirectories with long names, more than are queued at once
+            for (int d = 0; d < 3000; d++)
+                fs::create_directories(top / fmt::format("{:0>200}", d) / "sub");
+            fs::create_symlink("/nonexistent", top / "dangling");
+
+            utils::rmtree(top.string());
+            REQUIRE(!fs::exists(top));
+        }
+    }
+
+    SECTION("does not follow symbolic links") {
+        Executor::instance().start(4);
+        auto outside = base / "outside";
+        makeTree(outside, 2, 2, 2);
+        auto top = base / "tree";
+        makeTree(top, 2, 2, 2);
+        fs::create_directory_symlink(outside, top / "d0" / "link");
+        fs::create_directory_symlink(outside, top / "toplink");
+
+        utils::rmtree(top.string());
+        REQUIRE(!fs::exists(top));
+        REQUIRE(fs::exists(outside / "d1" / "d1" / "f1"));
+
+        // a symlink given as top is not followed either
+        fs::create_directory_symlink(outside, base / "link");
+        utils::rmtree((base / "link").string());
+        REQUIRE(fs::exists(outside / "d1" / "d1" / "f1"));
+    }
+
+    SECTION("passed deadline stops deletion") {
+        Executor::instance().start(4);
+        auto top = base / "tree";
+        makeTree(top, 2, 2, 2);
+        utils::rmtree(top.string(), std::time(nullptr) - 1);
+        REQUIRE(fs::exists(top / "d1" / "d1" / "f1"));
+        utils::rmtree(top.string(), std::time(nullptr) + 3600);
+        REQUIRE(!fs::exists(top));
+    }
+
+    SECTION("checkpoint continues removal after deadline") {
+        Executor::instance().start(4);
+        auto top = base / "ws-1";
+        long entries = makeTree(top, 3, 3, 4);
+        auto checkpoint = utils::rmtreeCheckpoint(top.string());
+        REQUIRE(checkpoint == (base / ".ws-1.rmtree").string());
+        REQUIRE(utils::rmtreeCheckpoint(top.string() + "/") == checkpoint);
+
+        // passed deadline, nothing started, checkpoint records the run
+        auto stats = utils::rmtree(top.string(), std::time(nullptr) - 1, checkpoint);
+        REQUIRE(!stats.complete);
+        REQUIRE(stats.runs == 1);
+        REQUIRE(fs::exists(checkpoint));
+
+        stats = utils::rmtree(top.string(), 0, checkpoint);
+        REQUIRE(stats.complete);
+        REQUIRE(stats.runs == 2);
+        REQUIRE(stats.files + stats.dirs == entries + 1);
+        REQUIRE(!fs::exists(top));
+        REQUIRE(!fs::exists(checkpoint));
+    }
+
+    SECTION("checkpoint frontier is deleted first and counts accumulate") {
+        Executor::instance().start(2);
+        auto top = base / "ws-2";
+        makeTree(top, 2, 2, 3);
+        auto checkpoint = utils::rmtreeCheckpoint(top.string());
+
+        // checkpoint of an earlier run, as written when the deadline passed
+        {
+            struct stat st;
+            REQUIRE(stat(top.c_str(), &st) == 0);
+            std::ofstream out(checkpoint, std::ios::binary);
+            out << "ws_rmtree_checkpoint 1\n"
+                << "dev " << st.st_dev << "\nino " << st.st_ino << "\n"
+                << "files 100\ndirs 10\nbytes 1000\nruns 3\nfrontier\n";
+            out << "d0/d1" << '\0' << "../outside" << '\0' << "d1/gone" << '\0';
+        }
+        auto stats = utils::rmtree(top.string(), std::time(nullptr) + 3600, checkpoint);
+        REQUIRE(stats.complete);
+        REQUIRE(stats.runs == 4);
+        REQUIRE(stats.files == 100 + 4 * 3 + 2 * 3 + 3);
+        REQUIRE(stats.bytes >= 1000);
+        REQUIRE(stats.dirs == 10 + 4 + 2 + 1);
+        REQUIRE(!fs::exists(top));
+        REQUIRE(!fs::exists(checkpoint));
+    }
+
+    SECTION("parents emptied by the frontier are removed bottom up") {
+        Executor::instance().start(2);
+        auto top = base / "ws-6";
+        makeTree(top / "a" / "b" / "c", 0, 0, 3);
+        makeTree(top / "x", 0, 0, 2);
+        auto checkpoint = utils::rmtreeCheckpoint(top.string());
+        {
+            struct stat st;
+            REQUIRE(stat(top.c_str(), &st) == 0);
+            std::ofstream out(checkpoint, std::ios::binary);
+            out << "ws_rmtree_checkpoint 1\n"
+                << "dev " << st.st_dev << "\nino " << st.st_ino << "\nfrontier\n";
+            out << "a/b/c" << '\0';
+        }
+        auto stats = utils::rmtree(top.string(), 0, checkpoint);
+        REQUIRE(stats.complete);
+        REQUIRE(stats.files == 5);
+        // every directory is counted once
+        REQUIRE(stats.dirs == 5);
+        REQUIRE(!fs::exists(top));
+    }
+
+    SECTION("deletion that fails is not complete") {
+        Executor::instance().start(2);
+        auto outside = base / "outside";
+        makeTree(outside, 1, 1, 1);
+        fs::create_symlink(outside, base / "ws-7");
+        auto checkpoint = utils::rmtreeCheckpoint((base / "ws-7").string());
+        auto stats = utils::rmtree((base / "ws-7").string(), 0, checkpoint);
+        REQUIRE(!stats.complete);
+        REQUIRE(!stats.expired);
+        REQUIRE(fs::exists(outside / "d0" / "f0"));
+        fs::remove(base / "ws-7");
+        fs::remove(checkpoint);
+    }
+
+    SECTION("checkpoint of another directory is ignored") {
+        Executor::instance().start(2);
+        auto top = base / "ws-3";
+        makeTree(top, 1, 1, 1);
+        auto checkpoint = utils::rmtreeCheckpoint(top.string());
+        std::ofstream(checkpoint, std::ios::binary) << "ws_rmtree_checkpoint 1\ndev 1\nino 1\nruns 7\nfrontier\n";
+        auto stats = utils::rmtree(top.string(), 0, checkpoint);
+        REQUIRE(stats.complete);
+        REQUIRE(stats.runs == 1);
+        REQUIRE(!fs::exists(checkpoint));
+    }
+
+    SECTION("limiter counts metadata operations") {
+        Executor::instance().start(4);
+        auto top = base / "tree";
+        long entries = makeTree(top, 3, 2, 10);
+        MetadataLimiter limiter;
+        limiter.setLimits(100000, 2);
+        utils::RmtreeOptions options;
+        options.limiter = &limiter;
+        auto stats = utils::rmtree(top.string(), 0, "", options);
+        REQUIRE(stats.complete);
+        REQUIRE(!fs::exists(top));
+        // at least one operation per entry
+        REQUIRE(limiter.usage().ops >= static_cast<uint64_t>(entries));
+    }
+
+    SECTION("emptied directories are read once") {
+        Executor::instance().start(4);
+        auto top = base / "tree";
+        long entries = makeTree(top, 4, 3, 1);
+        long dirs = (entries + 1) / 2;
+        MetadataLimiter limiter;
+        limiter.setLimits(1000000, 4);
+        utils::RmtreeOptions options;
+        options.limiter = &limiter;
+        auto stats = utils::rmtree(top.string(), 0, "", options);
+        REQUIRE(stats.complete);
+        REQUIRE(stats.dirs == dirs);
+        // per directory stat and open, getdents until end, unlink of its file and rmdir
+        REQUIRE(limiter.usage().ops <= static_cast<uint64_t>(dirs * 6));
+    }
+
+    SECTION("files are stated only for counting bytes") {
+        Executor::instance().start(2);
+        for (bool countbytes : {false, true}) {
+            auto top = base / "flat";
+            makeTree(top, 0, 0, 1000);
+            MetadataLimiter limiter;
+            limiter.setLimits(1000000, 2);
+            utils::RmtreeOptions options;
+            options.limiter = &limiter;
+            options.countbytes = countbytes;
+            auto stats = utils::rmtree(top.string(), 0, "", options);
+            REQUIRE(stats.complete);
+            REQUIRE(stats.files == 1000);
+            // unlink per file, and a stat if counting
+            if (countbytes)
+                REQUIRE(limiter.usage().ops >= 2000);
+            else
+                REQUIRE(limiter.usage().ops < 1100);
+        }
+    }
+
+    SECTION("freed space is counted once for hard links") {
+        Executor::instance().start(2);
+        auto top = base / "tree";
+        makeTree(top, 2, 1, 0);
+        std::ofstream(top / "d0" / "big", std::ios::binary) << std::string(1024 * 1024, 'x');
+        fs::create_hard_link(top / "d0" / "big", top / "d1" / "link");
+        utils::RmtreeOptions options;
+        options.countbytes = true;
+        auto stats = utils::rmtree(top.string(), 0, "", options);
+        REQUIRE(stats.complete);
+        REQUIRE(stats.files == 2);
+        REQUIRE(stats.bytes >= 1024 * 1024);
+        REQUIRE(stats.bytes < 2 * 1024 * 1024);
+        REQUIRE(stats.seconds >= 0);
+    }
+
+    SECTION("inode order deletes everything") {
+        for (unsigned threads : {1u, 4u}) {
+            Executor::instance().start(threads);
+            auto top = base / "tree";
+            long entries = makeTree(top, 3, 3, 50);
+            makeTree(top / "flat", 0, 0, 5000);
+            fs::create_symlink("/nonexistent", top / "d1" / "dangling");
+            utils::RmtreeOptions options;
+            options.inodeorder = true;
+            auto stats = utils::rmtree(top.string(), 0, "", options);
+            REQUIRE(stats.complete);
+            REQUIRE(stats.files + stats.dirs == entries + 5000 + 1 + 1 + 1);
+            REQUIRE(!fs::exists(top));
+        }
+    }
+
+    SECTION("purge request marker") {
+        auto top = base / "ws-4";
+        makeTree(top, 1, 1, 1);
+        auto marker = utils::purgeMarker(top.string());
+        REQUIRE(marker == (base / ".ws-4.purge").string());
+        REQUIRE(utils::requestPurge(top.string()));
+        REQUIRE(fs::is_regular_file(marker));
+        // requesting twice is fine
+        REQUIRE(utils::requestPurge(top.string()));
+        // marker is never written through a symlink
+        fs::create_symlink(base / "elsewhere", base / ".ws-5.purge");
+        REQUIRE(!utils::requestPurge((base / "ws-5").string()));
+        REQUIRE(!fs::exists(base / "elsewhere"));
+    }
+
+    SECTION("relative path") {
+        Executor::instance().start(2);
+        makeTree(base / "tree", 2, 2, 2);
+        auto cwd = fs::current_path();
+        fs::current_path(base);
+        utils::rmtree("tree");
+        fs::current_path(cwd);
+        REQUIRE(!fs::exists(base / "tree"));
+    }
+
+    Executor::instance().start(1);
+    fs::remove_all(base);
+}
+
+// directory to benchmark in, e.g. a loopback image:
+//   truncate -s 4G /tmp/ext4.img && mkfs.ext4 -q /tmp/ext4.img && mount -o loop /tmp/ext4.img /mnt/bench
+//   WS_RMTREE_BENCH_DIR=/mnt/bench tests/rmtree_test "[benchmark]"
+// with a benchmark directory given, caches are dropped between creating and deleting if running as root,
+// without differences are small
+TEST_CASE("rmtree order benchmark", "[rmtree][.benchmark]") {
+    const char* benchdir = std::getenv("WS_RMTREE_BENCH_DIR");
+    fs::path base = benchdir ? fs::path(benchdir) / "_wsRT.bench" : makeTempDir();
+    fs::create_directories(base);
+    Executor::instance().start(4);
+
+    for (bool inodeorder : {false, true}) {
+        // readdir order of hashed directories (ext4, XFS) differs from inode order, which follows creation
+        auto top = base / "tree";
+        long entries = makeTree(top, 4, 2, 2000);
+        sync();
+        if (benchdir && geteuid() == 0)
+            std::ofstream("/proc/sys/vm/drop_caches") << "3";
+
+        utils::RmtreeOptions options;
+        options.inodeorder = inodeorder;
+        auto start = std::chrono::steady_clock::now();
+        auto stats = utils::rmtree(top.string(), 0, "", options);
+        sync();
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+                        .count();
+        REQUIRE(stats.complete);
+        fmt::println("rmtree of {} entries in {} order: {} ms, {} entries/s", entries,
+                     inodeorder ? "inode" : "directory", msec, msec > 0 ? entries * 1000 / msec : 0);
+    }
+
+    Executor::instance().start(1);
+    fs::remove_all(base);
+}
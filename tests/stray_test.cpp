@@ -0,0 +1,116 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "../src/stray.h"
+
+namespace cppfs = std::filesystem;
+
+bool debugflag = false;
+bool traceflag = false;
+int debuglevel = 0;
+
+// comparison ws_expirer did before the hash join, for one directory
+static bool matchLinear(const FoundDir& founddir, const std::vector<std::pair<std::string, std::string>>& entries) {
+    return std::any_of(entries.begin(), entries.end(), [&](const auto& item) {
+        return item.second == (cppfs::path(founddir.space) / cppfs::path(founddir.dir)).string() ||
+               item.first == cppfs::path(founddir.dir).string();
+    });
+}
+
+// generated DB entries and their directories, matched with the hash join, and with the linear search for
+// samples of the directories
+static void compareWithLinear(const size_t count, const size_t samples) {
+    std::vector<std::string> spaces = {"/lustre/ws/0", "/lustre/ws/1", "/lustre/ws/2/"};
+
+    // every 7th entry is unreadable, every 5th was moved to another space
+    std::vector<std::pair<std::string, std::string>> entries;
+    entries.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        std::string id = fmt::format("user{}-ws{}", i % 1000, i);
+        std::string wspath =
+            i % 7 == 0 ? "" : (cppfs::path(spaces[(i + (i % 5 == 0)) % 3]) / fmt::format("user{}-ws{}", i % 1000, i))
+                                  .string();
+        entries.emplace_back(id, wspath);
+    }
+
+    // directories of all entries in their space, a third more strays, and names found in wrong spaces
+    std::vector<FoundDir> dirs;
+    std::vector<bool> expected;
+    for (size_t i = 0; i < count; i++) {
+        dirs.push_back({spaces[i % 3], fmt::format("user{}-ws{}", i % 1000, i)});
+        expected.push_back(true); // name always matches the id
+        if (i % 3 == 0) {
+            dirs.push_back({spaces[i % 3], fmt::format("user{}-stray{}", i % 1000, i)});
+            expected.push_back(false);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto found = matchDirectories(dirs, entries);
+    auto msec =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (count >= 100000)
+        fmt::println("matched {} directories with {} entries in {} ms", dirs.size(), entries.size(), msec);
+    REQUIRE(found == expected);
+
+    // linear search is quadratic, compare a sample of directories with all entries
+    size_t step = std::max<size_t>(1, dirs.size() / samples);
+    for (size_t i = 0; i < dirs.size(); i += step)
+        REQUIRE(matchLinear(dirs[i], entries) == found[i]);
+
+    // match by path only, names unknown to the DB
+    std::vector<std::pair<std::string, std::string>> renamed;
+    renamed.reserve(count);
+    for (const auto& [id, wspath] : entries)
+        renamed.emplace_back("other-" + id, wspath);
+    found = matchDirectories(dirs, renamed);
+    for (size_t i = 0; i < dirs.size(); i += step)
+        REQUIRE(matchLinear(dirs[i], renamed) == found[i]);
+    size_t matched = std::count(found.begin(), found.end(), true);
+    REQUIRE(matched > 0);
+    REQUIRE(matched < count);
+}
+
+TEST_CASE("stray directory matching", "[stray]") {
+
+    SECTION("small cases") {
+        std::vector<std::pair<std::string, std::string>> entries = {
+            {"alice-a", "/ws/s1/alice-a"},     // path and name match
+            {"bob-b", "/ws/s2/bob-b-renamed"}, // path differs, name matches
+            {"carl-c", "/ws/s1/moved-c"},      // path matches a directory of another name
+            {"dan-d", ""},                     // unreadable entry, only name can match
+        };
+        std::vector<FoundDir> dirs = {
+            {"/ws/s1", "alice-a"}, {"/ws/s2", "bob-b"},  {"/ws/s1/", "moved-c"}, {"/ws/s1", "dan-d"},
+            {"/ws/s1", "eve-e"},   {"/ws/s2", "alice-a"}, {"/ws/s2", "moved-c"},
+        };
+        std::vector<bool> expected = {true, true, true, true, false, true, false};
+        REQUIRE(matchDirectories(dirs, entries) == expected);
+        for (size_t i = 0; i < dirs.size(); i++)
+            REQUIRE(matchLinear(dirs[i], entries) == expected[i]);
+
+        // deleted workspaces match by name only
+        std::vector<std::string> ids = {"alice-a-1700000000", "bob-b-1700000001"};
+        std::vector<FoundDir> deleted = {{"/ws/s1", "alice-a-1700000000"}, {"/ws/s1", "alice-a-1700000001"}};
+        REQUIRE(matchDirectories(deleted, ids) == std::vector<bool>{true, false});
+        REQUIRE(matchDirectories({}, ids).empty());
+        REQUIRE(matchDirectories(deleted, std::vector<std::string>{}) == std::vector<bool>{false, false});
+    }
+}
+
+TEST_CASE("stray directory matching of many entries", "[stray]") {
+    // every directory is compared with the linear search
+    compareWithLinear(1000, 1400);
+}
+
+// hidden, run with: tests/stray_test "[benchmark]"
+TEST_CASE("stray directory matching benchmark", "[stray][.benchmark]") { compareWithLinear(200000, 200); }
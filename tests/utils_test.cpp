@@ -1,15 +1,22 @@
+#include <algorithm>
 #include <filesystem>
 #define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
 #include <catch2/catch_test_macros.hpp>
 #include <string>
 #include <vector>
 
+#include <unistd.h>
+
+#include "../src/caps.h"
 #include "../src/mail.h"
+#include "../src/user.h"
 #include "../src/utils.h"
 #include "../src/ws.h"
 
 namespace fs = std::filesystem;
 
+Cap caps{};
+
 bool debugflag = false;
 bool traceflag = false;
 int debuglevel = 0;
@@ -117,4 +124,54 @@ TEST_CASE("utils", "[utils]") {
         REQUIRE(utils::isValidEmail("user}test@example.com"));
         REQUIRE(utils::isValidEmail("user~test@example.com"));
     }
+
+    SECTION("reminder points") {
+        const std::time_t day = 24 * 3600;
+        const std::time_t expiration = 1000 * day;
+        const std::vector<int> schedule = {7, 3, 1};
+        // no reminder wanted
+        REQUIRE(utils::reminderDue(expiration, 0, schedule, expiration - 1) == 0);
+        // before first point
+        REQUIRE(utils::reminderDue(expiration, 10, schedule, expiration - 11 * day) == 0);
+        // first point is the reminder of the workspace
+        REQUIRE(utils::reminderDue(expiration, 10, schedule, expiration - 9 * day) == expiration - 10 * day);
+        REQUIRE(utils::reminderDue(expiration, 10, schedule, expiration - 5 * day) == expiration - 7 * day);
+        REQUIRE(utils::reminderDue(expiration, 10, schedule, expiration - 1) == expiration - 1 * day);
+        // points at or beyond the reminder of the workspace are not used
+        REQUIRE(utils::reminderDue(expiration, 3, schedule, expiration - 2 * day) == expiration - 3 * day);
+        REQUIRE(utils::reminderDue(expiration, 3, schedule, expiration - 5 * day) == 0);
+        // without schedule only once
+        REQUIRE(utils::reminderDue(expiration, 3, {}, expiration - 1) == expiration - 3 * day);
+    }
+}
+
+TEST_CASE("identity", "[user]") {
+    auto identity = user::getIdentity({});
+    REQUIRE(identity.uid == getuid());
+    REQUIRE(identity.username == user::getUsername());
+    REQUIRE(identity.home == user::getUserhome());
+    REQUIRE(identity.groups == user::getGrouplist());
+    REQUIRE(identity.gids.size() >= identity.groups.size());
+    REQUIRE(identity.root == user::isRoot());
+    REQUIRE(identity.admin == false);
+
+    auto admin = user::getIdentity({"someoneelse", identity.username});
+    REQUIRE(admin.admin == true);
+}
+
+TEST_CASE("gid intersection", "[user]") {
+    REQUIRE(user::hasCommonGid({1, 5, 9}, {2, 5}));
+    REQUIRE(user::hasCommonGid({1, 5, 9}, {9}));
+    REQUIRE_FALSE(user::hasCommonGid({1, 5, 9}, {2, 6, 10}));
+    REQUIRE_FALSE(user::hasCommonGid({}, {1}));
+
+    auto rootgids = user::getUserGids("root");
+    REQUIRE(std::is_sorted(rootgids.begin(), rootgids.end()));
+    REQUIRE(std::find(rootgids.begin(), rootgids.end(), 0) != rootgids.end());
+    REQUIRE(user::getUserGids("user-that-does-not-exist").empty());
+
+    utils::HasGroupIntersection intersection("root");
+    REQUIRE(intersection.hasCommonGroups("root"));
+    // unknown users are assumed to share groups
+    REQUIRE(intersection.hasCommonGroups("user-that-does-not-exist"));
 }